@@ -0,0 +1,281 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+"""
+LZ4 compression of CArchive (PKG) entries.
+
+The entries are stored in the LZ4 frame format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md), which is
+decoded by the bootloader. The frames are written with independent blocks of up to 4 MiB, without checksums, so that the
+bootloader can decode a large entry block by block, using a fixed-size buffer.
+
+The block compression is performed by the `lz4` python package, if available; otherwise, the LZ4 shared library
+(liblz4) is used via ctypes. The decompression (used only by the archive reader) falls back to a pure-python decoder.
+"""
+
+import struct
+
+_FRAME_MAGIC = 0x184D2204
+
+_FLG_VERSION_01 = 0x40
+_FLG_BLOCK_INDEPENDENCE = 0x20
+_FLG_BLOCK_CHECKSUM = 0x10
+_FLG_CONTENT_SIZE = 0x08
+_FLG_CONTENT_CHECKSUM = 0x04
+_FLG_DICT_ID = 0x01
+
+_BLOCK_UNCOMPRESSED = 0x80000000
+
+# Maximum block size; 4 MiB, denoted by value 7 in the BD byte.
+_BLOCK_MAX_SIZE_ID = 7
+_BLOCK_MAX_SIZE = 4 * 1024 * 1024
+
+_COMPRESSION_LEVEL = 9  # LZ4HC compression level
+
+_block_compressor = None
+
+
+def _xxh32(data, seed=0):
+    """
+    Compute xxHash32 of (short) data; used only for the frame header checksum.
+    """
+    PRIME1, PRIME2, PRIME3, PRIME4, PRIME5 = 2654435761, 2246822519, 3266489917, 668265263, 374761393
+    MASK = 0xFFFFFFFF
+
+    def rotl(value, count):
+        return ((value << count) | (value >> (32 - count))) & MASK
+
+    assert len(data) < 16
+    h = (seed + PRIME5 + len(data)) & MASK
+    pos = 0
+    while pos + 4 <= len(data):
+        h = (h + struct.unpack_from('<I', data, pos)[0] * PRIME3) & MASK
+        h = (rotl(h, 17) * PRIME4) & MASK
+        pos += 4
+    while pos < len(data):
+        h = (h + data[pos] * PRIME5) & MASK
+        h = (rotl(h, 11) * PRIME1) & MASK
+        pos += 1
+
+    h ^= h >> 15
+    h = (h * PRIME2) & MASK
+    h ^= h >> 13
+    h = (h * PRIME3) & MASK
+    h ^= h >> 16
+    return h
+
+
+def _get_block_compressor():
+    """
+    Return function that compresses a single block of data into LZ4 block format.
+    """
+    global _block_compressor
+    if _block_compressor is not None:
+        return _block_compressor
+
+    try:
+        import lz4.block
+
+        def _compress_block(data):
+            return lz4.block.compress(
+                bytes(data), mode='high_compression', compression=_COMPRESSION_LEVEL, store_size=False
+            )
+
+        _block_compressor = _compress_block
+        return _block_compressor
+    except ImportError:
+        pass
+
+    import ctypes
+    import ctypes.util
+
+    lib_name = ctypes.util.find_library('lz4')
+    lib = None
+    for candidate in (lib_name, 'liblz4.so.1', 'liblz4.dylib', 'liblz4.dll'):
+        if not candidate:
+            continue
+        try:
+            lib = ctypes.CDLL(candidate)
+            break
+        except OSError:
+            continue
+    if lib is None:
+        raise RuntimeError(
+            "LZ4 compression of archive entries requires either the 'lz4' python package or the LZ4 shared library "
+            "(liblz4)!"
+        )
+
+    lib.LZ4_compressBound.argtypes = [ctypes.c_int]
+    lib.LZ4_compressBound.restype = ctypes.c_int
+    lib.LZ4_compress_HC.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.LZ4_compress_HC.restype = ctypes.c_int
+
+    def _compress_block(data):
+        data = bytes(data)
+        dst_capacity = lib.LZ4_compressBound(len(data))
+        dst = ctypes.create_string_buffer(dst_capacity)
+        dst_length = lib.LZ4_compress_HC(data, dst, len(data), dst_capacity, _COMPRESSION_LEVEL)
+        if dst_length <= 0:
+            raise RuntimeError("LZ4 compression failed!")
+        return dst.raw[:dst_length]
+
+    _block_compressor = _compress_block
+    return _block_compressor
+
+
+def is_available():
+    """
+    Check whether LZ4 compression is available.
+    """
+    try:
+        _get_block_compressor()
+    except RuntimeError:
+        return False
+    return True
+
+
+def _frame_header():
+    descriptor = bytes([_FLG_VERSION_01 | _FLG_BLOCK_INDEPENDENCE, _BLOCK_MAX_SIZE_ID << 4])
+    header_checksum = (_xxh32(descriptor) >> 8) & 0xFF
+    return struct.pack('<I', _FRAME_MAGIC) + descriptor + bytes([header_checksum])
+
+
+def _compress_block_into_frame(compress_block, data):
+    compressed = compress_block(data)
+    if len(compressed) < len(data):
+        return struct.pack('<I', len(compressed)) + compressed
+    # Store incompressible block as-is.
+    return struct.pack('<I', len(data) | _BLOCK_UNCOMPRESSED) + bytes(data)
+
+
+def compress(data):
+    """
+    Compress the data into an LZ4 frame.
+    """
+    compress_block = _get_block_compressor()
+    chunks = [_frame_header()]
+    for pos in range(0, len(data), _BLOCK_MAX_SIZE):
+        chunks.append(_compress_block_into_frame(compress_block, data[pos:pos + _BLOCK_MAX_SIZE]))
+    chunks.append(struct.pack('<I', 0))  # End mark
+    return b''.join(chunks)
+
+
+def compress_file(in_fp, out_fp):
+    """
+    Compress the contents of input file object into an LZ4 frame, which is written into the output file object.
+    """
+    compress_block = _get_block_compressor()
+    out_fp.write(_frame_header())
+    tmp_buffer = bytearray(_BLOCK_MAX_SIZE)
+    while True:
+        num_read = in_fp.readinto(tmp_buffer)
+        if not num_read:
+            break
+        out_fp.write(_compress_block_into_frame(compress_block, memoryview(tmp_buffer)[:num_read]))
+    out_fp.write(struct.pack('<I', 0))  # End mark
+
+
+def _decompress_block(src, dst):
+    """
+    Pure-python decoder of a single LZ4 block; the decoded data is appended to the `dst` bytearray, and matches may
+    refer to its existing contents (as is the case with linked blocks).
+    """
+    pos = 0
+    end = len(src)
+    while pos < end:
+        token = src[pos]
+        pos += 1
+
+        # Literals
+        literal_length = token >> 4
+        if literal_length == 15:
+            while True:
+                value = src[pos]
+                pos += 1
+                literal_length += value
+                if value != 255:
+                    break
+        if pos + literal_length > end:
+            raise ValueError("Invalid LZ4 block: literals out of bounds!")
+        dst += src[pos:pos + literal_length]
+        pos += literal_length
+        if pos == end:
+            break
+
+        # Match
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        if offset == 0 or offset > len(dst):
+            raise ValueError("Invalid LZ4 block: match offset out of bounds!")
+        match_length = token & 0x0F
+        if match_length == 15:
+            while True:
+                value = src[pos]
+                pos += 1
+                match_length += value
+                if value != 255:
+                    break
+        match_length += 4
+
+        start = len(dst) - offset
+        if offset >= match_length:
+            dst += dst[start:start + match_length]
+        else:
+            # Overlapping match; repeat the pattern.
+            pattern = dst[start:]
+            repeats, remainder = divmod(match_length, offset)
+            dst += pattern * repeats + pattern[:remainder]
+
+
+def decompress(data):
+    """
+    Decompress the LZ4 frame.
+    """
+    data = memoryview(data)
+    magic, flags, block_descriptor = struct.unpack_from('<IBB', data, 0)
+    if magic != _FRAME_MAGIC:
+        raise ValueError("Invalid LZ4 frame: bad magic!")
+    if flags & 0xC0 != _FLG_VERSION_01:
+        raise ValueError("Invalid LZ4 frame: unsupported version!")
+    if flags & _FLG_DICT_ID:
+        raise ValueError("Invalid LZ4 frame: dictionaries are not supported!")
+
+    pos = 6
+    if flags & _FLG_CONTENT_SIZE:
+        pos += 8
+    pos += 1  # Header checksum
+
+    try:
+        import lz4.block
+        block_max_size = 1 << (8 + 2 * ((block_descriptor >> 4) & 0x07))
+    except ImportError:
+        lz4 = None
+
+    output = bytearray()
+    while True:
+        block_size, = struct.unpack_from('<I', data, pos)
+        pos += 4
+        if block_size == 0:
+            break
+        block_length = block_size & ~_BLOCK_UNCOMPRESSED
+        block = data[pos:pos + block_length]
+        if len(block) != block_length:
+            raise ValueError("Invalid LZ4 frame: truncated block!")
+        pos += block_length
+        if flags & _FLG_BLOCK_CHECKSUM:
+            pos += 4
+
+        if block_size & _BLOCK_UNCOMPRESSED:
+            output += block
+        elif lz4 is not None and flags & _FLG_BLOCK_INDEPENDENCE:
+            output += lz4.block.decompress(block, uncompressed_size=block_max_size)
+        else:
+            _decompress_block(block, output)
+
+    return bytes(output)
@@ -33,6 +33,17 @@ class NotAnArchiveError(TypeError):
 PKG_ITEM_DATA = 'x'  # data
 PKG_ITEM_RUNTIME_OPTION = 'o'  # runtime option
 PKG_ITEM_SPLASH = 'l'  # splash resources
+PKG_ITEM_DIRECTORY_TABLE = 'D'  # table of directories of extractable entries
+
+# Compression methods of CArchive entries (value of the TOC entry's compression_flag field). For backwards compatibility,
+# the value of zlib compression matches the original boolean compression flag.
+PKG_COMPRESSION_NONE = 0  # stored without compression
+PKG_COMPRESSION_ZLIB = 1  # zlib stream
+PKG_COMPRESSION_LZ4 = 2  # LZ4 frame
+PKG_COMPRESSION_ZLIB_BLOCKS = 3  # independently-compressed zlib blocks, preceded by block index
+
+# Archive flags, stored in the cookie.
+PKG_FLAG_CHECKSUMS = 0x1  # TOC entries contain CRC-32 checksums of the entries' uncompressed data
 
 
 class CArchiveReader:
@@ -41,9 +52,10 @@ class CArchiveReader:
     """
 
     # Cookie - holds some information for the bootloader. C struct format definition. '!' at the beginning means network
-    # byte order. C struct looks like:
+    # byte order. Version 1 archives use 32-bit offsets and lengths; version 2 archives use 64-bit ones, and are marked
+    # by zero in place of the 32-bit pkg_length field of version 1 cookie. C structs look like:
     #
-    # typedef struct _archive_cookie
+    # typedef struct _archive_cookie_v1
     # {
     #     char magic[8];
     #     uint32_t pkg_length;
@@ -51,16 +63,32 @@ class CArchiveReader:
     #     uint32_t toc_length;
     #     uint32_t python_version;
     #     char python_libname[64];
+    # } ARCHIVE_COOKIE_V1;
+    #
+    # typedef struct _archive_cookie
+    # {
+    #     char magic[8];
+    #     uint32_t v1_marker; /* always 0 */
+    #     uint32_t format_version;
+    #     uint64_t pkg_length;
+    #     uint64_t toc_offset;
+    #     uint64_t toc_length;
+    #     uint32_t python_version;
+    #     uint32_t flags; /* PKG_FLAG_* */
+    #     char python_libname[64];
     # } ARCHIVE_COOKIE;
     #
     _COOKIE_MAGIC_PATTERN = b'MEI\014\013\012\013\016'
 
-    _COOKIE_FORMAT = '!8sIIII64s'
+    _COOKIE_FORMAT_V1 = '!8sIIII64s'
+    _COOKIE_LENGTH_V1 = struct.calcsize(_COOKIE_FORMAT_V1)
+
+    _COOKIE_FORMAT = '!8sIIQQQII64s'
     _COOKIE_LENGTH = struct.calcsize(_COOKIE_FORMAT)
 
     # TOC entry:
     #
-    # typedef struct _toc_entry
+    # typedef struct _toc_entry_v1
     # {
     #     uint32_t entry_length;
     #     uint32_t offset;
@@ -69,36 +97,84 @@ class CArchiveReader:
     #     unsigned char compression_flag;
     #     char typecode;
     #     char name[1]; /* Variable-length name, padded to multiple of 16 */
+    # } TOC_ENTRY_V1;
+    #
+    # typedef struct _toc_entry
+    # {
+    #     uint32_t entry_length;
+    #     uint32_t checksum; /* CRC-32 of uncompressed data, if PKG_FLAG_CHECKSUMS is set; otherwise 0 */
+    #     uint64_t offset;
+    #     uint64_t length;
+    #     uint64_t uncompressed_length;
+    #     unsigned char compression_flag;
+    #     char typecode;
+    #     char name[1]; /* Variable-length name, padded to multiple of 16 */
     # } TOC_ENTRY;
     #
-    _TOC_ENTRY_FORMAT = '!IIIIBc'
+    _TOC_ENTRY_FORMAT_V1 = '!IIIIBc'
+    _TOC_ENTRY_LENGTH_V1 = struct.calcsize(_TOC_ENTRY_FORMAT_V1)
+
+    _TOC_ENTRY_FORMAT = '!IIQQQBc'
     _TOC_ENTRY_LENGTH = struct.calcsize(_TOC_ENTRY_FORMAT)
 
+    # Trailer (optional; not present in archives created by older versions of PyInstaller):
+    #
+    # typedef struct _archive_trailer
+    # {
+    #     uint64_t cookie_distance; /* distance from start of cookie to end of trailer */
+    #     char magic[8];
+    # } ARCHIVE_TRAILER;
+    #
+    _TRAILER_MAGIC_PATTERN = b'MEI\016\013\012\013\016'
+    _TRAILER_FORMAT = '!Q8s'
+    _TRAILER_LENGTH = struct.calcsize(_TRAILER_FORMAT)
+
     def __init__(self, filename):
         self._filename = filename
         self._start_offset = 0
         self._toc_offset = 0
         self._toc_length = 0
+        self.format_version = 0
+        self.has_checksums = False
 
         self.toc = {}
         self.options = []
+        self.checksums = {}
 
         # Load TOC
         with open(self._filename, "rb") as fp:
-            # Find cookie MAGIC pattern
-            cookie_start_offset = self._find_magic_pattern(fp, self._COOKIE_MAGIC_PATTERN)
+            # Find cookie; use the trailer, if available, and fall back to searching for cookie MAGIC pattern.
+            cookie_start_offset = self._find_cookie_via_trailer(fp)
+            if cookie_start_offset == -1:
+                cookie_start_offset = self._find_magic_pattern(fp, self._COOKIE_MAGIC_PATTERN)
             if cookie_start_offset == -1:
                 raise ArchiveReadError("Could not find COOKIE magic pattern!")
 
-            # Read the whole cookie
+            # Read the whole cookie; first as version 1 cookie, which is shorter, and if it turns out to be version 2+
+            # cookie, re-read it.
             fp.seek(cookie_start_offset, os.SEEK_SET)
-            cookie_data = fp.read(self._COOKIE_LENGTH)
+            cookie_data = fp.read(self._COOKIE_LENGTH_V1)
 
             magic, archive_length, toc_offset, toc_length, pyvers, pylib_name = \
-                struct.unpack(self._COOKIE_FORMAT, cookie_data)
+                struct.unpack(self._COOKIE_FORMAT_V1, cookie_data)
+            cookie_length = self._COOKIE_LENGTH_V1
+            self.format_version = 1
+
+            if archive_length == 0:
+                fp.seek(cookie_start_offset, os.SEEK_SET)
+                cookie_data = fp.read(self._COOKIE_LENGTH)
+
+                magic, _, self.format_version, archive_length, toc_offset, toc_length, pyvers, flags, pylib_name = \
+                    struct.unpack(self._COOKIE_FORMAT, cookie_data)
+                cookie_length = self._COOKIE_LENGTH
+
+                if self.format_version != 2:
+                    raise ArchiveReadError(f"Unsupported archive format version: {self.format_version}!")
+
+                self.has_checksums = bool(flags & PKG_FLAG_CHECKSUMS)
 
             # Compute start of the the archive
-            self._start_offset = (cookie_start_offset + self._COOKIE_LENGTH) - archive_length
+            self._start_offset = (cookie_start_offset + cookie_length) - archive_length
 
             # Verify that Python shared library name is set
             if not pylib_name:
@@ -108,7 +184,29 @@ def __init__(self, filename):
             fp.seek(self._start_offset + toc_offset)
             toc_data = fp.read(toc_length)
 
-            self.toc, self.options = self._parse_toc(toc_data)
+            self.toc, self.options, checksums = self._parse_toc(toc_data, self.format_version)
+            if self.has_checksums:
+                self.checksums = checksums
+
+    @classmethod
+    def _find_cookie_via_trailer(cls, fp):
+        fp.seek(0, os.SEEK_END)
+        end_pos = fp.tell()
+        if end_pos < cls._TRAILER_LENGTH:
+            return -1
+
+        fp.seek(end_pos - cls._TRAILER_LENGTH, os.SEEK_SET)
+        cookie_distance, magic = struct.unpack(cls._TRAILER_FORMAT, fp.read(cls._TRAILER_LENGTH))
+        if magic != cls._TRAILER_MAGIC_PATTERN or cookie_distance > end_pos:
+            return -1
+
+        # Verify that cookie is where the trailer says it is.
+        cookie_start_offset = end_pos - cookie_distance
+        fp.seek(cookie_start_offset, os.SEEK_SET)
+        if fp.read(len(cls._COOKIE_MAGIC_PATTERN)) != cls._COOKIE_MAGIC_PATTERN:
+            return -1
+
+        return cookie_start_offset
 
     @staticmethod
     def _find_magic_pattern(fp, magic_pattern):
@@ -138,17 +236,25 @@ def _find_magic_pattern(fp, magic_pattern):
         return magic_offset
 
     @classmethod
-    def _parse_toc(cls, data):
+    def _parse_toc(cls, data, format_version=2):
         options = []
         toc = {}
+        checksums = {}
         cur_pos = 0
         while cur_pos < len(data):
             # Read and parse the fixed-size TOC entry header
-            entry_length, entry_offset, data_length, uncompressed_length, compression_flag, typecode = \
-                struct.unpack(cls._TOC_ENTRY_FORMAT, data[cur_pos:(cur_pos + cls._TOC_ENTRY_LENGTH)])
-            cur_pos += cls._TOC_ENTRY_LENGTH
+            if format_version == 1:
+                header_length = cls._TOC_ENTRY_LENGTH_V1
+                entry_length, entry_offset, data_length, uncompressed_length, compression_flag, typecode = \
+                    struct.unpack(cls._TOC_ENTRY_FORMAT_V1, data[cur_pos:(cur_pos + header_length)])
+                checksum = 0
+            else:
+                header_length = cls._TOC_ENTRY_LENGTH
+                entry_length, checksum, entry_offset, data_length, uncompressed_length, compression_flag, typecode = \
+                    struct.unpack(cls._TOC_ENTRY_FORMAT, data[cur_pos:(cur_pos + header_length)])
+            cur_pos += header_length
             # Read variable-length name
-            name_length = entry_length - cls._TOC_ENTRY_LENGTH
+            name_length = entry_length - header_length
             name, *_ = struct.unpack(f'{name_length}s', data[cur_pos:(cur_pos + name_length)])
             cur_pos += name_length
             # Name string may contain up to 15 bytes of padding
@@ -162,8 +268,9 @@ def _parse_toc(cls, data):
                 options.append(name)
             else:
                 toc[name] = (entry_offset, data_length, uncompressed_length, compression_flag, typecode)
+                checksums[name] = checksum
 
-        return toc, options
+        return toc, options, checksums
 
     def extract(self, name):
         """
@@ -179,12 +286,73 @@ def extract(self, name):
             fp.seek(self._start_offset + entry_offset, os.SEEK_SET)
             data = fp.read(data_length)
 
-        if compression_flag:
+        if compression_flag == PKG_COMPRESSION_ZLIB:
             import zlib
             data = zlib.decompress(data)
+        elif compression_flag == PKG_COMPRESSION_LZ4:
+            from PyInstaller.archive import lz4_codec
+            data = lz4_codec.decompress(data)
+        elif compression_flag == PKG_COMPRESSION_ZLIB_BLOCKS:
+            data = self._decompress_zlib_blocks(data)
+        elif compression_flag != PKG_COMPRESSION_NONE:
+            raise ArchiveReadError(f"Entry {name} uses unsupported compression method {compression_flag}!")
+
+        if self.has_checksums:
+            import zlib
+            if zlib.crc32(data) != self.checksums[name]:
+                raise ArchiveReadError(f"Checksum mismatch for entry {name}; the archive is corrupted!")
 
         return data
 
+    def get_checksum(self, name):
+        """
+        Return the CRC-32 checksum (as computed by `zlib.crc32`) of the uncompressed data of the given entry, or None if
+        the archive does not contain checksums.
+        """
+        if name not in self.toc:
+            raise KeyError(f"No entry named {name} found in the archive!")
+        return self.checksums.get(name)
+
+    def verify_file(self, name, filename):
+        """
+        Verify that the contents of the given file (for example, a file previously extracted from the archive) match
+        the data of the given entry, using the entry's checksum; the entry's data is not extracted. Returns True if the
+        file matches, and False otherwise. Raises ArchiveReadError if the archive does not contain checksums.
+        """
+        checksum = self.get_checksum(name)
+        if checksum is None:
+            raise ArchiveReadError("Archive does not contain checksums!")
+
+        import zlib
+        file_checksum = 0
+        file_length = 0
+        with open(filename, 'rb') as fp:
+            while True:
+                chunk = fp.read(1024 * 1024)
+                if not chunk:
+                    break
+                file_checksum = zlib.crc32(chunk, file_checksum)
+                file_length += len(chunk)
+
+        uncompressed_length = self.toc[name][2]
+        return file_length == uncompressed_length and file_checksum == checksum
+
+    @staticmethod
+    def _decompress_zlib_blocks(data):
+        """
+        Decompress the data of an entry that is stored as a sequence of independently-compressed zlib blocks. The data
+        starts with the block index: block size and number of blocks, followed by compressed length of each block.
+        """
+        import zlib
+        block_size, num_blocks = struct.unpack_from('!II', data, 0)
+        block_lengths = struct.unpack_from(f'!{num_blocks}I', data, 8)
+        offset = 8 + 4 * num_blocks
+        blocks = []
+        for block_length in block_lengths:
+            blocks.append(zlib.decompress(data[offset:offset + block_length]))
+            offset += block_length
+        return b''.join(blocks)
+
     def open_embedded_archive(self, name):
         """
         Open new archive reader for the embedded archive.
@@ -12,6 +12,8 @@
 Utilities to create data structures for embedding Python modules and additional files into the executable.
 """
 
+import hashlib
+import io
 import marshal
 import os
 import shutil
@@ -19,9 +21,14 @@
 import sys
 import zlib
 
+from PyInstaller.archive.readers import (
+    PKG_COMPRESSION_LZ4, PKG_COMPRESSION_NONE, PKG_COMPRESSION_ZLIB, PKG_COMPRESSION_ZLIB_BLOCKS, PKG_FLAG_CHECKSUMS
+)
 from PyInstaller.building.utils import get_code_object, strip_paths_in_code
 from PyInstaller.compat import BYTECODE_MAGIC, is_win, strict_collect_mode
-from PyInstaller.loader.pyimod01_archive import PYZ_ITEM_MODULE, PYZ_ITEM_NSPKG, PYZ_ITEM_PKG
+from PyInstaller.loader.pyimod01_archive import (
+    PYZ_ITEM_COLD, PYZ_ITEM_MODULE, PYZ_ITEM_NSPKG, PYZ_ITEM_PKG, ZlibArchiveReader
+)
 
 
 class ZlibArchiveWriter:
@@ -56,21 +63,58 @@ def __init__(self, filename, entries, code_dict=None):
                 toc_entry = self._write_entry(fp, entry, code_dict)
                 toc.append(toc_entry)
 
-            # Write TOC
-            toc_offset = fp.tell()
-            toc_data = marshal.dumps(toc)
-            fp.write(toc_data)
+            self._write_toc_and_header(fp, toc)
 
-            # Write header:
-            #  - PYZ magic pattern (4 bytes)
-            #  - python bytecode magic pattern (4 bytes)
-            #  - TOC offset (32-bit int, 4 bytes)
-            #  - 4 unused bytes
-            fp.seek(0, os.SEEK_SET)
+    @classmethod
+    def _write_toc_and_header(cls, fp, toc):
+        # Write TOC
+        toc_offset = fp.tell()
+        toc_data = marshal.dumps(toc)
+        fp.write(toc_data)
+
+        # Write header:
+        #  - PYZ magic pattern (4 bytes)
+        #  - python bytecode magic pattern (4 bytes)
+        #  - TOC offset (32-bit int, 4 bytes)
+        #  - 4 unused bytes
+        fp.seek(0, os.SEEK_SET)
+
+        fp.write(cls._PYZ_MAGIC_PATTERN)
+        fp.write(BYTECODE_MAGIC)
+        fp.write(struct.pack('!i', toc_offset))
 
-            fp.write(self._PYZ_MAGIC_PATTERN)
-            fp.write(BYTECODE_MAGIC)
-            fp.write(struct.pack('!i', toc_offset))
+    @classmethod
+    def split_archive(cls, filename, main_filename, cold_filename, is_cold):
+        """
+        Split an existing PYZ archive into the main archive and the cold archive. The data of entries for which the
+        `is_cold` callable returns True is moved into the cold archive; the TOC of the main archive still lists these
+        entries (with the `PYZ_ITEM_COLD` flag in their type code), so that the modules can be found without opening the
+        cold archive. Returns the number of entries that were moved into the cold archive.
+        """
+        main_toc = []
+        cold_toc = []
+
+        toc = ZlibArchiveReader(filename, 0).toc
+        with open(filename, 'rb') as in_fp, open(main_filename, 'wb') as main_fp, open(cold_filename, 'wb') as cold_fp:
+            # Reserve space for the headers.
+            main_fp.write(b'\0' * cls._HEADER_LENGTH)
+            cold_fp.write(b'\0' * cls._HEADER_LENGTH)
+
+            for name, (typecode, entry_offset, entry_length) in toc.items():
+                in_fp.seek(entry_offset, os.SEEK_SET)
+                obj = in_fp.read(entry_length)
+                if is_cold(name):
+                    cold_toc.append((name, (typecode, cold_fp.tell(), len(obj))))
+                    cold_fp.write(obj)
+                    main_toc.append((name, (typecode | PYZ_ITEM_COLD, 0, 0)))
+                else:
+                    main_toc.append((name, (typecode, main_fp.tell(), len(obj))))
+                    main_fp.write(obj)
+
+            cls._write_toc_and_header(main_fp, main_toc)
+            cls._write_toc_and_header(cold_fp, cold_toc)
+
+        return len(cold_toc)
 
     @classmethod
     def _write_entry(cls, fp, entry, code_dict):
@@ -100,6 +144,26 @@ def _write_entry(cls, fp, entry, code_dict):
         return toc_entry
 
 
+class _ChecksumReader:
+    """
+    Wrapper for input file object that computes CRC-32 checksum of the data as it is read.
+    """
+    def __init__(self, fp):
+        self._fp = fp
+        self.checksum = 0
+
+    def read(self, size=-1):
+        data = self._fp.read(size)
+        self.checksum = zlib.crc32(data, self.checksum)
+        return data
+
+    def readinto(self, buffer):
+        num_read = self._fp.readinto(buffer)
+        if num_read:
+            self.checksum = zlib.crc32(memoryview(buffer)[:num_read], self.checksum)
+        return num_read
+
+
 class CArchiveWriter:
     """
     Writer for PyInstaller's CArchive (PKG) archive.
@@ -111,16 +175,42 @@ class CArchiveWriter:
     """
     _COOKIE_MAGIC_PATTERN = b'MEI\014\013\012\013\016'
 
+    # Archive format version. Version 2 uses 64-bit offsets and lengths in the cookie and TOC entries, which lifts the
+    # 4 GiB limit on the archive size.
+    _FORMAT_VERSION = 2
+
     # For cookie and TOC entry structure, see `PyInstaller.archive.readers.CArchiveReader`.
-    _COOKIE_FORMAT = '!8sIIII64s'
+    _COOKIE_FORMAT = '!8sIIQQQII64s'
     _COOKIE_LENGTH = struct.calcsize(_COOKIE_FORMAT)
 
-    _TOC_ENTRY_FORMAT = '!IIIIBc'
+    _TOC_ENTRY_FORMAT = '!IIQQQBc'
     _TOC_ENTRY_LENGTH = struct.calcsize(_TOC_ENTRY_FORMAT)
 
+    # Fixed-size trailer that follows the cookie and allows the bootloader to locate the cookie without scanning the
+    # file for its magic pattern.
+    _TRAILER_MAGIC_PATTERN = b'MEI\016\013\012\013\016'
+    _TRAILER_FORMAT = '!Q8s'
+    _TRAILER_LENGTH = struct.calcsize(_TRAILER_FORMAT)
+
     _COMPRESSION_LEVEL = 9  # zlib compression level
 
-    def __init__(self, filename, entries, pylib_name):
+    # Files of at least this size that are to be zlib-compressed are compressed as a sequence of independent blocks
+    # of the given size, so that the bootloader can decompress them in parallel.
+    _ZLIB_BLOCKS_THRESHOLD = 64 * 1024 * 1024
+    _ZLIB_BLOCK_SIZE = 4 * 1024 * 1024
+
+    # Typecodes of entries that are extracted to the filesystem in onefile mode, and are therefore subject to data
+    # alignment (if enabled).
+    _ALIGNABLE_TYPECODES = {'b', 'x', 'Z'}
+
+    # Typecodes of entries that are extracted to the filesystem in onefile mode (or in MERGE mode, in case of 'd'). The
+    # parent directories of these entries are recorded in the directory table.
+    _EXTRACTABLE_TYPECODES = {'b', 'x', 'Z', 'n', 'd'}
+
+    # Name of the directory table entry.
+    _DIRECTORY_TABLE_NAME = 'pyi-directory-table'
+
+    def __init__(self, filename, entries, pylib_name, data_alignment=0, checksums=False, entry_order=None):
         """
         filename
             Target filename of the archive.
@@ -128,19 +218,62 @@ def __init__(self, filename, entries, pylib_name):
             An iterable containing entries in the form of tuples: (dest_name, src_name, compress, typecode), where
             `dest_name` is the name under which the resource is stored in the archive (and name under which it is
             extracted at runtime), `src_name` is name of the file from which the resouce is read, `compress` is a
-            boolean compression flag, and `typecode` is the Analysis-level TOC typecode.
+            boolean compression flag or compression method (one of `PKG_COMPRESSION_*` values; `True` corresponds to
+            zlib), and `typecode` is the Analysis-level TOC typecode.
         pylib_name
             Name of the python shared library.
+        data_alignment
+            Optional alignment (in bytes; must be a power of two) of the data of stored (uncompressed) extractable
+            entries, relative to the start of the archive. If the archive itself is placed at an aligned offset in the
+            executable, and the alignment matches the file system block size, this allows the bootloader to extract
+            such entries by cloning the data blocks (on file systems that support reflinks). Entries smaller than the
+            alignment are not aligned. The default (0) disables the alignment.
+        checksums
+            Optional flag indicating that CRC-32 checksums of entries' uncompressed data should be stored in the TOC
+            entries. The bootloader verifies the checksums when extracting the entries.
+        entry_order
+            Optional list of names (with forward slashes) in the order in which the corresponding files are first
+            accessed at startup, for example, a startup profile recorded by `pyimod06_profile`. If given, the entries
+            are reordered so that the data is read by a single forward sweep over the archive: entries without
+            extractable data (options, bootstrap modules and scripts, PYZ archives) keep their relative order and come
+            first, followed by the python shared library and base_library.zip, then the extractable entries listed in
+            `entry_order` (in the listed order), and finally the remaining extractable entries (in their original
+            order). The number of extractable entries that precede the remaining ones is stored in the
+            `pyi-startup-entries` OPTION entry; with deferred extraction, the bootloader extracts these entries before
+            starting the application.
         """
-        self._collected_names = set()  # Track collected names for strict package mode.
+        if data_alignment < 0 or (data_alignment & (data_alignment - 1)) != 0:
+            raise ValueError(f"Invalid data alignment {data_alignment}: must be a power of two!")
 
-        with open(filename, "wb") as fp:
+        self._collected_names = set()  # Track collected names for strict package mode.
+        self._directories = set()  # Parent directories of extractable entries.
+        self._data_alignment = data_alignment
+        self._checksums = checksums
+        self._extraction_cache = False  # Set when the persistent extraction cache option entry is encountered.
+        # (compression, length, aligned) -> list of [src_name, digest, data] of already-written file entries, for
+        # deduplication. The digests are computed lazily, only for files whose key matches that of another file.
+        self._blobs = {}
+
+        if entry_order is not None:
+            entries = self._order_entries(entries, entry_order, pylib_name)
+
+        with open(filename, "w+b") as fp:
             # Write entries' data and collect TOC entries
             toc = []
             for entry in entries:
                 toc_entry = self._write_entry(fp, entry)
                 toc.append(toc_entry)
 
+            # Write directory table, which allows the bootloader to create the whole directory tree of extractable
+            # entries up front, instead of checking the parent directories of each extracted file.
+            if self._directories:
+                toc.append(self._write_directory_table(fp))
+
+            # If persistent extraction cache is enabled, store the hash of archive's contents, which the bootloader
+            # uses to identify the application's directory in the cache.
+            if self._extraction_cache:
+                toc.append(self._write_archive_hash(fp, toc))
+
             # Write TOC
             toc_offset = fp.tell()
             toc_data = self._serialize_toc(toc)
@@ -154,21 +287,66 @@ def __init__(self, filename, entries, pylib_name):
             cookie_data = struct.pack(
                 self._COOKIE_FORMAT,
                 self._COOKIE_MAGIC_PATTERN,
+                0,  # In place of 32-bit archive length field from version 1; marks version 2+ cookie.
+                self._FORMAT_VERSION,
                 archive_length,
                 toc_offset,
                 toc_length,
                 pyvers,
+                PKG_FLAG_CHECKSUMS if checksums else 0,  # flags
                 pylib_name.encode('ascii'),
             )
 
             fp.write(cookie_data)
 
+            # Write trailer
+            trailer_data = struct.pack(
+                self._TRAILER_FORMAT,
+                self._COOKIE_LENGTH + self._TRAILER_LENGTH,  # Distance from start of cookie to end of trailer.
+                self._TRAILER_MAGIC_PATTERN,
+            )
+
+            fp.write(trailer_data)
+
+    @classmethod
+    def _order_entries(cls, entries, entry_order, pylib_name):
+        """
+        Reorder the entries according to the given access order, and append the `pyi-startup-entries` OPTION entry;
+        see `entry_order` argument of the constructor.
+        """
+        rank = {}
+        for name in entry_order:
+            rank.setdefault(name, len(rank))
+
+        def _sort_key(indexed_entry):
+            index, (dest_name, src_name, compress, typecode) = indexed_entry
+            if typecode not in cls._EXTRACTABLE_TYPECODES or typecode == 'd':
+                return (0, 0, index)
+            name = os.path.normpath(dest_name).replace(os.sep, '/')
+            if name == pylib_name:
+                return (1, 0, index)
+            if name == 'base_library.zip':
+                return (1, 1, index)
+            if name in rank:
+                return (2, rank[name], index)
+            return (3, 0, index)
+
+        sorted_entries = sorted(enumerate(entries), key=_sort_key)
+        num_startup_entries = sum(
+            1 for indexed_entry in sorted_entries
+            if indexed_entry[1][3] in cls._EXTRACTABLE_TYPECODES and _sort_key(indexed_entry)[0] < 3
+        )
+        option_entry = (f"pyi-startup-entries {num_startup_entries}", '', False, 'o')
+        return [entry for index, entry in sorted_entries] + [option_entry]
+
     def _write_entry(self, fp, entry):
         dest_name, src_name, compress, typecode = entry
 
         # Write OPTION entries as-is, without normalizing them. This also exempts them from duplication check,
         # allowing them to be specified multiple times.
         if typecode == 'o':
+            if dest_name.split(' ', 1)[0] == 'pyi-extraction-cache':
+                self._extraction_cache = True
             return self._write_blob(fp, b"", dest_name, typecode)
 
         # Ensure forward slashes in paths are on Windows converted to back slashes '\\', as on Windows the bootloader
@@ -184,6 +362,10 @@ def _write_entry(self, fp, entry):
             if typecode == 'n':
                 src_name = src_name.replace(os.path.sep, '\\')
 
+        # Record the parent directories of extractable entries.
+        if typecode in self._EXTRACTABLE_TYPECODES:
+            self._add_parent_directories(dest_name)
+
         # Strict pack/collect mode: keep track of the destination names, and raise an error if we try to add a duplicate
         # (a file with same destination name, subject to OS case normalization rules).
         if strict_collect_mode:
@@ -232,27 +414,116 @@ def _write_entry(self, fp, entry):
         else:
             return self._write_file(fp, src_name, dest_name, typecode, compress=compress)
 
+    def _add_parent_directories(self, dest_name):
+        """
+        Add all parent directories of the given (normalized) destination name to the directory table.
+        """
+        separator = '\\' if is_win else os.path.sep
+        components = dest_name.split(separator)[:-1]
+        for idx in range(len(components)):
+            self._directories.add(separator.join(components[:idx + 1]))
+
+    def _write_directory_table(self, out_fp):
+        """
+        Write the directory table: the sorted list of parent directories of all extractable entries, as NULL-terminated
+        UTF-8 strings. Due to sorting, each directory is preceded by its parent directory.
+        """
+        data = b''.join(directory.encode('utf-8') + b'\x00' for directory in sorted(self._directories))
+        return self._write_blob(out_fp, data, self._DIRECTORY_TABLE_NAME, 'D', compress=True)
+
+    def _write_archive_hash(self, fp, toc):
+        """
+        Compute SHA-256 hash of the data written so far and of the TOC entries, and write it as an OPTION entry.
+        """
+        hasher = hashlib.sha256()
+        fp.flush()
+        fp.seek(0, os.SEEK_SET)
+        tmp_buffer = bytearray(16 * 1024)
+        while True:
+            num_read = fp.readinto(tmp_buffer)
+            if not num_read:
+                break
+            hasher.update(memoryview(tmp_buffer)[:num_read])
+        hasher.update(self._serialize_toc(toc))
+        # Return to the end of data, where the TOC is to be written.
+        fp.seek(0, os.SEEK_END)
+        return self._write_blob(fp, b"", f"pyi-archive-hash {hasher.hexdigest()}", 'o')
+
+    @staticmethod
+    def _get_compression_method(compress):
+        """
+        Convert the compression flag or compression method of an entry into the compression method ID that is stored in
+        the TOC entry.
+        """
+        compression = int(compress)  # False -> PKG_COMPRESSION_NONE, True -> PKG_COMPRESSION_ZLIB
+        if compression not in {
+            PKG_COMPRESSION_NONE, PKG_COMPRESSION_ZLIB, PKG_COMPRESSION_LZ4, PKG_COMPRESSION_ZLIB_BLOCKS
+        }:
+            raise ValueError(f"Unsupported compression method: {compress!r}")
+        return compression
+
     def _write_blob(self, out_fp, blob: bytes, dest_name, typecode, compress=False):
         """
         Write the binary contents (**blob**) of a small file to the archive and return the corresponding CArchive TOC
         entry.
         """
+        compression = self._get_compression_method(compress)
         data_offset = out_fp.tell()
         data_length = len(blob)
-        if compress:
+        checksum = zlib.crc32(blob) if self._checksums else 0
+        if compression == PKG_COMPRESSION_ZLIB:
             blob = zlib.compress(blob, level=self._COMPRESSION_LEVEL)
+        elif compression == PKG_COMPRESSION_LZ4:
+            from PyInstaller.archive import lz4_codec
+            blob = lz4_codec.compress(blob)
+        elif compression == PKG_COMPRESSION_ZLIB_BLOCKS:
+            self._write_zlib_blocks(out_fp, io.BytesIO(blob), data_length)
+            return (data_offset, out_fp.tell() - data_offset, data_length, compression, checksum, typecode, dest_name)
         out_fp.write(blob)
 
-        return (data_offset, len(blob), data_length, int(compress), typecode, dest_name)
+        return (data_offset, len(blob), data_length, compression, checksum, typecode, dest_name)
 
     def _write_file(self, out_fp, src_name, dest_name, typecode, compress=False):
         """
         Stream copy a large file into the archive and return the corresponding CArchive TOC entry.
         """
-        data_offset = out_fp.tell()
+        compression = self._get_compression_method(compress)
         data_length = os.stat(src_name).st_size
+
+        # Compress large files as independent blocks.
+        if compression == PKG_COMPRESSION_ZLIB and data_length >= self._ZLIB_BLOCKS_THRESHOLD:
+            compression = PKG_COMPRESSION_ZLIB_BLOCKS
+
+        # Align the data of stored extractable entries, if requested.
+        aligned = bool(
+            self._data_alignment and compression == PKG_COMPRESSION_NONE and typecode in self._ALIGNABLE_TYPECODES
+            and data_length >= self._data_alignment
+        )
+
+        # Files with identical contents (e.g., shared libraries collected under several names) share a single copy of
+        # the data in the archive; the bootloader links the extracted duplicates to the first extracted file, if
+        # possible. An entry that requires aligned data must not share the data of an unaligned entry. To avoid reading
+        # each file twice, the contents are hashed only if another file with the same key has already been written.
+        blob_key = (compression, data_length, aligned)
+        candidates = self._blobs.setdefault(blob_key, [])
+        digest = None
+        for candidate in candidates:
+            if digest is None:
+                digest = self._compute_file_digest(src_name)
+            if candidate[1] is None:
+                candidate[1] = self._compute_file_digest(candidate[0])
+            if candidate[1] == digest:
+                return (*candidate[2], typecode, dest_name)
+
+        if aligned:
+            padding_length = -out_fp.tell() % self._data_alignment
+            out_fp.write(b'\0' * padding_length)
+
+        data_offset = out_fp.tell()
         with open(src_name, 'rb') as in_fp:
-            if compress:
+            if self._checksums:
+                in_fp = _ChecksumReader(in_fp)
+            if compression == PKG_COMPRESSION_ZLIB:
                 tmp_buffer = bytearray(16 * 1024)
                 compressor = zlib.compressobj(self._COMPRESSION_LEVEL)
                 while True:
@@ -261,16 +532,63 @@ def _write_file(self, out_fp, src_name, dest_name, typecode, compress=False):
                         break
                     out_fp.write(compressor.compress(tmp_buffer[:num_read]))
                 out_fp.write(compressor.flush())
+            elif compression == PKG_COMPRESSION_LZ4:
+                from PyInstaller.archive import lz4_codec
+                lz4_codec.compress_file(in_fp, out_fp)
+            elif compression == PKG_COMPRESSION_ZLIB_BLOCKS:
+                self._write_zlib_blocks(out_fp, in_fp, data_length)
             else:
                 shutil.copyfileobj(in_fp, out_fp)
+            checksum = in_fp.checksum if self._checksums else 0
+
+        blob = (data_offset, out_fp.tell() - data_offset, data_length, compression, checksum)
+        candidates.append([src_name, digest, blob])
+        return (*blob, typecode, dest_name)
+
+    @staticmethod
+    def _compute_file_digest(src_name):
+        """
+        Compute SHA-256 digest of the file's contents.
+        """
+        hasher = hashlib.sha256()
+        with open(src_name, 'rb') as in_fp:
+            tmp_buffer = bytearray(16 * 1024)
+            while True:
+                num_read = in_fp.readinto(tmp_buffer)
+                if not num_read:
+                    break
+                hasher.update(memoryview(tmp_buffer)[:num_read])
+        return hasher.digest()
+
+    def _write_zlib_blocks(self, out_fp, in_fp, data_length):
+        """
+        Compress the data from the input file object as a sequence of independent zlib blocks, preceded by the block
+        index (block size, number of blocks, and compressed length of each block; see `ARCHIVE_BLOCK_INDEX` in the
+        bootloader).
+        """
+        block_size = self._ZLIB_BLOCK_SIZE
+        num_blocks = (data_length + block_size - 1) // block_size
+
+        # Reserve space for the block index, which is written once the blocks are compressed.
+        index_offset = out_fp.tell()
+        out_fp.write(b'\0' * (8 + 4 * num_blocks))
+
+        block_lengths = []
+        for _ in range(num_blocks):
+            block = zlib.compress(in_fp.read(block_size), level=self._COMPRESSION_LEVEL)
+            out_fp.write(block)
+            block_lengths.append(len(block))
 
-        return (data_offset, out_fp.tell() - data_offset, data_length, int(compress), typecode, dest_name)
+        end_offset = out_fp.tell()
+        out_fp.seek(index_offset, os.SEEK_SET)
+        out_fp.write(struct.pack(f'!II{num_blocks}I', block_size, num_blocks, *block_lengths))
+        out_fp.seek(end_offset, os.SEEK_SET)
 
     @classmethod
     def _serialize_toc(cls, toc):
         serialized_toc = []
         for toc_entry in toc:
-            data_offset, compressed_length, data_length, compress, typecode, name = toc_entry
+            data_offset, compressed_length, data_length, compress, checksum, typecode, name = toc_entry
 
             # Encode names as UTF-8. This should be safe as standard python modules only contain ASCII-characters (and
             # standard shared libraries should have the same), and thus the C-code still can handle this correctly.
@@ -289,6 +607,7 @@ def _serialize_toc(cls, toc):
             serialized_entry = struct.pack(
                 cls._TOC_ENTRY_FORMAT + f"{name_length}s",  # "Ns" format automatically pads the string with zero bytes.
                 cls._TOC_ENTRY_LENGTH + name_length,
+                checksum,
                 data_offset,
                 compressed_length,
                 data_length,
@@ -15,6 +15,8 @@
 is a way how PyInstaller does the dependency analysis and creates executable.
 """
 
+import fnmatch
+import hashlib
 import os
 import subprocess
 import time
@@ -24,6 +26,7 @@
 
 from PyInstaller import HOMEPATH, PLATFORM
 from PyInstaller import log as logging
+from PyInstaller.archive.readers import PKG_COMPRESSION_LZ4
 from PyInstaller.archive.writers import CArchiveWriter, ZlibArchiveWriter
 from PyInstaller.building.datastruct import Target, _check_guts_eq, normalize_pyz_toc, normalize_toc
 from PyInstaller.building.utils import (
@@ -31,7 +34,9 @@
     compile_pymodule
 )
 from PyInstaller.building.splash import Splash  # argument type validation in EXE
-from PyInstaller.compat import is_cygwin, is_darwin, is_linux, is_win, strict_collect_mode, is_nogil
+from PyInstaller.compat import (
+    EXTENSION_SUFFIXES, is_cygwin, is_darwin, is_linux, is_win, strict_collect_mode, is_nogil
+)
 from PyInstaller.depend import bindepend
 from PyInstaller.depend.analysis import get_bootstrap_modules
 import PyInstaller.utils.misc as miscutils
@@ -199,7 +204,14 @@ def __init__(
         upx_exclude=None,
         target_arch=None,
         codesign_identity=None,
-        entitlements_file=None
+        entitlements_file=None,
+        data_alignment=0,
+        uncompressed_binaries=False,
+        checksums=False,
+        cold_name=None,
+        cold_entries=None,
+        startup_profile=None,
+        entry_order=None,
     ):
         """
         toc
@@ -211,13 +223,36 @@ def __init__(
         cdict
             Dictionary that specifies compression by typecode. For Example, PYZ is left uncompressed so that it
             can be accessed inside the PKG. The default uses sensible values. If zlib is not available, no
-            compression is used.
+            compression is used. The values are either `COMPRESSED` (zlib) or `UNCOMPRESSED`, or `COMPRESSED_LZ4`,
+            which trades some compression ratio for faster decompression at run-time.
         exclude_binaries
             If True, EXTENSIONs and BINARYs will be left out of the PKG, and forwarded to its container (usually
             a COLLECT).
         strip_binaries
             If True, use 'strip' command to reduce the size of binary files.
         upx_binaries
+        data_alignment
+            Alignment (in bytes) of data of stored (uncompressed) extractable entries within the PKG. See
+            `CArchiveWriter`.
+        uncompressed_binaries
+            If True, store EXTENSIONs and BINARYs uncompressed, which makes their data subject to `data_alignment`.
+            Applies only if `cdict` is not given.
+        checksums
+            If True, store CRC-32 checksums of entries' data in the PKG, which are verified by the bootloader. See
+            `CArchiveWriter`.
+        cold_name
+            An optional filename for the companion cold PKG, which receives the rarely-used entries that are selected
+            via `cold_entries` and `startup_profile`. The cold PKG contains the PYZ archive with the selected modules
+            and, in onefile mode, the selected data files. If no entries are selected, the cold PKG is not created.
+        cold_entries
+            An optional list of glob patterns. Modules and data files whose names (module names and destination names
+            with forward slashes, respectively) match any of the patterns are moved into the cold PKG.
+        startup_profile
+            An optional list of module names and data file names that are used by the application (for example, at
+            startup). If given, modules and data files that are not listed are moved into the cold PKG.
+        entry_order
+            An optional list of names of modules and files in the order of their first use at startup, according to
+            which the entries are ordered in the PKG. See `CArchiveWriter`.
         """
         super().__init__()
 
@@ -234,6 +269,13 @@ def __init__(
         self.target_arch = target_arch
         self.codesign_identity = codesign_identity
         self.entitlements_file = entitlements_file
+        self.data_alignment = data_alignment
+        self.uncompressed_binaries = uncompressed_binaries
+        self.checksums = checksums
+        self.cold_name = cold_name
+        self.cold_entries = cold_entries or []
+        self.startup_profile = startup_profile
+        self.entry_order = entry_order
 
         # This dict tells PyInstaller what items embedded in the executable should be compressed.
         if self.cdict is None:
@@ -250,6 +292,11 @@ def __init__(
                 # Do not compress target names in symbolic links.
                 'SYMLINK': UNCOMPRESSED,
             }
+            # Store shared libraries and extension modules uncompressed, if requested; combined with data alignment,
+            # they can then be extracted by cloning data blocks instead of being decompressed and written.
+            if self.uncompressed_binaries:
+                self.cdict['EXTENSION'] = UNCOMPRESSED
+                self.cdict['BINARY'] = UNCOMPRESSED
 
         self.__postinit__()
 
@@ -265,12 +312,94 @@ def __init__(
         ('target_arch', _check_guts_eq),
         ('codesign_identity', _check_guts_eq),
         ('entitlements_file', _check_guts_eq),
+        ('data_alignment', _check_guts_eq),
+        ('uncompressed_binaries', _check_guts_eq),
+        ('checksums', _check_guts_eq),
+        ('cold_name', _check_guts_eq),
+        ('cold_entries', _check_guts_eq),
+        ('startup_profile', _check_guts_eq),
+        ('entry_order', _check_guts_eq),
         # no calculated/analysed values
     )
 
+    def _is_cold(self, name):
+        """
+        Check whether the module or data file with the given name should be moved into the cold PKG.
+        """
+        name = name.replace(os.sep, '/')
+        if any(fnmatch.fnmatchcase(name, pattern) for pattern in self.cold_entries):
+            return True
+        if self.startup_profile is not None and name not in self._startup_names:
+            return True
+        return False
+
+    def _split_cold_entries(self, archive_toc):
+        """
+        Move the selected entries from the given TOC into the cold PKG, and add the OPTION entry that signals the
+        presence of the cold PKG to the bootloader. Only the modules from the PYZ and the data files are eligible;
+        binaries and extension modules are loaded by the dynamic loader, and need to be readily available.
+        """
+        if self.cold_name is None or not (self.cold_entries or self.startup_profile is not None):
+            return archive_toc
+        self._startup_names = set(self.startup_profile or [])
+
+        main_toc = []
+        cold_toc = []
+        pyz_split = False  # Only the first PYZ is used by the bootloader.
+        for entry in archive_toc:
+            dest_name, src_name, compress, typecode = entry
+            if typecode == 'z' and not pyz_split:
+                pyz_split = True
+                # Split the PYZ into the main PYZ and the cold PYZ. The cold PYZ needs to be the first entry in the
+                # cold PKG, as the PYZ reader expects it at the very beginning of the file.
+                pyz_basename = os.path.splitext(self.cold_name)[0]
+                main_pyz = pyz_basename + '-main.pyz'
+                cold_pyz = pyz_basename + '-cold.pyz'
+                num_cold = ZlibArchiveWriter.split_archive(src_name, main_pyz, cold_pyz, self._is_cold)
+                if num_cold:
+                    logger.info("Moving %d module(s) into cold PKG", num_cold)
+                    main_toc.append((dest_name, main_pyz, compress, typecode))
+                    cold_toc.insert(0, (dest_name, cold_pyz, False, typecode))
+                    continue
+            elif typecode == 'x' and dest_name != 'base_library.zip' and self._is_cold(dest_name):
+                cold_toc.append(entry)
+                continue
+            main_toc.append(entry)
+
+        if not cold_toc:
+            return main_toc
+
+        logger.info("Building cold PKG (CArchive) %s", os.path.basename(self.cold_name))
+        CArchiveWriter(
+            self.cold_name,
+            cold_toc,
+            pylib_name=self.python_lib_name,
+            data_alignment=self.data_alignment,
+            checksums=self.checksums,
+        )
+
+        # The hash of the cold PKG, stored in the option value, ensures that the contents of the cold PKG are covered
+        # by the hash of the main PKG (used by the extraction cache).
+        hasher = hashlib.sha256()
+        with open(self.cold_name, 'rb') as fp:
+            for chunk in iter(lambda: fp.read(64 * 1024), b''):
+                hasher.update(chunk)
+        main_toc.append((f"pyi-cold-archive {hasher.hexdigest()}", '', False, 'o'))
+
+        # Signal the presence of data files in the cold PKG; without them, the bootloader does not need to open the
+        # cold PKG during extraction.
+        if any(typecode == 'x' for _, _, _, typecode in cold_toc):
+            main_toc.append(("pyi-cold-data-files", '', False, 'o'))
+
+        return main_toc
+
     def assemble(self):
         logger.info("Building PKG (CArchive) %s", os.path.basename(self.name))
 
+        # Remove the cold PKG from previous build; it is re-created if any entries are moved into it.
+        if self.cold_name is not None and os.path.exists(self.cold_name):
+            os.remove(self.cold_name)
+
         pkg_file = pathlib.Path(self.name).resolve()  # Used to detect attempts at PKG feeding itself
 
         bootstrap_toc = []  # TOC containing bootstrap scripts and modules, which must not be sorted.
@@ -349,9 +478,17 @@ def assemble(self):
 
         # Sort content alphabetically by type and name to enable reproducible builds.
         archive_toc.sort(key=itemgetter(3, 0))
+        archive_toc = self._split_cold_entries(archive_toc)
         # Do *not* sort modules and scripts, as their order is important.
         # TODO: Think about having all modules first and then all scripts.
-        CArchiveWriter(self.name, bootstrap_toc + archive_toc, pylib_name=self.python_lib_name)
+        CArchiveWriter(
+            self.name,
+            bootstrap_toc + archive_toc,
+            pylib_name=self.python_lib_name,
+            data_alignment=self.data_alignment,
+            checksums=self.checksums,
+            entry_order=self.entry_order,
+        )
 
         logger.info("Building PKG (CArchive) %s completed successfully.", os.path.basename(self.name))
 
@@ -421,6 +558,73 @@ def __init__(self, *args, **kwargs):
             contents_directory
                 Onedir mode only. Specifies the name of the directory where all files par the executable will be placed.
                 Setting the name to '.' (or '' or None) re-enables old onedir layout without contents directory.
+            pkg_data_alignment
+                Onefile mode, Linux only. Align the data of stored (uncompressed) files in the embedded PKG archive to
+                the given number of bytes (e.g., 4096, to match the file system block size). On file systems that
+                support reflinks (e.g., btrfs, xfs), this allows the bootloader to extract such files without copying
+                their data, if the temporary directory is on the same file system as the executable. Only the files
+                that are stored uncompressed are aligned; see `pkg_uncompressed_binaries`. The default (0) disables
+                the alignment.
+            pkg_uncompressed_binaries
+                Store shared libraries and extension modules uncompressed in the embedded PKG archive (unless `cdict`
+                is given). Combined with `pkg_data_alignment`, this allows the bootloader to extract them without
+                copying their data, at the expense of the size of the executable. The default is False.
+            pkg_checksums
+                Store CRC-32 checksums of the files' data in the embedded PKG archive. The bootloader verifies the
+                checksums when extracting the files, so that a corrupted executable (for example, due to truncated
+                download) is detected at start-up. Only the data in the archive is verified; the extracted files are
+                not read back after they are written. The checksums can also be used to verify previously-extracted
+                files without extracting them again (see `CArchiveReader.verify_file`). The default is False.
+            runtime_tmpdir_policy
+                Onefile mode, Linux only. Policy for selection of the temporary directory into which the application
+                is extracted, if `runtime_tmpdir` is not specified. With 'prefer-memory', the directory is created on a
+                memory-backed file system (tmpfs; $XDG_RUNTIME_DIR or /dev/shm), if the total size of files to extract
+                fits into the free space on the file system and into the memory that is still available within the
+                cgroup memory limit; otherwise, the standard location is used. The default ('default' or None) always
+                uses the standard location.
+            extraction_cache
+                Onefile mode, POSIX only. Extract the application into a persistent cache directory, identified by the
+                hash of the embedded PKG archive, instead of a temporary directory; subsequent runs of the same
+                executable then re-use the extracted files. Set to True to use the default cache location
+                ($XDG_CACHE_HOME/pyinstaller or ~/.cache/pyinstaller; ~/Library/Caches/pyinstaller on macOS), or to a
+                path of the cache directory. The default (None) disables the cache.
+            diskless
+                Onefile mode, Linux only. Extract the application into anonymous memory-backed files (memfd) instead
+                of a temporary directory, so that nothing is written to the file system. The collected data files are
+                then not available under `sys._MEIPASS`; their paths can be looked up in the `sys._pyi_memfd_files`
+                dictionary. Applications with splash screen or MERGE dependencies, and systems without memfd support,
+                fall back to the temporary directory. The default is False.
+            deferred_extraction
+                Onefile mode, POSIX only. Start the application process as soon as the startup-critical files (shared
+                libraries, extension modules, and base_library.zip) are extracted, and extract the remaining data files
+                in the background. Opening a data file (or listing a directory) that has not been extracted yet blocks
+                until it becomes available; querying a file (e.g., `os.path.exists()`) does not block.
+                `sys._pyi_wait_for_extraction()` waits for the extraction to complete. Has no effect with
+                splash screen, `extraction_cache`, or `diskless`. The default is False.
+            cold_entries
+                A list of glob patterns selecting rarely-used modules (by module name) and, in onefile mode, data files
+                (by destination name, with forward slashes) that are moved out of the executable-embedded PKG into the
+                companion cold PKG (`<name>.cold.pkg` next to the executable). Only the modules are loaded lazily: the
+                cold PKG is opened when one of its modules is imported. In onefile mode, its data files are not fetched
+                on demand; they are extracted at every start-up, together with the other files.
+            startup_profile
+                Path to a startup profile (relative to the spec file), which lists the names of modules and data files
+                that are used by the application, one per line, as recorded by running the application with the
+                `PYINSTALLER_STARTUP_PROFILE` environment variable set to the output file name. Modules and data files
+                that are not listed in the profile are moved into the cold PKG.
+            pkg_startup_order
+                Path to a startup profile (relative to the spec file; see `startup_profile`), according to which the
+                entries in the embedded PKG archive are ordered: the bootstrap modules, the python shared library, and
+                base_library.zip first, followed by the files in the order in which they were first used at startup,
+                and the remaining files last. This turns the reads performed at startup (and the extraction in onefile
+                mode) into a single forward sweep over the executable, which reduces the cold-start time on network file
+                systems and rotational disks.
+            prewarm
+                POSIX only. While the python interpreter is being loaded and initialized, read the python shared
+                library, base_library.zip, and the extension modules that are listed in the startup profile (see
+                `pkg_startup_order` and `startup_profile`) into the page cache in a background thread. This reduces the
+                cost of the page faults that are taken when the files are loaded, which dominates the start-up time if
+                the application directory is on a network-backed file system. The default is False.
         """
         from PyInstaller.config import CONF
 
@@ -441,7 +645,18 @@ def __init__(self, *args, **kwargs):
         self.strip = kwargs.get('strip', False)
         self.upx_exclude = kwargs.get("upx_exclude", [])
         self.runtime_tmpdir = kwargs.get('runtime_tmpdir', None)
+        self.runtime_tmpdir_policy = kwargs.get('runtime_tmpdir_policy', None)
         self.contents_directory = kwargs.get("contents_directory", "_internal")
+        self.pkg_data_alignment = kwargs.get('pkg_data_alignment', 0) if is_linux else 0
+        self.pkg_uncompressed_binaries = kwargs.get('pkg_uncompressed_binaries', False)
+        self.pkg_checksums = kwargs.get('pkg_checksums', False)
+        self.extraction_cache = kwargs.get('extraction_cache', None)
+        self.diskless = kwargs.get('diskless', False)
+        self.deferred_extraction = kwargs.get('deferred_extraction', False)
+        self.cold_entries = kwargs.get('cold_entries', None)
+        self.startup_profile = kwargs.get('startup_profile', None)
+        self.pkg_startup_order = kwargs.get('pkg_startup_order', None)
+        self.prewarm = kwargs.get('prewarm', False) and not is_win
         # If ``append_pkg`` is false, the archive will not be appended to the exe, but copied beside it.
         self.append_pkg = kwargs.get('append_pkg', True)
 
@@ -531,6 +746,15 @@ def __init__(self, *args, **kwargs):
         # Create the CArchive PKG in WORKPATH. When instancing PKG(), set name so that guts check can test whether the
         # file already exists.
         self.pkgname = os.path.join(CONF['workpath'], base_name + '.pkg')
+        self.cold_pkgname = os.path.join(CONF['workpath'], base_name + '.cold.pkg')
+
+        # Load the startup profiles.
+        startup_names = None
+        if self.startup_profile:
+            startup_names = self._load_startup_profile(self.startup_profile)
+        startup_order = None
+        if self.pkg_startup_order:
+            startup_order = self._load_startup_profile(self.pkg_startup_order)
 
         self.toc = []
 
@@ -557,6 +781,37 @@ def __init__(self, *args, **kwargs):
         if self.runtime_tmpdir is not None:
             self.toc.append(("pyi-runtime-tmpdir " + self.runtime_tmpdir, "", "OPTION"))
 
+        if self.runtime_tmpdir_policy is not None:
+            if self.runtime_tmpdir_policy not in {'default', 'prefer-memory'}:
+                raise ValueError(f"Invalid runtime_tmpdir_policy value: {self.runtime_tmpdir_policy!r}")
+            self.toc.append(("pyi-tmpdir-policy " + self.runtime_tmpdir_policy, "", "OPTION"))
+
+        if self.extraction_cache:
+            # Optional value: path to the cache directory.
+            if self.extraction_cache is True:
+                self.toc.append(("pyi-extraction-cache", "", "OPTION"))
+            else:
+                self.toc.append(("pyi-extraction-cache " + str(self.extraction_cache), "", "OPTION"))
+
+        if self.diskless:
+            # no value; presence means "true"
+            self.toc.append(("pyi-diskless", "", "OPTION"))
+
+        if self.deferred_extraction:
+            # no value; presence means "true"
+            self.toc.append(("pyi-deferred-extraction", "", "OPTION"))
+
+        if self.prewarm:
+            # The python shared library is always prewarmed; the listed files are prewarmed in the listed order,
+            # after the python shared library.
+            self.toc.append(("pyi-prewarm", "", "OPTION"))
+            prewarm_names = ['base_library.zip']
+            for name in (startup_order or startup_names or []):
+                if name.endswith(tuple(EXTENSION_SUFFIXES)) and name not in prewarm_names:
+                    prewarm_names.append(name)
+            for name in prewarm_names:
+                self.toc.append(("pyi-prewarm " + name, "", "OPTION"))
+
         if self.bootloader_ignore_signals:
             # no value; presence means "true"
             self.toc.append(("pyi-bootloader-ignore-signals", "", "OPTION"))
@@ -647,7 +902,14 @@ def __init__(self, *args, **kwargs):
             upx_exclude=self.upx_exclude,
             target_arch=self.target_arch,
             codesign_identity=self.codesign_identity,
-            entitlements_file=self.entitlements_file
+            entitlements_file=self.entitlements_file,
+            data_alignment=self.pkg_data_alignment,
+            uncompressed_binaries=self.pkg_uncompressed_binaries,
+            checksums=self.pkg_checksums,
+            cold_name=self.cold_pkgname,
+            cold_entries=self.cold_entries,
+            startup_profile=startup_names,
+            entry_order=startup_order,
         )
         self.dependencies = self.pkg.dependencies
 
@@ -673,6 +935,9 @@ def __init__(self, *args, **kwargs):
         ('target_arch', _check_guts_eq),
         ('codesign_identity', _check_guts_eq),
         ('entitlements_file', _check_guts_eq),
+        ('pkg_data_alignment', _check_guts_eq),
+        ('pkg_uncompressed_binaries', _check_guts_eq),
+        ('pkg_checksums', _check_guts_eq),
         # for the case the directory is shared between platforms:
         ('pkgname', _check_guts_eq),
         ('toc', _check_guts_eq),
@@ -706,6 +971,14 @@ def _check_guts(self, data, last_build):
 
         return False
 
+    @classmethod
+    def _load_startup_profile(cls, filename):
+        """
+        Read the names listed in the startup profile, ignoring empty lines and comments.
+        """
+        with open(cls._makeabs(filename), encoding='utf-8') as fp:
+            return [line.strip() for line in fp if line.strip() and not line.startswith('#')]
+
     @staticmethod
     def _makeabs(path):
         """
@@ -785,6 +1058,16 @@ def assemble(self):
             logger.info("Converting EXE to target arch (%s)", self.target_arch)
             osxutils.binary_to_target_arch(build_name, self.target_arch, display_name='Bootloader EXE')
 
+        # Copy the cold PKG next to the executable, if the PKG has one. In onedir mode, this will be done by the
+        # COLLECT() target.
+        if not self.exclude_binaries:
+            cold_pkg_dst = os.path.join(os.path.dirname(build_name), os.path.basename(self.cold_pkgname))
+            if os.path.exists(self.cold_pkgname):
+                logger.info("Copying cold PKG archive from %s to %s", self.cold_pkgname, cold_pkg_dst)
+                shutil.copyfile(self.cold_pkgname, cold_pkg_dst)
+            elif os.path.exists(cold_pkg_dst):
+                os.remove(cold_pkg_dst)
+
         # Step 2: append the PKG, if necessary
         if self.append_pkg:
             append_file = self.pkg.name  # Append PKG
@@ -821,6 +1104,16 @@ def assemble(self):
             if p.returncode:
                 raise SystemError(f"objcopy Failure: {p.returncode} {p.stdout}")
 
+            # If data in PKG is aligned, the PKG itself needs to be placed at an aligned offset in the executable. The
+            # section alignment needs to be set in a separate objcopy pass, as it is not applied to a newly-added
+            # section.
+            if self.append_pkg and self.pkg_data_alignment:
+                logger.info("Aligning ELF section with PKG archive to %d bytes", self.pkg_data_alignment)
+                cmd = ['objcopy', '--set-section-alignment', f'pydata={self.pkg_data_alignment}', build_name]
+                p = subprocess.run(cmd, stderr=subprocess.STDOUT, stdout=subprocess.PIPE, encoding='utf-8')
+                if p.returncode:
+                    raise SystemError(f"objcopy Failure: {p.returncode} {p.stdout}")
+
         elif is_darwin:
             # macOS: remove signature, append data, and fix-up headers so that the appended data appears to be part of
             # the executable (which is required by strict validation during code-signing).
@@ -1110,6 +1403,9 @@ def __init__(self, *args, **kwargs):
                 # If PKG is not appended to the executable, we need to collect it.
                 if not arg.append_pkg:
                     self.toc.append((os.path.basename(arg.pkgname), arg.pkgname, 'PKG'))
+                # Collect the cold PKG, if the executable's PKG has one.
+                if os.path.exists(arg.cold_pkgname):
+                    self.toc.append((os.path.basename(arg.cold_pkgname), arg.cold_pkgname, 'PKG'))
             elif miscutils.is_iterable(arg):
                 # TOC-like iterable
                 self.toc.extend(arg)
@@ -1302,7 +1598,8 @@ def _process_toc(self, toc, path_to_exe):
 
 
 UNCOMPRESSED = False
-COMPRESSED = True
+COMPRESSED = True  # zlib
+COMPRESSED_LZ4 = PKG_COMPRESSION_LZ4
 
 _MISSING_BOOTLOADER_ERRORMSG = """Fatal error: PyInstaller does not include a pre-compiled bootloader for your
 platform. For more details and instructions how to build the bootloader see
@@ -1003,12 +1003,16 @@ def get_bootstrap_modules():
     # Loader/bootstrap modules.
     # NOTE: These modules should be kept simple without any complicated dependencies.
     loader_mods += [
+        ('pyimod00_memfd', os.path.join(loaderpath, 'pyimod00_memfd.py'), 'PYMODULE'),
         ('pyimod01_archive', os.path.join(loaderpath, 'pyimod01_archive.py'), 'PYMODULE'),
         ('pyimod02_importers', os.path.join(loaderpath, 'pyimod02_importers.py'), 'PYMODULE'),
         ('pyimod03_ctypes', os.path.join(loaderpath, 'pyimod03_ctypes.py'), 'PYMODULE'),
     ]
     if is_win:
         loader_mods.append(('pyimod04_pywin32', os.path.join(loaderpath, 'pyimod04_pywin32.py'), 'PYMODULE'))
+    else:
+        loader_mods.append(('pyimod05_deferred', os.path.join(loaderpath, 'pyimod05_deferred.py'), 'PYMODULE'))
+    loader_mods.append(('pyimod06_profile', os.path.join(loaderpath, 'pyimod06_profile.py'), 'PYMODULE'))
     # The bootstrap script
     loader_mods.append(('pyiboot01_bootstrap', os.path.join(loaderpath, 'pyiboot01_bootstrap.py'), 'PYSOURCE'))
     return loader_mods
@@ -82,6 +82,11 @@
     import pyimod04_pywin32
     pyimod04_pywin32.install()
 
+# Install the hooks for recording of the startup profile (if requested via PYINSTALLER_STARTUP_PROFILE)
+import pyimod06_profile  # noqa: E402
+
+pyimod06_profile.install()
+
 # Apply a hack for metadata that was collected from (unzipped) python eggs; the EGG-INFO directories are collected into
 # their parent directories (my_package-version.egg/EGG-INFO), and for metadata to be discoverable by
 # `importlib.metadata`, the .egg directory needs to be in `sys.path`. The deprecated `pkg_resources` does not have this
@@ -93,3 +98,10 @@
         continue
     if entry.endswith('.egg'):
         sys.path.append(entry)
+
+# Install the hooks for deferred extraction of data files (onefile builds on POSIX only). This is done after the above
+# scan of `sys._MEIPASS`, which looks only at the directories (these are created before the application is started), and
+# must therefore not wait for the extraction of data files to complete.
+if not sys.platform.startswith('win'):
+    import pyimod05_deferred
+    pyimod05_deferred.install()
@@ -0,0 +1,111 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# **NOTE** This module is used during bootstrap.
+# Import *ONLY* builtin modules or modules that are collected into the base_library.zip archive.
+# List of built-in modules: sys.builtin_module_names
+# List of modules collected into base_library.zip: PyInstaller.compat.PY3_BASE_MODULES
+
+# Support for diskless mode of onefile builds (Linux only). In this mode, the bootloader extracts the collected files
+# into anonymous memory-backed files (memfd), and passes the path to their manifest via _PYI_MEMFD_MANIFEST environment
+# variable. The collected files are therefore not available under their names in the top-level application directory
+# (`sys._MEIPASS`), and the extension modules cannot be found by python's own path-based finder.
+#
+# This module must be executed before other bootstrap modules, because those import extension modules (e.g., `_struct`
+# and `zlib`) that might have been collected as shared libraries from python's lib-dynload directory.
+
+import sys
+import os
+
+import _imp
+import _frozen_importlib_external
+
+
+def _read_manifest(manifest_path):
+    """
+    Read the manifest of memory-backed files, and return the mapping of collected files' names to the paths of
+    corresponding memory-backed files. The manifest consists of records, each of which contains the typecode and the
+    name of the collected file, and the path of the memory-backed file, both NULL-terminated.
+    """
+    with open(manifest_path, 'rb') as fp:
+        fields = fp.read().split(b'\0')
+
+    # Discard the empty field after the last terminator.
+    names = fields[0:-1:2]
+    paths = fields[1:-1:2]
+
+    return {os.fsdecode(name[1:]): os.fsdecode(path) for name, path in zip(names, paths)}
+
+
+class PyiMemfdFinder:
+    """
+    Meta path finder for extension modules and source-only modules that were extracted into memory-backed files.
+    Search path entries (`sys.path` or the parent package's `__path__`) are translated into names of collected files,
+    relative to the top-level application directory. The finder is placed at the end of `sys.meta_path`, so that
+    modules from the PYZ archive and from base_library.zip take precedence.
+    """
+    def __init__(self, memfd_files, top_level_directory):
+        self._memfd_files = memfd_files
+        self._top_level_directory = top_level_directory
+        self._candidates = [(suffix, _frozen_importlib_external.ExtensionFileLoader)
+                            for suffix in _imp.extension_suffixes()]
+        self._candidates += [(suffix, _frozen_importlib_external.SourceFileLoader)
+                             for suffix in _frozen_importlib_external.SOURCE_SUFFIXES]
+
+    def __repr__(self):
+        return f"{self.__class__.__name__}({self._top_level_directory})"
+
+    def _compute_entry_prefix(self, path):
+        if not isinstance(path, str):
+            return None
+        relative_path = os.path.relpath(path, self._top_level_directory)
+        if relative_path.startswith('..'):
+            return None
+        if relative_path == '.':
+            return ''
+        return '/'.join(relative_path.split(os.path.sep)) + '/'
+
+    def find_spec(self, fullname, path=None, target=None):
+        tail_module = fullname.rpartition('.')[2]
+
+        for search_path in (sys.path if path is None else path):
+            entry_prefix = self._compute_entry_prefix(search_path)
+            if entry_prefix is None:
+                continue
+
+            for suffix, loader_class in self._candidates:
+                memfd_path = self._memfd_files.get(entry_prefix + tail_module + suffix)
+                if memfd_path is not None:
+                    loader = loader_class(fullname, memfd_path)
+                    return _frozen_importlib_external.spec_from_file_location(fullname, memfd_path, loader=loader)
+
+        return None
+
+    def invalidate_caches(self):
+        pass
+
+
+def install():
+    """
+    If running in diskless mode, expose the mapping of collected files' names to the paths of memory-backed files as
+    `sys._pyi_memfd_files`, and install the finder for modules that were extracted into memory-backed files.
+    """
+    manifest_path = os.environ.get('_PYI_MEMFD_MANIFEST')
+    if not manifest_path:
+        return
+
+    sys._pyi_memfd_files = _read_manifest(manifest_path)
+    sys.meta_path.append(PyiMemfdFinder(sys._pyi_memfd_files, sys._MEIPASS))
+
+
+# Unlike other bootstrap modules, which are installed by the bootstrap script, this one is installed immediately, in
+# order to make the extension modules available to subsequent bootstrap modules.
+install()
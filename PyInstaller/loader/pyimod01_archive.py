@@ -31,6 +31,11 @@
 PYZ_ITEM_DATA = 2  # deprecated; PYZ does not contain any data entries anymore
 PYZ_ITEM_NSPKG = 3  # PEP-420 namespace package
 
+# Flag that is combined with the type code of entries whose data is stored in the companion cold PYZ archive. The TOC of
+# the main archive lists such entries, so that the modules can be found without opening the cold archive; the flag is
+# removed from the type code when the TOC is loaded.
+PYZ_ITEM_COLD = 0x80
+
 
 class ArchiveReadError(RuntimeError):
     pass
@@ -43,9 +48,16 @@ class ZlibArchiveReader:
     """
     _PYZ_MAGIC_PATTERN = b'PYZ\0'
 
-    def __init__(self, filename, start_offset=None, check_pymagic=False):
+    def __init__(self, filename, start_offset=None, check_pymagic=False, cold_filename=None):
         self._filename = filename
         self._start_offset = start_offset
+        self._check_pymagic = check_pymagic
+
+        # Path to the cold PYZ archive (path to the file and optional offset within it), and its reader, which is
+        # created on first access to a cold entry.
+        self._cold_filename = cold_filename
+        self._cold_reader = None
+        self._cold_names = set()
 
         self.toc = {}
 
@@ -76,6 +88,12 @@ def __init__(self, filename, start_offset=None, check_pymagic=False):
             fp.seek(self._start_offset + toc_offset, os.SEEK_SET)
             self.toc = dict(marshal.load(fp))
 
+        # Strip the cold-entry flag from type codes, and keep track of the cold entries.
+        for name, (typecode, entry_offset, entry_length) in self.toc.items():
+            if typecode & PYZ_ITEM_COLD:
+                self.toc[name] = (typecode & ~PYZ_ITEM_COLD, entry_offset, entry_length)
+                self._cold_names.add(name)
+
     @staticmethod
     def _parse_offset_from_filename(filename):
         """
@@ -107,6 +125,11 @@ def extract(self, name, raw=False):
         entry = self.toc.get(name)
         if entry is None:
             return None
+
+        # Entry is stored in the cold archive; open it, if necessary, and extract the entry from it.
+        if name in self._cold_names:
+            return self._get_cold_reader().extract(name, raw=raw)
+
         typecode, entry_offset, entry_length = entry
 
         # Read data blob
@@ -133,3 +156,13 @@ def extract(self, name, raw=False):
             raise ImportError(f"Failed to unmarshal PYZ entry {name!r}!") from e
 
         return obj
+
+    def _get_cold_reader(self):
+        """
+        Return the reader for the cold PYZ archive, opening the archive on the first call.
+        """
+        if self._cold_reader is None:
+            if self._cold_filename is None:
+                raise ArchiveReadError("PYZ archive contains cold entries, but the cold archive is not available!")
+            self._cold_reader = ZlibArchiveReader(self._cold_filename, check_pymagic=self._check_pymagic)
+        return self._cold_reader
@@ -607,18 +607,26 @@ def install():
     #
     # The bootloader should store the path to PYZ archive (the path to the PKG archive and the offset within it; for
     # executable-embedded archive, this is for example /path/executable_name?117568) into _pyinstaller_pyz
-    # attribute of the sys module.
+    # attribute of the sys module. If some modules were moved into the companion cold archive, the path to the cold
+    # archive is stored into _pyinstaller_cold_pyz attribute; the cold archive is opened only when one of its modules
+    # is imported.
     global pyz_archive
 
     if not hasattr(sys, '_pyinstaller_pyz'):
         raise RuntimeError("Bootloader did not set sys._pyinstaller_pyz!")
 
     try:
-        pyz_archive = pyimod01_archive.ZlibArchiveReader(sys._pyinstaller_pyz, check_pymagic=True)
+        pyz_archive = pyimod01_archive.ZlibArchiveReader(
+            sys._pyinstaller_pyz,
+            check_pymagic=True,
+            cold_filename=getattr(sys, '_pyinstaller_cold_pyz', None),
+        )
     except Exception as e:
         raise RuntimeError("Failed to setup PYZ archive reader!") from e
 
     delattr(sys, '_pyinstaller_pyz')
+    if hasattr(sys, '_pyinstaller_cold_pyz'):
+        delattr(sys, '_pyinstaller_cold_pyz')
 
     # On Windows, there is finder called `_frozen_importlib.WindowsRegistryFinder`, which looks for Python module
     # locations in Windows registry. The frozen application should not look for those, so remove this finder
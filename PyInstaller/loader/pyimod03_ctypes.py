@@ -36,6 +36,9 @@ def _frozen_name(name):
             frozen_name = os.path.join(sys._MEIPASS, os.path.basename(name))
             if os.path.isfile(frozen_name):
                 name = frozen_name
+            elif os.path.basename(name) in getattr(sys, '_pyi_memfd_files', {}):
+                # Diskless mode; use the memory-backed file.
+                name = sys._pyi_memfd_files[os.path.basename(name)]
         return name
 
     class PyInstallerImportError(OSError):
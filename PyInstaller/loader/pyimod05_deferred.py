@@ -0,0 +1,264 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Support for deferred extraction of data files in onefile builds (POSIX only). In this mode, the bootloader starts the
+# application process as soon as the startup-critical files are extracted, and keeps extracting the data files in the
+# background. Each data file appears in `sys._MEIPASS` only once it is completely written. The names of the deferred
+# files are listed in a manifest in the staging directory; the bootloader writes a byte into the pipe (whose read end is
+# passed via _PYI_EXTRACTION_PIPE environment variable) whenever a file is moved into place, and closes the write end
+# of the pipe once the extraction is complete.
+#
+# Until the extraction is complete, an audit hook blocks the following accesses, but only if they concern deferred files
+# that have not been extracted yet:
+#  - opening a deferred file (`open` audit event, raised by `open()`, `io.open()` and `os.open()`, and therefore also
+#    by `pathlib` and `importlib.resources`) waits until the file is in place;
+#  - listing a directory under `sys._MEIPASS` (`os.listdir` and `os.scandir` audit events) waits until all deferred
+#    files below that directory are in place, so that the listing is never partial.
+# Accesses to other files, as well as failed lookups of files that are not part of the application, never block. Imports
+# from the file system are covered by a meta path finder, which waits only if a module file would be found in a deferred
+# file. The functions that only query files (`os.stat()`, `os.path.exists()`, `os.path.isfile()`, and similar) do not
+# raise audit events, and are not blocked. Neither are the accesses from native code (for example, C extensions or
+# libraries loaded via ctypes that open data files on their own), or via paths relative to `dir_fd`. Such code should
+# be called only after `sys._pyi_wait_for_extraction()`.
+
+import os
+import sys
+
+_pipe_fd = None
+_pending_files = set()  # Absolute paths of deferred files that are not known to be in place yet.
+_meipass_prefix = None
+
+# Name of the manifest of deferred files, relative to `sys._MEIPASS`. Must match the names used by the bootloader.
+_MANIFEST_NAME = os.path.join('.pyi-deferred', 'manifest')
+
+# If multiple threads are waiting at the same time, one of them may consume the notification about the file that the
+# other one is waiting for; the timeout bounds the resulting delay.
+_WAIT_TIMEOUT = 0.1
+
+
+def _finish():
+    """
+    Mark the deferred extraction as complete.
+    """
+    global _pipe_fd
+
+    pipe_fd, _pipe_fd = _pipe_fd, None
+    _pending_files.clear()
+    if pipe_fd is not None:
+        try:
+            os.close(pipe_fd)
+        except OSError:
+            pass
+
+
+def _drain_pipe():
+    """
+    Consume the pending notifications from the pipe, without blocking. Returns False once the extraction is complete.
+    """
+    while True:
+        pipe_fd = _pipe_fd
+        if pipe_fd is None:
+            return False
+        try:
+            data = os.read(pipe_fd, 4096)
+        except BlockingIOError:
+            return True
+        except OSError:
+            data = b''
+        if not data:
+            # End of file; the extraction is complete.
+            _finish()
+            return False
+
+
+def _exists(path):
+    try:
+        os.stat(path)
+    except (OSError, ValueError):
+        return False
+    return True
+
+
+def _wait(paths=(), directories=(), until_complete=False):
+    """
+    Wait until all given files and directories exist (or, if `until_complete` is set, until the extraction is
+    complete). Returns early if the extraction completes in the meantime.
+    """
+    import select
+
+    paths = set(paths)
+    directories = set(directories)
+    while _drain_pipe():
+        # The pipe was drained before the checks, so a file that is moved into place after them wakes up the `select()`.
+        for path in [path for path in paths if _exists(path)]:
+            paths.discard(path)
+            _pending_files.discard(path)
+        directories = {directory for directory in directories if not os.path.isdir(directory)}
+        if not until_complete and not paths and not directories:
+            return
+        pipe_fd = _pipe_fd
+        if pipe_fd is None:
+            return
+        try:
+            # The end of file is seen by all waiting threads, so the timeout is needed only when waiting for files.
+            select.select([pipe_fd], [], [], None if until_complete else _WAIT_TIMEOUT)
+        except (OSError, ValueError):
+            pass
+
+
+def wait_for_extraction(path=None):
+    """
+    Wait until the deferred extraction is complete. If `path` is given, return as soon as the file exists.
+    """
+    if path is None:
+        _wait(until_complete=True)
+    else:
+        _wait(paths=[os.path.normpath(os.path.abspath(os.fsdecode(path)))])
+
+
+def _get_meipass_path(path):
+    """
+    If the given path refers to `sys._MEIPASS` or a path under it, return the normalized absolute path. Otherwise,
+    return None.
+    """
+    if not isinstance(path, (str, bytes, os.PathLike)):
+        return None
+    try:
+        path = os.path.normpath(os.path.abspath(os.fsdecode(path)))
+    except (TypeError, ValueError):
+        return None
+    if path == sys._MEIPASS or path.startswith(_meipass_prefix):
+        return path
+    return None
+
+
+def _get_pending_files_below(directory):
+    prefix = os.path.join(directory, '')
+    return [path for path in list(_pending_files) if path.startswith(prefix)]
+
+
+def _is_called_from_importlib():
+    # The frame of the audit hook is followed by the frame of the function that raised the event.
+    try:
+        return sys._getframe(2).f_code.co_filename.startswith('<frozen importlib.')
+    except ValueError:
+        return False
+
+
+def _audit_hook(event, args):
+    if _pipe_fd is None or not _pending_files:
+        return
+    if event == 'open':
+        path = _get_meipass_path(args[0])
+        if path is not None and path in _pending_files:
+            _wait(paths=[path])
+    elif event in ('os.listdir', 'os.scandir'):
+        # The directory listings of the import system's path finders are not blocked; the deferred files are handled
+        # by `DeferredExtractionFinder`.
+        if _is_called_from_importlib():
+            return
+        path = _get_meipass_path('.' if args[0] is None else args[0])
+        if path is not None:
+            pending_files = _get_pending_files_below(path)
+            if pending_files:
+                _wait(paths=pending_files)
+
+
+class DeferredExtractionFinder:
+    """
+    Meta path finder that is placed in front of `importlib.machinery.PathFinder`. If a module would be found in a
+    deferred file that is not in place yet (or in a directory that does not exist yet, but will contain deferred files),
+    wait for it, and invalidate the cached directory listing of the search path, so that the `PathFinder` finds it.
+    """
+    @staticmethod
+    def find_spec(fullname, path=None, target=None):
+        import importlib.machinery
+
+        if _pipe_fd is None or not _pending_files:
+            return None
+
+        name = fullname.rpartition('.')[2]
+        suffixes = importlib.machinery.all_suffixes()
+        pending_files = []
+        pending_directories = []
+        search_paths = []
+        for entry in (sys.path if path is None else path):
+            search_path = _get_meipass_path(entry)
+            if search_path is None:
+                continue
+            base = os.path.join(search_path, name)
+            candidates = [base + suffix for suffix in suffixes]
+            candidates += [os.path.join(base, '__init__' + suffix) for suffix in suffixes]
+            candidates = [candidate for candidate in candidates if candidate in _pending_files]
+            if candidates:
+                pending_files += candidates
+            elif _get_pending_files_below(base) and not os.path.isdir(base):
+                pending_directories.append(base)
+            else:
+                continue
+            search_paths.append(entry)
+
+        if not search_paths:
+            return None
+
+        _wait(paths=pending_files, directories=pending_directories)
+        for entry in search_paths:
+            finder = sys.path_importer_cache.get(entry)
+            if finder is not None and hasattr(finder, 'invalidate_caches'):
+                finder.invalidate_caches()
+        return None
+
+    @staticmethod
+    def invalidate_caches():
+        pass
+
+
+def install():
+    global _pipe_fd, _meipass_prefix
+
+    # Always available, so that the application can call it regardless of whether the extraction is deferred or not.
+    sys._pyi_wait_for_extraction = wait_for_extraction
+
+    pipe_fd = os.environ.pop('_PYI_EXTRACTION_PIPE', None)
+    if not pipe_fd:
+        return
+
+    try:
+        _pipe_fd = int(pipe_fd)
+        os.set_blocking(_pipe_fd, False)
+        os.set_inheritable(_pipe_fd, False)
+    except (ValueError, OSError):
+        _pipe_fd = None
+        return
+
+    _meipass_prefix = os.path.join(sys._MEIPASS, '')
+    try:
+        with open(os.path.join(sys._MEIPASS, _MANIFEST_NAME), 'rb') as fp:
+            manifest = fp.read()
+    except OSError:
+        # The bootloader removes the manifest right before it signals the completion of the extraction.
+        wait_for_extraction()
+        return
+    _pending_files.update(
+        os.path.normpath(os.path.join(sys._MEIPASS, os.fsdecode(name))) for name in manifest.split(b'\0') if name
+    )
+
+    sys.addaudithook(_audit_hook)
+
+    # Place the finder in front of the `PathFinder`, which handles imports from the file system. The finder is kept in
+    # `sys.meta_path` after the extraction is complete; it then has no effect.
+    import importlib.machinery
+    for index, finder in enumerate(sys.meta_path):
+        if finder is importlib.machinery.PathFinder:
+            sys.meta_path.insert(index, DeferredExtractionFinder)
+            break
+    else:
+        sys.meta_path.append(DeferredExtractionFinder)
@@ -0,0 +1,94 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Recording of the startup profile. If PYINSTALLER_STARTUP_PROFILE environment variable is set, the names of imported
+# modules and of the collected files that are opened from `sys._MEIPASS` are recorded (in the order of first use), and
+# written to the file named by the environment variable when the application exits. The profile can be passed to EXE
+# via its `startup_profile` argument.
+
+import atexit
+import os
+import sys
+
+import _imp
+
+_profile_filename = None
+_recorded_names = []
+_seen_names = set()
+
+
+def _record(name):
+    if name not in _seen_names:
+        _seen_names.add(name)
+        _recorded_names.append(name)
+
+
+def _relative_name(path, prefix):
+    """
+    Convert the path of a collected file into its name, relative to the top-level application directory, with forward
+    slashes; return None if the file is not located in the top-level application directory.
+    """
+    if not isinstance(path, (str, bytes)):
+        return None
+    path = os.path.abspath(os.fsdecode(path))
+    if not path.startswith(prefix):
+        return None
+    return path[len(prefix):].replace(os.sep, '/')
+
+
+def _audit_hook(event, args):
+    if _profile_filename is None:
+        return
+    if event == 'import':
+        _record(args[0])
+    elif event == 'open':
+        name = _relative_name(args[0], os.path.join(sys._MEIPASS, ''))
+        if name:
+            _record(name)
+
+
+def _write_profile():
+    global _profile_filename
+
+    filename = _profile_filename
+    _profile_filename = None  # Stop recording.
+
+    # Extension modules are not opened via `open()`; record the names of their files right after the names of modules.
+    prefix = os.path.join(sys._MEIPASS, '')
+    extension_suffixes = tuple(_imp.extension_suffixes())
+    names = []
+    for name in _recorded_names:
+        names.append(name)
+        module = sys.modules.get(name)
+        module_file = _relative_name(getattr(module, '__file__', None), prefix)
+        if module_file and module_file.endswith(extension_suffixes) and module_file not in _seen_names:
+            _seen_names.add(module_file)
+            names.append(module_file)
+
+    try:
+        with open(filename, 'w', encoding='utf-8') as fp:
+            fp.write("# PyInstaller startup profile\n")
+            for name in names:
+                fp.write(name + "\n")
+    except OSError as e:
+        print(f"PyInstaller: failed to write startup profile to {filename!r}: {e}", file=sys.stderr)
+
+
+def install():
+    global _profile_filename
+
+    profile_filename = os.environ.get('PYINSTALLER_STARTUP_PROFILE')
+    if not profile_filename:
+        return
+
+    _profile_filename = os.path.abspath(profile_filename)
+    sys.addaudithook(_audit_hook)
+    atexit.register(_write_profile)
@@ -198,9 +198,9 @@ def _show_archive_contents(self, archive_name, archive):
                 for name in archive.toc.keys():
                     print(f" {name}")
             else:
-                print(" position, length, uncompressed_length, is_compressed, typecode, name")
-                for name, (position, length, uncompressed_length, is_compressed, typecode) in archive.toc.items():
-                    print(f" {position}, {length}, {uncompressed_length}, {is_compressed}, {typecode!r}, {name!r}")
+                print(" position, length, uncompressed_length, compression, typecode, name")
+                for name, (position, length, uncompressed_length, compression, typecode) in archive.toc.items():
+                    print(f" {position}, {length}, {uncompressed_length}, {compression}, {typecode!r}, {name!r}")
         elif isinstance(archive, ZlibArchiveReader):
             print(f"Contents of {archive_name!r} (PYZ):")
             if self.brief_mode:
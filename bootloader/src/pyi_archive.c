@@ -19,17 +19,40 @@
 #include <stddef.h>  /* ptrdiff_t */
 #include <stdlib.h>  /* malloc */
 #include <string.h>  /* strncmp, strcpy, strcat */
-#include <sys/stat.h>  /* fchmod */
+#include <sys/stat.h>  /* fchmod, fstat */
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>  /* _get_osfhandle */
+#else
+    #include <sys/mman.h>  /* mmap, munmap */
+#endif
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <fcntl.h>  /* fcntl, F_DUPFD_CLOEXEC */
+    #include <unistd.h>  /* close, ftruncate */
+    #include <sys/ioctl.h>  /* ioctl */
+    #include <sys/syscall.h>  /* syscall, __NR_copy_file_range */
+    #include <linux/fs.h>  /* FICLONERANGE */
+#endif
 
 /* PyInstaller headers. */
 #include "zlib.h"
 #include "pyi_global.h"
 #include "pyi_path.h"
 #include "pyi_archive.h"
+#include "pyi_lz4.h"
 #include "pyi_utils.h"
 #include "pyi_python.h"
 
 
+/* Compressed entries up to this size are extracted from the memory-mapped
+ * archive into the output file by decompressing the whole entry into a
+ * temporary buffer, instead of streaming it in small chunks. */
+#define PYI_ARCHIVE_MAX_INFLATE_BUFFER_SIZE (64 * 1024 * 1024)
+
+
 /*
  * Return pointer to the next TOC entry in the TOC buffer.
  */
@@ -40,22 +63,256 @@ pyi_archive_next_toc_entry(const struct ARCHIVE *archive, const struct TOC_ENTRY
 }
 
 
+/*
+ * Return pointer to the beginning of entry's data blob within the
+ * memory mapping of the archive file. If the archive file is not
+ * mapped, returns NULL.
+ *
+ * The TOC entries are validated when the archive is opened, so the
+ * entry's data blob is guaranteed to lie within the mapping.
+ */
+static const unsigned char *
+_pyi_archive_get_mapped_blob(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    if (archive->mapped_data == NULL) {
+        return NULL;
+    }
+    return archive->mapped_data + archive->pkg_offset + toc_entry->offset;
+}
+
+/*
+ * Open the archive file and seek to the beginning of entry's data blob.
+ * Used as a fall-back when the archive file is not memory-mapped.
+ */
+static FILE *
+_pyi_archive_open_entry_file(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    FILE *archive_fp;
+
+    /* Open archive (source) file... */
+    archive_fp = pyi_path_fopen(archive->filename, "rb");
+    if (archive_fp == NULL) {
+        PYI_ERROR("Failed to extract %s: failed to open archive file!\n", toc_entry->name);
+        return NULL;
+    }
+    /* ... and seek to the beginning of entry's data */
+    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_entry->offset, SEEK_SET) < 0) {
+        PYI_PERROR("fseek", "Failed to extract %s: failed to seek to the entry's data!\n", toc_entry->name);
+        fclose(archive_fp);
+        return NULL;
+    }
+
+    return archive_fp;
+}
+
+/*
+ * Compute CRC-32 of the data; the length is not limited by the range of
+ * zlib's (32-bit) uInt type.
+ */
+static uint32_t
+_pyi_archive_crc32(uint32_t checksum, const unsigned char *data, uint64_t length)
+{
+    const uint64_t MAX_CHUNK_SIZE = 1UL << 30;
+
+    while (length > 0) {
+        uInt chunk_size = (uInt)((MAX_CHUNK_SIZE < length) ? MAX_CHUNK_SIZE : length);
+        checksum = (uint32_t)crc32(checksum, data, chunk_size);
+        data += chunk_size;
+        length -= chunk_size;
+    }
+
+    return checksum;
+}
+
+/*
+ * Check whether the checksum of the entry needs to be verified, i.e.,
+ * the archive contains checksums, and the entry has not been verified
+ * yet.
+ */
+static bool
+_pyi_archive_needs_checksum(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    if (!archive->has_checksums) {
+        return false;
+    }
+    if (archive->verified_entries == NULL) {
+        return true;
+    }
+    return archive->verified_entries[((const char *)toc_entry - (const char *)archive->toc) / 16] == 0;
+}
+
+/*
+ * Verify the checksum of the entry's (extracted) data against the one
+ * stored in the TOC entry, if the archive contains checksums. Returns 0
+ * if checksum matches (or if the archive has no checksums), and -1 on
+ * mismatch; the error is reported only if report_error is set. A match
+ * is recorded, so that the entry is not verified again.
+ *
+ * The checksum covers the entry's data in the archive; it does not
+ * verify the data that was written into an extracted file.
+ */
+static int
+_pyi_archive_verify_checksum(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint32_t checksum, int report_error)
+{
+    if (!archive->has_checksums) {
+        return 0;
+    }
+    if (checksum == toc_entry->checksum) {
+        /* Each entry is extracted by a single thread at a time, so the
+         * flags of different entries are not written concurrently. */
+        if (archive->verified_entries) {
+            archive->verified_entries[((const char *)toc_entry - (const char *)archive->toc) / 16] = 1;
+        }
+        return 0;
+    }
+    if (report_error) {
+        PYI_ERROR("Failed to extract %s: checksum mismatch (expected 0x%08X, got 0x%08X); the archive is corrupted!\n", toc_entry->name, toc_entry->checksum, checksum);
+    }
+    return -1;
+}
+
+/*
+ * Write a chunk of extracted data into the output file. If checksum is
+ * not NULL, the CRC-32 of the chunk is accumulated into it, while the
+ * data is still in the CPU cache.
+ */
+static int
+_pyi_archive_write_chunk(FILE *out_fp, const unsigned char *data, size_t length, uint32_t *checksum)
+{
+    if (checksum) {
+        *checksum = _pyi_archive_crc32(*checksum, data, length);
+    }
+    if (length > 0 && fwrite(data, length, 1, out_fp) < 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Decompress the whole zlib stream from the input buffer (for example,
+ * the data blob of a compressed entry in the memory mapping) into the
+ * provided (pre-allocated) output buffer, which the stream must fill
+ * exactly.
+ *
+ * As both the compressed and the uncompressed size are known up front,
+ * the input and output are passed to zlib as whole buffers (limited only
+ * by the range of zlib's 32-bit uInt type), and the stream is finished
+ * with a single inflate() call whenever possible. This allows zlib to
+ * stay in its fast decoding loop for the whole stream, and to decode
+ * directly into the output buffer without maintaining a copy of its
+ * sliding window.
+ *
+ * Does not report errors; returns Z_OK on success, and zlib error code
+ * on failure.
+ */
+static int
+_pyi_archive_inflate_buffer(const unsigned char *src, uint64_t src_length, unsigned char *dst, uint64_t dst_length)
+{
+    const uint64_t MAX_CHUNK_SIZE = 1UL << 30;
+    uint64_t remaining_size = src_length;
+    uint64_t remaining_out_size = dst_length;
+    z_stream zstream;
+    int rc;
+
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.avail_in = 0;
+    zstream.next_in = (unsigned char *)src; /* zlib does not modify the input */
+    zstream.avail_out = 0;
+    zstream.next_out = dst;
+    rc = inflateInit(&zstream);
+    if (rc != Z_OK) {
+        return rc;
+    }
+
+    do {
+        int flush;
+
+        if (zstream.avail_in == 0 && remaining_size > 0) {
+            zstream.avail_in = (uInt)((MAX_CHUNK_SIZE < remaining_size) ? MAX_CHUNK_SIZE : remaining_size);
+            remaining_size -= zstream.avail_in;
+        }
+        if (zstream.avail_out == 0 && remaining_out_size > 0) {
+            zstream.avail_out = (uInt)((MAX_CHUNK_SIZE < remaining_out_size) ? MAX_CHUNK_SIZE : remaining_out_size);
+            remaining_out_size -= zstream.avail_out;
+        }
+
+        /* Finish the stream once all remaining input and output fit into
+         * the current chunks (i.e., in the first call, unless the entry
+         * is larger than the chunk size). */
+        flush = (remaining_size == 0 && remaining_out_size == 0) ? Z_FINISH : Z_NO_FLUSH;
+        rc = inflate(&zstream, flush);
+    } while (rc == Z_OK);
+
+    inflateEnd(&zstream);
+
+    if (rc == Z_NEED_DICT) {
+        return Z_DATA_ERROR;
+    }
+    if (rc != Z_STREAM_END) {
+        return rc;
+    }
+
+    /* The stream must fill the whole output buffer */
+    if (zstream.avail_out != 0 || remaining_out_size != 0) {
+        return Z_DATA_ERROR;
+    }
+
+    return Z_OK;
+}
+
 /*
  * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts a
  * compressed file from the archive, and writes it into the provided
  * file handle or data buffer. Exactly one of out_fp or out_ptr needs
- * to be valid.
+ * to be valid. If checksum is not NULL, the CRC-32 of the data written
+ * into out_fp is accumulated into it.
+ *
+ * The compressed data is read either directly from memory mapping
+ * (if blob is valid) or from the provided archive file handle.
  */
 static int
-_pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+_pyi_archive_extract_compressed(FILE *archive_fp, const unsigned char *blob, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr, uint32_t *checksum)
 {
     const size_t CHUNK_SIZE = 8192;
+    /* When reading from memory mapping or writing into the data buffer,
+     * the input/output is passed to zlib in large chunks, limited only
+     * by the range of zlib's (32-bit) uInt type. */
+    const size_t MAX_CHUNK_SIZE = 1UL << 30;
     unsigned char *buffer_in = NULL;
     unsigned char *buffer_out = NULL;
     uint64_t remaining_size;
+    uint64_t remaining_out_size;
     z_stream zstream;
     int rc = -1;
 
+    /* When reading from memory mapping, decompress the whole entry at
+     * once, either directly into the output data buffer, or into a
+     * temporary buffer that is written into the output file in a single
+     * call. Very large entries are streamed into the output file. */
+    if (blob && (out_ptr || toc_entry->uncompressed_length <= PYI_ARCHIVE_MAX_INFLATE_BUFFER_SIZE)) {
+        if (out_fp) {
+            buffer_out = (unsigned char *)malloc(toc_entry->uncompressed_length > 0 ? (size_t)toc_entry->uncompressed_length : 1);
+            if (buffer_out == NULL) {
+                PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
+                return -1;
+            }
+        }
+
+        rc = _pyi_archive_inflate_buffer(blob, toc_entry->length, out_ptr ? out_ptr : buffer_out, toc_entry->uncompressed_length);
+        if (rc != Z_OK) {
+            PYI_ERROR("Failed to extract %s: decompression resulted in return code %d!\n", toc_entry->name, rc);
+            rc = -1;
+        } else if (out_fp && _pyi_archive_write_chunk(out_fp, buffer_out, (size_t)toc_entry->uncompressed_length, checksum) < 0) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", toc_entry->name);
+            rc = -1;
+        }
+
+        free(buffer_out);
+        return rc;
+    }
+
     /* Allocate and initialize inflate state */
     zstream.zalloc = Z_NULL;
     zstream.zfree = Z_NULL;
@@ -68,36 +325,58 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
         return -1;
     }
 
-    /* Allocate I/O buffers */
-    buffer_in = (unsigned char *)malloc(CHUNK_SIZE);
-    if (buffer_in == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", toc_entry->name);
-        goto cleanup;
+    /* Allocate I/O buffers; input buffer is required only when reading
+     * from file, and output buffer only when writing to file. */
+    if (blob == NULL) {
+        buffer_in = (unsigned char *)malloc(CHUNK_SIZE);
+        if (buffer_in == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", toc_entry->name);
+            goto cleanup;
+        }
     }
-    buffer_out = (unsigned char *)malloc(CHUNK_SIZE);
-    if (buffer_out == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
-        goto cleanup;
+    if (out_fp) {
+        buffer_out = (unsigned char *)malloc(CHUNK_SIZE);
+        if (buffer_out == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
+            goto cleanup;
+        }
     }
 
     /* Decompress until deflate stream ends or end of file is reached */
     remaining_size = toc_entry->length;
+    remaining_out_size = toc_entry->uncompressed_length;
     do {
-        /* Read chunk to input buffer */
-        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer_in, 1, chunk_size, archive_fp) != chunk_size || ferror(archive_fp)) {
-            rc = -1;
-            goto cleanup;
+        size_t chunk_size;
+
+        if (blob) {
+            /* Pass the chunk directly from the memory mapping */
+            chunk_size = (MAX_CHUNK_SIZE < remaining_size) ? MAX_CHUNK_SIZE : (size_t)remaining_size;
+            zstream.next_in = (unsigned char *)blob; /* zlib does not modify the input */
+            blob += chunk_size;
+        } else {
+            /* Read chunk to input buffer */
+            chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
+            if (fread(buffer_in, 1, chunk_size, archive_fp) != chunk_size || ferror(archive_fp)) {
+                rc = -1;
+                goto cleanup;
+            }
+            zstream.next_in = buffer_in;
         }
+        zstream.avail_in = (uInt)chunk_size;
         remaining_size -= chunk_size;
 
         /* Run inflate() on input until output buffer is not full. */
-        zstream.avail_in = (uInt)chunk_size;
-        zstream.next_in = buffer_in;
         do {
             size_t out_len;
-            zstream.avail_out = (uInt)CHUNK_SIZE;
-            zstream.next_out = buffer_out;
+            if (out_fp) {
+                zstream.avail_out = (uInt)CHUNK_SIZE;
+                zstream.next_out = buffer_out;
+            } else {
+                /* Decompress directly into the output data buffer */
+                zstream.avail_out = (uInt)((MAX_CHUNK_SIZE < remaining_out_size) ? MAX_CHUNK_SIZE : remaining_out_size);
+                zstream.next_out = out_ptr;
+            }
+            out_len = zstream.avail_out;
             rc = inflate(&zstream, Z_NO_FLUSH);
             switch (rc) {
                 case Z_NEED_DICT:
@@ -107,20 +386,24 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
                 case Z_STREAM_ERROR:
                     goto decompress_end;
             }
-            /* Copy the extracted data */
-            out_len = CHUNK_SIZE - zstream.avail_out;
+            /* Process the extracted data */
+            out_len -= zstream.avail_out;
             if (out_fp) {
                 /* Write to output file */
-                if (fwrite(buffer_out, 1, out_len, out_fp) != out_len || ferror(out_fp)) {
+                if (_pyi_archive_write_chunk(out_fp, buffer_out, out_len, checksum) < 0 || ferror(out_fp)) {
                     rc = Z_ERRNO;
                     goto decompress_end;
                 }
-            } else if (out_ptr) {
-                /* Copy to output data buffer */
-                memcpy(out_ptr, buffer_out, out_len);
+            } else {
+                /* Data is already in the output buffer; advance the pointer */
                 out_ptr += out_len;
+                remaining_out_size -= out_len;
             }
-        } while (zstream.avail_out == 0);
+            /* Once the output buffer is filled up, inflate() is called
+             * with zero-sized output buffer to process the end of the
+             * stream; if it cannot make progress (Z_BUF_ERROR), the data
+             * would overflow the buffer. */
+        } while (zstream.avail_out == 0 && rc != Z_STREAM_END && rc != Z_BUF_ERROR);
         /* Done when inflate() says it's done */
     } while (rc != Z_STREAM_END && remaining_size > 0);
 
@@ -141,248 +424,1291 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
 }
 
 /*
- * Helper for pyi_archive_extract2fs that extracts an uncompressed file
- * from the archive into the provided file handle.
+ * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts
+ * an LZ4-compressed file from the archive, and writes it into the
+ * provided file handle or data buffer. Exactly one of out_fp or out_ptr
+ * needs to be valid.
+ *
+ * The LZ4 frame is decoded from the memory mapping (if blob is valid);
+ * otherwise, it is first read from the provided archive file handle
+ * into a temporary buffer. When writing to file, the frame is decoded
+ * block by block into a temporary buffer, which requires the frame to
+ * consist of independent blocks (as produced by CArchiveWriter). If
+ * checksum is not NULL, the CRC-32 of the data written into out_fp is
+ * accumulated into it.
  */
 static int
-_pyi_archive_extract2fs_uncompressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+_pyi_archive_extract_lz4(FILE *archive_fp, const unsigned char *blob, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr, uint32_t *checksum)
 {
-    const size_t CHUNK_SIZE = 8192;
-    unsigned char *buffer;
-    uint64_t remaining_size;
-    int rc = 0;
+    unsigned char *buffer_in = NULL;
+    unsigned char *buffer_out = NULL;
+    struct PYI_LZ4_FRAME_READER reader;
+    uint64_t remaining_out_size;
+    size_t block_length;
+    int rc = -1;
 
-    /* Allocate temporary buffer for a single chunk */
-    buffer = (unsigned char *)malloc(CHUNK_SIZE);
-    if (buffer == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary buffer!\n", toc_entry->name);
-        return -1;
+    /* Read the whole frame into memory, if necessary */
+    if (blob == NULL) {
+        if (toc_entry->length > SIZE_MAX) {
+            PYI_ERROR("Failed to extract %s: entry is too large to be read into memory (%" PRIu64 " bytes)!\n", toc_entry->name, toc_entry->length);
+            return -1;
+        }
+        buffer_in = (unsigned char *)malloc(toc_entry->length > 0 ? (size_t)toc_entry->length : 1);
+        if (buffer_in == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", toc_entry->name);
+            return -1;
+        }
+        if (fread(buffer_in, 1, (size_t)toc_entry->length, archive_fp) != (size_t)toc_entry->length) {
+            PYI_PERROR("fread", "Failed to extract %s: failed to read data!\n", toc_entry->name);
+            goto cleanup;
+        }
+        blob = buffer_in;
     }
 
-    /* ... and copy it, chunk by chunk */
-    remaining_size = toc_entry->uncompressed_length;
-    while (remaining_size > 0) {
-        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
-            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
+    /* Decode directly into the output data buffer */
+    if (out_ptr) {
+        if (pyi_lz4_decompress(blob, (size_t)toc_entry->length, out_ptr, (size_t)toc_entry->uncompressed_length) < 0) {
+            PYI_ERROR("Failed to extract %s: LZ4 decompression failed!\n", toc_entry->name);
+            goto cleanup;
+        }
+        rc = 0;
+        goto cleanup;
+    }
+
+    /* Decode block by block, and write each block into the output file */
+    if (pyi_lz4_frame_open(&reader, blob, (size_t)toc_entry->length) < 0 || !reader.independent_blocks) {
+        PYI_ERROR("Failed to extract %s: invalid or unsupported LZ4 frame!\n", toc_entry->name);
+        goto cleanup;
+    }
+    buffer_out = (unsigned char *)malloc(reader.block_max_size);
+    if (buffer_out == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
+        goto cleanup;
+    }
+
+    remaining_out_size = toc_entry->uncompressed_length;
+    while ((rc = pyi_lz4_frame_read_block(&reader, buffer_out, 0, reader.block_max_size, &block_length)) > 0) {
+        if (block_length > remaining_out_size) {
             rc = -1;
             break;
         }
-        if (fwrite(buffer, chunk_size, 1, out_fp) < 1) {
-            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data chunk!\n", toc_entry->name);
+        if (_pyi_archive_write_chunk(out_fp, buffer_out, block_length, checksum) < 0) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", toc_entry->name);
             rc = -1;
-            break;
+            goto cleanup;
         }
-        remaining_size -= chunk_size;
+        remaining_out_size -= block_length;
+    }
+    if (rc < 0 || remaining_out_size != 0) {
+        PYI_ERROR("Failed to extract %s: LZ4 decompression failed!\n", toc_entry->name);
+        rc = -1;
+    }
+
+cleanup:
+    free(buffer_in);
+    free(buffer_out);
+
+    return rc;
+}
+
+/*
+ * Parse the block index of an ARCHIVE_COMPRESSION_ZLIB_BLOCKS entry from
+ * the given buffer, which contains (at least) the header and the block
+ * lengths. Validates that the blocks cover the entry's data exactly.
+ * Does not report errors; returns 0 on success and -1 on failure.
+ */
+static int
+_pyi_archive_parse_block_index(const unsigned char *data, uint64_t data_length, const struct TOC_ENTRY *toc_entry, struct ARCHIVE_BLOCK_INDEX *index)
+{
+    uint32_t value;
+    uint64_t offset;
+    uint64_t expected_blocks;
+    uint32_t i;
+
+    index->offsets = NULL;
+
+    if (data_length < 8) {
+        return -1;
+    }
+    memcpy(&value, data, sizeof(value));
+    index->block_size = pyi_be32toh(value);
+    memcpy(&value, data + 4, sizeof(value));
+    index->num_blocks = pyi_be32toh(value);
+
+    /* Validate the block layout against the entry's lengths */
+    if (index->block_size == 0 || index->block_size > PYI_ARCHIVE_MAX_INFLATE_BUFFER_SIZE) {
+        return -1;
+    }
+    expected_blocks = (toc_entry->uncompressed_length + index->block_size - 1) / index->block_size;
+    if (index->num_blocks != expected_blocks) {
+        return -1;
+    }
+    offset = 8 + (uint64_t)index->num_blocks * 4;
+    if (offset > data_length || offset > toc_entry->length) {
+        return -1;
+    }
+
+    /* Convert block lengths into offsets */
+    index->offsets = (uint64_t *)malloc(((size_t)index->num_blocks + 1) * sizeof(uint64_t));
+    if (index->offsets == NULL) {
+        return -1;
+    }
+    for (i = 0; i < index->num_blocks; i++) {
+        index->offsets[i] = offset;
+        memcpy(&value, data + 8 + (size_t)i * 4, sizeof(value));
+        offset += pyi_be32toh(value);
+    }
+    index->offsets[index->num_blocks] = offset;
+
+    if (offset != toc_entry->length) {
+        pyi_archive_free_block_index(index);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Uncompressed length of the given block */
+static size_t
+_pyi_archive_get_block_length(const struct TOC_ENTRY *toc_entry, const struct ARCHIVE_BLOCK_INDEX *index, uint32_t block)
+{
+    uint64_t block_start = (uint64_t)block * index->block_size;
+    uint64_t remaining_size = toc_entry->uncompressed_length - block_start;
+    return (size_t)((remaining_size < index->block_size) ? remaining_size : index->block_size);
+}
+
+/*
+ * Read the block index of an ARCHIVE_COMPRESSION_ZLIB_BLOCKS entry from
+ * the memory-mapped archive. The index must be freed using
+ * pyi_archive_free_block_index(). Does not report errors; returns 0 on
+ * success, and -1 on failure (including when the archive file is not
+ * memory-mapped).
+ */
+int
+pyi_archive_read_block_index(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, struct ARCHIVE_BLOCK_INDEX *index)
+{
+    const unsigned char *blob;
+
+    index->offsets = NULL;
+
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob == NULL || toc_entry->compression_flag != ARCHIVE_COMPRESSION_ZLIB_BLOCKS) {
+        return -1;
+    }
+
+    return _pyi_archive_parse_block_index(blob, toc_entry->length, toc_entry, index);
+}
+
+/*
+ * Decompress a single block of an ARCHIVE_COMPRESSION_ZLIB_BLOCKS entry
+ * from the memory-mapped archive into the provided buffer, which must
+ * be able to hold index->block_size bytes. The uncompressed length of
+ * the block is stored into *out_length, and if checksum is not NULL,
+ * the CRC-32 of the block's data is stored into it. Does not report
+ * errors, so it can be used by worker threads; returns 0 on success and
+ * -1 on failure.
+ */
+int
+pyi_archive_decompress_mapped_block(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const struct ARCHIVE_BLOCK_INDEX *index, uint32_t block, unsigned char *out_buf, size_t *out_length, uint32_t *checksum)
+{
+    const unsigned char *blob;
+
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob == NULL || block >= index->num_blocks) {
+        return -1;
+    }
+
+    *out_length = _pyi_archive_get_block_length(toc_entry, index, block);
+    if (_pyi_archive_inflate_buffer(blob + index->offsets[block], index->offsets[block + 1] - index->offsets[block], out_buf, *out_length) != Z_OK) {
+        return -1;
+    }
+    if (checksum) {
+        *checksum = _pyi_archive_crc32(0, out_buf, *out_length);
+    }
+
+    return 0;
+}
+
+/*
+ * Combine the checksums of the individual blocks (as computed by
+ * pyi_archive_decompress_mapped_block()) into the checksum of the whole
+ * entry, and verify it. Does not report errors; returns 0 if checksum
+ * matches (or if the archive has no checksums) and -1 on mismatch.
+ */
+int
+pyi_archive_verify_block_checksums(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const struct ARCHIVE_BLOCK_INDEX *index, const uint32_t *block_checksums)
+{
+    uint32_t checksum = 0;
+    uint32_t block;
+
+    if (!_pyi_archive_needs_checksum(archive, toc_entry)) {
+        return 0;
+    }
+
+    for (block = 0; block < index->num_blocks; block++) {
+        checksum = (uint32_t)crc32_combine(checksum, block_checksums[block], (z_off_t)_pyi_archive_get_block_length(toc_entry, index, block));
+    }
+
+    return _pyi_archive_verify_checksum(archive, toc_entry, checksum, 0);
+}
+
+void
+pyi_archive_free_block_index(struct ARCHIVE_BLOCK_INDEX *index)
+{
+    free(index->offsets);
+    index->offsets = NULL;
+}
+
+/*
+ * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts
+ * an entry compressed as a sequence of independent zlib blocks, and
+ * writes it into the provided file handle or data buffer. Exactly one
+ * of out_fp or out_ptr needs to be valid.
+ *
+ * The blocks are decompressed one after another; when extracting into
+ * file, each block is decompressed into a temporary block-sized buffer.
+ * The compressed data is read either directly from memory mapping (if
+ * blob is valid) or from the provided archive file handle. If checksum
+ * is not NULL, the CRC-32 of the data written into out_fp is accumulated
+ * into it.
+ */
+static int
+_pyi_archive_extract_zlib_blocks(FILE *archive_fp, const unsigned char *blob, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr, uint32_t *checksum)
+{
+    struct ARCHIVE_BLOCK_INDEX index;
+    unsigned char *index_data = NULL;
+    unsigned char *buffer_in = NULL;
+    size_t buffer_in_size = 0;
+    unsigned char *buffer_out = NULL;
+    uint32_t block;
+    int rc = -1;
+
+    index.offsets = NULL;
+
+    /* Parse the block index; when reading from file, read the header
+     * first, to determine the size of the whole index. */
+    if (blob) {
+        if (_pyi_archive_parse_block_index(blob, toc_entry->length, toc_entry, &index) < 0) {
+            PYI_ERROR("Failed to extract %s: invalid block index!\n", toc_entry->name);
+            return -1;
+        }
+    } else {
+        unsigned char header[8];
+        uint32_t num_blocks;
+        size_t index_size;
+
+        if (fread(header, sizeof(header), 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Failed to extract %s: failed to read block index!\n", toc_entry->name);
+            return -1;
+        }
+        memcpy(&num_blocks, header + 4, sizeof(num_blocks));
+        if (sizeof(header) + (uint64_t)pyi_be32toh(num_blocks) * 4 > toc_entry->length) {
+            PYI_ERROR("Failed to extract %s: invalid block index!\n", toc_entry->name);
+            return -1;
+        }
+        index_size = sizeof(header) + (size_t)pyi_be32toh(num_blocks) * 4;
+
+        index_data = (unsigned char *)malloc(index_size);
+        if (index_data == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate block index buffer!\n", toc_entry->name);
+            return -1;
+        }
+        memcpy(index_data, header, sizeof(header));
+        if (index_size > sizeof(header) && fread(index_data + sizeof(header), index_size - sizeof(header), 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Failed to extract %s: failed to read block index!\n", toc_entry->name);
+            goto cleanup;
+        }
+        if (_pyi_archive_parse_block_index(index_data, index_size, toc_entry, &index) < 0) {
+            PYI_ERROR("Failed to extract %s: invalid block index!\n", toc_entry->name);
+            goto cleanup;
+        }
+    }
+
+    if (out_fp) {
+        buffer_out = (unsigned char *)malloc(index.block_size);
+        if (buffer_out == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
+            goto cleanup;
+        }
+    }
+
+    for (block = 0; block < index.num_blocks; block++) {
+        uint64_t compressed_length = index.offsets[block + 1] - index.offsets[block];
+        size_t block_length = _pyi_archive_get_block_length(toc_entry, &index, block);
+        const unsigned char *block_data;
+        unsigned char *block_out;
+        int zrc;
+
+        /* Obtain the compressed data of the block */
+        if (blob) {
+            block_data = blob + index.offsets[block];
+        } else {
+            if (compressed_length > buffer_in_size) {
+                free(buffer_in);
+                buffer_in_size = (size_t)compressed_length;
+                buffer_in = (unsigned char *)malloc(buffer_in_size);
+                if (buffer_in == NULL) {
+                    PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", toc_entry->name);
+                    goto cleanup;
+                }
+            }
+            if (compressed_length > 0 && fread(buffer_in, (size_t)compressed_length, 1, archive_fp) < 1) {
+                PYI_PERROR("fread", "Failed to extract %s: failed to read data!\n", toc_entry->name);
+                goto cleanup;
+            }
+            block_data = buffer_in;
+        }
+
+        /* Decompress directly into the output data buffer, or into the
+         * temporary buffer, which is then written into output file. */
+        block_out = out_ptr ? out_ptr + (size_t)block * index.block_size : buffer_out;
+        zrc = _pyi_archive_inflate_buffer(block_data, compressed_length, block_out, block_length);
+        if (zrc != Z_OK) {
+            PYI_ERROR("Failed to extract %s: decompression of block %u resulted in return code %d!\n", toc_entry->name, block, zrc);
+            goto cleanup;
+        }
+        if (out_fp && _pyi_archive_write_chunk(out_fp, buffer_out, block_length, checksum) < 0) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", toc_entry->name);
+            goto cleanup;
+        }
+    }
+
+    rc = 0;
+
+cleanup:
+    pyi_archive_free_block_index(&index);
+    free(index_data);
+    free(buffer_in);
+    free(buffer_out);
+
+    return rc;
+}
+
+/*
+ * Helper for pyi_archive_extract2fs that extracts an uncompressed file
+ * from the archive into the provided file handle. The data is read
+ * either directly from memory mapping (if blob is valid) or from the
+ * provided archive file handle. If checksum is not NULL, the CRC-32 of
+ * the data is accumulated into it.
+ */
+static int
+_pyi_archive_extract2fs_uncompressed(FILE *archive_fp, const unsigned char *blob, const struct TOC_ENTRY *toc_entry, FILE *out_fp, uint32_t *checksum)
+{
+    const size_t CHUNK_SIZE = 8192;
+    unsigned char *buffer;
+    uint64_t remaining_size;
+    int rc = 0;
+
+    /* Write directly from the memory mapping. When computing checksum,
+     * use smaller chunks, so that the data is still in the CPU cache
+     * when it is written. */
+    if (blob) {
+        const size_t MAX_CHUNK_SIZE = checksum ? (256 * 1024) : (1UL << 30);
+        remaining_size = toc_entry->uncompressed_length;
+        while (remaining_size > 0) {
+            size_t chunk_size = (MAX_CHUNK_SIZE < remaining_size) ? MAX_CHUNK_SIZE : (size_t)remaining_size;
+            if (_pyi_archive_write_chunk(out_fp, blob, chunk_size, checksum) < 0) {
+                PYI_PERROR("fwrite", "Failed to extract %s: failed to write data chunk!\n", toc_entry->name);
+                return -1;
+            }
+            remaining_size -= chunk_size;
+            blob += chunk_size;
+        }
+        return 0;
+    }
+
+    /* Allocate temporary buffer for a single chunk */
+    buffer = (unsigned char *)malloc(CHUNK_SIZE);
+    if (buffer == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary buffer!\n", toc_entry->name);
+        return -1;
+    }
+
+    /* ... and copy it, chunk by chunk */
+    remaining_size = toc_entry->uncompressed_length;
+    while (remaining_size > 0) {
+        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
+        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
+            rc = -1;
+            break;
+        }
+        if (_pyi_archive_write_chunk(out_fp, buffer, chunk_size, checksum) < 0) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data chunk!\n", toc_entry->name);
+            rc = -1;
+            break;
+        }
+        remaining_size -= chunk_size;
+    }
+    free(buffer);
+    return rc;
+}
+
+/*
+ * Helper for pyi_archive_extract that extracts an uncompressed file from
+ * the archive into the provided (pre-allocated) buffer. The data is read
+ * either directly from memory mapping (if blob is valid) or from the
+ * provided archive file handle.
+ */
+static int
+_pyi_archive_extract_uncompressed(FILE *archive_fp, const unsigned char *blob, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
+{
+    const size_t CHUNK_SIZE = 8192;
+    unsigned char *buffer;
+    uint64_t remaining_size;
+
+    /* Copy directly from the memory mapping */
+    if (blob) {
+        memcpy(out_buf, blob, (size_t)toc_entry->uncompressed_length);
+        return 0;
+    }
+
+    /* Read the file into buffer, chunk by chunk */
+    buffer = out_buf;
+    remaining_size = toc_entry->uncompressed_length;
+    while (remaining_size > 0) {
+        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
+        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
+            return -1;
+        }
+        remaining_size -= chunk_size;
+        buffer += chunk_size;
+    }
+    return 0;
+}
+
+#if defined(__linux__)
+
+/*
+ * Copy a range of data between file descriptors via copy_file_range()
+ * system call (invoked via syscall(), as the wrapper might be missing
+ * from older C libraries). Returns 0 on success, -1 on failure.
+ */
+static int
+_pyi_archive_copy_file_range(int src_fd, uint64_t src_offset, int dest_fd, uint64_t dest_offset, uint64_t length)
+{
+#if defined(__NR_copy_file_range)
+    loff_t off_in = (loff_t)src_offset;
+    loff_t off_out = (loff_t)dest_offset;
+
+    while (length > 0) {
+        const size_t MAX_CHUNK_SIZE = 1UL << 30;
+        size_t chunk_size = (MAX_CHUNK_SIZE < length) ? MAX_CHUNK_SIZE : (size_t)length;
+        long rc = syscall(__NR_copy_file_range, src_fd, &off_in, dest_fd, &off_out, chunk_size, 0);
+        if (rc <= 0) {
+            return -1;
+        }
+        length -= (uint64_t)rc;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Try extracting an uncompressed entry by having the kernel copy the
+ * data directly from the archive file into the output file, without
+ * passing it through user-space buffers.
+ *
+ * If the entry's data is aligned to the file system block size in
+ * the archive file (see data alignment option in CArchiveWriter), and
+ * both files are on the same reflink-capable file system (e.g., btrfs,
+ * xfs), the block-aligned part of the data is cloned via FICLONERANGE,
+ * which shares the data blocks instead of copying them. The remainder
+ * (or the whole entry, if cloning is not possible) is copied using
+ * copy_file_range().
+ *
+ * Returns 0 on success, and -1 if data could not be copied this way;
+ * in that case, the output file is left empty, and the caller should
+ * fall back to regular extraction.
+ */
+static int
+_pyi_archive_extract2fs_kernel_copy(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+{
+    int out_fd = fileno(out_fp);
+    uint64_t src_offset = archive->pkg_offset + toc_entry->offset;
+    uint64_t length = toc_entry->length;
+    uint64_t cloned_length = 0;
+
+    if (archive->fd < 0 || length == 0) {
+        return -1;
+    }
+
+    /* Ensure there is no pending buffered data in the output stream */
+    if (fflush(out_fp) != 0) {
+        return -1;
+    }
+
+#if defined(FICLONERANGE)
+    {
+        struct stat out_stat;
+        if (fstat(out_fd, &out_stat) == 0 && out_stat.st_blksize > 0 && src_offset % out_stat.st_blksize == 0) {
+            struct file_clone_range clone_range;
+            uint64_t block_size = (uint64_t)out_stat.st_blksize;
+
+            clone_range.src_fd = archive->fd;
+            clone_range.src_offset = src_offset;
+            clone_range.src_length = length - (length % block_size);
+            clone_range.dest_offset = 0;
+
+            if (clone_range.src_length > 0 && ioctl(out_fd, FICLONERANGE, &clone_range) == 0) {
+                cloned_length = clone_range.src_length;
+                PYI_DEBUG("LOADER: cloned %llu bytes of %s.\n", (unsigned long long)cloned_length, toc_entry->name);
+            }
+        }
+    }
+#endif
+
+    /* Copy the rest */
+    if (_pyi_archive_copy_file_range(archive->fd, src_offset + cloned_length, out_fd, cloned_length, length - cloned_length) < 0) {
+        PYI_DEBUG("LOADER: failed to copy data of %s via copy_file_range(): %s; falling back to buffered copy.\n", toc_entry->name, strerror(errno));
+        /* Discard partially-copied data */
+        if (ftruncate(out_fd, 0) < 0) {
+            PYI_PERROR("ftruncate", "Failed to extract %s: failed to truncate the output file!\n", toc_entry->name);
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif /* defined(__linux__) */
+
+/*
+ * Extract an archive entry into data buffer.
+ * Returns pointer to the data (must be freed).
+ */
+unsigned char *
+pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    FILE *archive_fp = NULL;
+    const unsigned char *blob;
+    unsigned char *data = NULL;
+    int rc = 0;
+
+    /* Access the entry's data via memory mapping, or open the archive
+     * file and seek to the entry's data. */
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob == NULL) {
+        archive_fp = _pyi_archive_open_entry_file(archive, toc_entry);
+        if (archive_fp == NULL) {
+            return NULL;
+        }
+    }
+
+    /* Allocate the data buffer */
+    if (toc_entry->uncompressed_length > SIZE_MAX) {
+        PYI_ERROR("Failed to extract %s: entry is too large to be extracted into memory (%" PRIu64 " bytes)!\n", toc_entry->name, toc_entry->uncompressed_length);
+        goto cleanup;
+    }
+    data = (unsigned char *)malloc(toc_entry->uncompressed_length > 0 ? (size_t)toc_entry->uncompressed_length : 1);
+    if (data == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate data buffer (%" PRIu64 " bytes)!\n", toc_entry->name, toc_entry->uncompressed_length);
+        goto cleanup;
+    }
+
+    /* Extract */
+    switch (toc_entry->compression_flag) {
+        case ARCHIVE_COMPRESSION_ZLIB: {
+            rc = _pyi_archive_extract_compressed(archive_fp, blob, toc_entry, NULL, data, NULL);
+            break;
+        }
+        case ARCHIVE_COMPRESSION_LZ4: {
+            rc = _pyi_archive_extract_lz4(archive_fp, blob, toc_entry, NULL, data, NULL);
+            break;
+        }
+        case ARCHIVE_COMPRESSION_ZLIB_BLOCKS: {
+            rc = _pyi_archive_extract_zlib_blocks(archive_fp, blob, toc_entry, NULL, data, NULL);
+            break;
+        }
+        default: {
+            rc = _pyi_archive_extract_uncompressed(archive_fp, blob, toc_entry, data);
+            break;
+        }
+    }
+    if (rc == 0 && _pyi_archive_needs_checksum(archive, toc_entry)) {
+        rc = _pyi_archive_verify_checksum(archive, toc_entry, _pyi_archive_crc32(0, data, toc_entry->uncompressed_length), 1);
+    }
+    if (rc != 0) {
+        free(data);
+        data = NULL;
+    }
+
+cleanup:
+    if (archive_fp) {
+        fclose(archive_fp);
+    }
+
+    return data;
+}
+
+/*
+ * Obtain the (uncompressed) data of an archive entry, avoiding the copy
+ * whenever possible.
+ *
+ * If the entry is stored without compression and the archive file is
+ * memory-mapped, the returned pointer is borrowed from the mapping (and
+ * remains valid until the archive is freed), and *data_buffer is set to
+ * NULL. Otherwise, the entry is extracted into newly-allocated buffer,
+ * which is returned and also stored in *data_buffer. In either case,
+ * the caller should call free(*data_buffer) once done with the data.
+ *
+ * Returns NULL on failure.
+ */
+const unsigned char *
+pyi_archive_get_entry_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char **data_buffer)
+{
+    const unsigned char *blob;
+
+    *data_buffer = NULL;
+
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob != NULL && toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE) {
+        if (_pyi_archive_needs_checksum(archive, toc_entry) && _pyi_archive_verify_checksum(archive, toc_entry, _pyi_archive_crc32(0, blob, toc_entry->length), 1) < 0) {
+            return NULL;
+        }
+        return blob;
+    }
+
+    *data_buffer = pyi_archive_extract(archive, toc_entry);
+    return *data_buffer;
+}
+
+/*
+ * Create/extract symbolic link from the archive.
+ */
+static int
+_pyi_archive_create_symlink(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    char *link_target = NULL;
+    int rc = -1;
+
+    /* Extract symlink target */
+    link_target = (char *)pyi_archive_extract(archive, toc_entry);
+    if (!link_target) {
+        goto cleanup;
+    }
+
+    /* Create the symbolic link */
+    rc = pyi_path_mksymlink(link_target, output_filename);
+
+cleanup:
+    free(link_target);
+
+    return rc;
+}
+
+/*
+ * Set permissions of the extracted file; binaries are made executable.
+ */
+void
+pyi_archive_set_output_file_permissions(const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+{
+#ifndef WIN32
+    if (toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
+        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR | S_IXUSR);
+    } else {
+        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR);
+    }
+#else
+    (void)toc_entry;
+    (void)out_fp;
+#endif
+}
+
+/*
+ * Extract an archive entry into specified output file.
+ */
+int
+pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    FILE *archive_fp = NULL;
+    const unsigned char *blob;
+    FILE *out_fp = NULL;
+    uint32_t checksum = 0;
+    uint32_t *checksum_ptr = _pyi_archive_needs_checksum(archive, toc_entry) ? &checksum : NULL;
+    int rc = 0;
+
+    /* Handle symbolic links */
+    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+        rc = _pyi_archive_create_symlink(archive, toc_entry, output_filename);
+        if (rc < 0) {
+            PYI_ERROR("Failed to create symbolic link %s!\n", toc_entry->name);
+        }
+        return rc;
+    }
+
+    /* Open target file */
+    out_fp = pyi_path_fopen(output_filename, "wb");
+    if (out_fp == NULL) {
+        PYI_PERROR("fopen", "Failed to extract %s: failed to open target file!\n", toc_entry->name);
+        return -1;
+    }
+
+    /* Access the entry's data via memory mapping, or open the archive
+     * file and seek to the entry's data. */
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob == NULL) {
+        archive_fp = _pyi_archive_open_entry_file(archive, toc_entry);
+        if (archive_fp == NULL) {
+            rc = -1;
+            goto cleanup;
+        }
+    }
+
+    /* Extract; if the archive contains checksums, the checksum of the
+     * data is computed as it is written. */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_ZLIB) {
+        rc = _pyi_archive_extract_compressed(archive_fp, blob, toc_entry, out_fp, NULL, checksum_ptr);
+    } else if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_LZ4) {
+        rc = _pyi_archive_extract_lz4(archive_fp, blob, toc_entry, out_fp, NULL, checksum_ptr);
+    } else if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_ZLIB_BLOCKS) {
+        rc = _pyi_archive_extract_zlib_blocks(archive_fp, blob, toc_entry, out_fp, NULL, checksum_ptr);
+    } else {
+#if defined(__linux__)
+        /* Try kernel-side copy first; fall back to regular copy. As the
+         * kernel-side copy does not pass the data through user space,
+         * the checksum is computed from the memory mapping (like in the
+         * other cases, this verifies the data in the archive, not the
+         * data written into the file). */
+        rc = -1;
+        if (checksum_ptr == NULL || blob != NULL) {
+            rc = _pyi_archive_extract2fs_kernel_copy(archive, toc_entry, out_fp);
+            if (rc == 0 && checksum_ptr) {
+                checksum = _pyi_archive_crc32(0, blob, toc_entry->length);
+            }
+        }
+        if (rc != 0) {
+            rc = _pyi_archive_extract2fs_uncompressed(archive_fp, blob, toc_entry, out_fp, checksum_ptr);
+        }
+#else
+        rc = _pyi_archive_extract2fs_uncompressed(archive_fp, blob, toc_entry, out_fp, checksum_ptr);
+#endif
+    }
+    if (rc == 0 && checksum_ptr) {
+        rc = _pyi_archive_verify_checksum(archive, toc_entry, checksum, 1);
+    }
+    pyi_archive_set_output_file_permissions(toc_entry, out_fp);
+
+cleanup:
+    /* Might be NULL if we jumped here due to fopen() failure */
+    if (archive_fp) {
+        fclose(archive_fp);
+    }
+    fclose(out_fp);
+
+    return rc;
+}
+
+
+/*
+ * Write the (already extracted) data of an archive entry into specified
+ * output file; the file permissions are set in the same way as by
+ * pyi_archive_extract2fs().
+ */
+int
+pyi_archive_write2fs(const struct TOC_ENTRY *toc_entry, const unsigned char *data, const char *output_filename)
+{
+    FILE *out_fp;
+    int rc = 0;
+
+    out_fp = pyi_path_fopen(output_filename, "wb");
+    if (out_fp == NULL) {
+        PYI_PERROR("fopen", "Failed to extract %s: failed to open target file!\n", toc_entry->name);
+        return -1;
+    }
+
+    if (toc_entry->uncompressed_length > 0 && fwrite(data, (size_t)toc_entry->uncompressed_length, 1, out_fp) < 1) {
+        PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", toc_entry->name);
+        rc = -1;
+    }
+
+    pyi_archive_set_output_file_permissions(toc_entry, out_fp);
+
+    fclose(out_fp);
+
+    return rc;
+}
+
+/* Helper for pyi_archive_decompress_mapped(); decompresses the data
+ * according to the entry's compression method. */
+static int
+_pyi_archive_decompress_mapped(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
+{
+    const unsigned char *blob;
+
+    blob = _pyi_archive_get_mapped_blob(archive, toc_entry);
+    if (blob == NULL) {
+        return -1;
+    }
+
+    switch (toc_entry->compression_flag) {
+        case ARCHIVE_COMPRESSION_ZLIB: {
+            return (_pyi_archive_inflate_buffer(blob, toc_entry->length, out_buf, toc_entry->uncompressed_length) == Z_OK) ? 0 : -1;
+        }
+        case ARCHIVE_COMPRESSION_LZ4: {
+            return pyi_lz4_decompress(blob, (size_t)toc_entry->length, out_buf, (size_t)toc_entry->uncompressed_length);
+        }
+        case ARCHIVE_COMPRESSION_ZLIB_BLOCKS: {
+            struct ARCHIVE_BLOCK_INDEX index;
+            size_t block_length;
+            uint32_t block;
+            int rc = 0;
+
+            if (_pyi_archive_parse_block_index(blob, toc_entry->length, toc_entry, &index) < 0) {
+                return -1;
+            }
+            for (block = 0; block < index.num_blocks && rc == 0; block++) {
+                rc = pyi_archive_decompress_mapped_block(archive, toc_entry, &index, block, out_buf + (size_t)block * index.block_size, &block_length, NULL);
+            }
+            pyi_archive_free_block_index(&index);
+            return rc;
+        }
+        default: {
+            return -1;
+        }
+    }
+}
+
+/*
+ * Decompress the data of a compressed entry from the memory-mapped
+ * archive into the provided buffer, which must be large enough to hold
+ * the entry's uncompressed data. If the archive contains checksums, the
+ * checksum of the decompressed data is verified.
+ *
+ * Unlike other extraction functions, this function does not report
+ * errors, so it can be used by worker threads; on failure, the caller
+ * should retry the extraction using one of the regular functions, which
+ * report the cause of the error.
+ *
+ * Returns 0 on success, and -1 on failure (including when the archive
+ * file is not memory-mapped).
+ */
+int
+pyi_archive_decompress_mapped(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
+{
+    if (_pyi_archive_decompress_mapped(archive, toc_entry, out_buf) < 0) {
+        return -1;
+    }
+    if (_pyi_archive_needs_checksum(archive, toc_entry)) {
+        return _pyi_archive_verify_checksum(archive, toc_entry, _pyi_archive_crc32(0, out_buf, toc_entry->uncompressed_length), 0);
+    }
+    return 0;
+}
+
+
+/*
+ * Locate the embedded archive's COOKIE header.
+ *
+ * First, try reading the fixed-size trailer at the position where the
+ * appended archive is expected to end, and use it to seek directly to
+ * the cookie. If that fails (for example, with archives that do not
+ * have the trailer), perform full back-to-front scan of the file to
+ * search for the MAGIC pattern of the cookie.
+ *
+ * Returns offset within the file if cookie is found, 0 otherwise.
+ */
+static uint64_t
+_pyi_archive_find_pkg_cookie_offset(FILE *fp)
+{
+    unsigned char magic[8];
+    unsigned char trailer_magic[8];
+    unsigned char cookie_magic[8];
+    struct ARCHIVE_TRAILER trailer;
+    uint64_t data_end;
+
+    /* Prepare MAGIC patterns; we need to do this programmatically to
+     * prevent the patterns themselves being stored in the code and
+     * matched when we scan the executable */
+    memcpy(magic, MAGIC_BASE, sizeof(magic));
+    magic[3] += 0x0C; /* 0x00 -> 0x0C */
+
+    memcpy(trailer_magic, MAGIC_BASE, sizeof(trailer_magic));
+    trailer_magic[3] += 0x0E; /* 0x00 -> 0x0E */
+
+    /* Fast path: use the trailer */
+    data_end = pyi_utils_find_appended_data_end(fp);
+    if (data_end >= sizeof(trailer)) {
+        if (pyi_fseek(fp, data_end - sizeof(trailer), SEEK_SET) == 0 &&
+            fread(&trailer, sizeof(trailer), 1, fp) == 1 &&
+            memcmp(trailer.magic, trailer_magic, sizeof(trailer_magic)) == 0) {
+            uint64_t cookie_distance = pyi_be64toh(trailer.cookie_distance);
+
+            /* Verify that the cookie is where trailer says it is */
+            if (cookie_distance <= data_end &&
+                pyi_fseek(fp, data_end - cookie_distance, SEEK_SET) == 0 &&
+                fread(cookie_magic, sizeof(cookie_magic), 1, fp) == 1 &&
+                memcmp(cookie_magic, magic, sizeof(magic)) == 0) {
+                return data_end - cookie_distance;
+            }
+        }
+    }
+
+    /* Slow path: search using the helper */
+    PYI_DEBUG("LOADER: archive trailer not found; scanning the file for the cookie...\n");
+    return pyi_utils_find_magic_pattern(fp, magic, sizeof(magic));
+}
+
+/* Check if the TOC entry's typecode corresponds to an extractable file */
+static bool
+_pyi_archive_is_extractable(char typecode)
+{
+    switch (typecode) {
+        /* onefile mode */
+        case ARCHIVE_ITEM_BINARY:
+        case ARCHIVE_ITEM_DATA:
+        case ARCHIVE_ITEM_ZIPFILE:
+        case ARCHIVE_ITEM_SYMLINK: {
+            return true;
+        }
+        /* MERGE mode */
+        case ARCHIVE_ITEM_DEPENDENCY: {
+            return true;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return false;
+}
+
+/* Map the TOC entry's typecode to the entry group; returns -1 if entry
+ * does not belong to any group. */
+static int
+_pyi_archive_get_entry_group(char typecode)
+{
+    switch (typecode) {
+        case ARCHIVE_ITEM_RUNTIME_OPTION: {
+            return ARCHIVE_GROUP_RUNTIME_OPTION;
+        }
+        case ARCHIVE_ITEM_PYMODULE:
+        case ARCHIVE_ITEM_PYPACKAGE: {
+            return ARCHIVE_GROUP_PYMODULE;
+        }
+        case ARCHIVE_ITEM_PYSOURCE: {
+            return ARCHIVE_GROUP_PYSOURCE;
+        }
+        case ARCHIVE_ITEM_PYZ: {
+            return ARCHIVE_GROUP_PYZ;
+        }
+        default: {
+            break;
+        }
+    }
+
+    if (_pyi_archive_is_extractable(typecode)) {
+        return ARCHIVE_GROUP_EXTRACTABLE;
+    }
+
+    return -1;
+}
+
+/*
+ * Compare TOC entry's name with the given name, using the same rules as
+ * pyi_archive_find_entry_by_name().
+ */
+static int
+_pyi_archive_entry_name_matches(const struct TOC_ENTRY *toc_entry, const char *name)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    /* On Windows and macOS, use case-insensitive comparison to
+     * simulate case-insensitive filesystem for extractable entries. */
+    if (_pyi_archive_is_extractable(toc_entry->typecode)) {
+        return strcasecmp(toc_entry->name, name) == 0;
     }
-    free(buffer);
-    return rc;
+#endif
+    return strcmp(toc_entry->name, name) == 0;
 }
 
 /*
- * Helper for pyi_archive_extract that extracts an uncompressed file from
- * the archive into the provided (pre-allocated) buffer.
+ * Compute hash of the entry name for the name index (32-bit FNV-1a).
+ * On Windows and macOS, the name is case-folded, so that the names
+ * of extractable entries that differ only in case end up in the same
+ * probe sequence. Non-extractable entries are still compared in
+ * case-sensitive manner; folding their hash only means that they
+ * might share the probe sequence with their case variants.
  */
-static int
-_pyi_archive_extract_uncompressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
+static uint32_t
+_pyi_archive_hash_name(const char *name)
 {
-    const size_t CHUNK_SIZE = 8192;
-    unsigned char *buffer;
-    uint64_t remaining_size;
+    uint32_t hash = 2166136261U;
+    const unsigned char *ptr;
 
-    /* Read the file into buffer, chunk by chunk */
-    buffer = out_buf;
-    remaining_size = toc_entry->uncompressed_length;
-    while (remaining_size > 0) {
-        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
-            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
-            return -1;
+    for (ptr = (const unsigned char *)name; *ptr; ptr++) {
+        unsigned char c = *ptr;
+#if defined(_WIN32) || defined(__APPLE__)
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
         }
-        remaining_size -= chunk_size;
-        buffer += chunk_size;
+#endif
+        hash ^= c;
+        hash *= 16777619U;
     }
-    return 0;
+
+    return hash;
 }
 
 /*
- * Extract an archive entry into data buffer.
- * Returns pointer to the data (must be freed).
+ * Build the per-group lists of TOC entries and the name index over TOC
+ * entries. The number of entries in each group is counted while
+ * validating the TOC entries in pyi_archive_open().
+ *
+ * For the name index, entries are inserted in TOC order and linear
+ * probing is used, so if multiple entries match the same name, the
+ * lookup returns the first one in TOC order, same as linear scan of
+ * the TOC would. Failure to allocate the name index is not fatal;
+ * lookups fall back to the linear scan of the TOC.
  */
-unsigned char *
-pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+static int
+_pyi_archive_build_indices(struct ARCHIVE *archive, size_t num_entries)
 {
-    FILE *archive_fp = NULL;
-    unsigned char *data = NULL;
-    int rc = 0;
+    const struct TOC_ENTRY *toc_entry;
+    size_t num_grouped_entries = 0;
+    size_t index_size = 16;
+    int group;
 
-    /* Open archive (source) file... */
-    archive_fp = pyi_path_fopen(archive->filename, "rb");
-    if (archive_fp == NULL) {
-        PYI_ERROR("Failed to extract %s: failed to open archive file!\n", toc_entry->name);
-        return NULL;
+    /* Partition the shared buffer between the groups */
+    for (group = 0; group < ARCHIVE_GROUP_COUNT; group++) {
+        num_grouped_entries += archive->entry_groups[group].count;
     }
-    /* ... and seek to the beginning of entry's data */
-    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_entry->offset, SEEK_SET) < 0) {
-        PYI_PERROR("fseek", "Failed to extract %s: failed to seek to the entry's data!\n", toc_entry->name);
-        goto cleanup;
+    archive->entry_groups_buffer = (const struct TOC_ENTRY **)calloc(num_grouped_entries > 0 ? num_grouped_entries : 1, sizeof(const struct TOC_ENTRY *));
+    if (archive->entry_groups_buffer == NULL) {
+        PYI_PERROR("calloc", "Could not allocate buffer for TOC entry groups!\n");
+        return -1;
     }
-
-    /* Allocate the data buffer */
-    data = (unsigned char *)malloc(toc_entry->uncompressed_length);
-    if (data == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate data buffer (%u bytes)!\n", toc_entry->name, toc_entry->uncompressed_length);
-        goto cleanup;
+    num_grouped_entries = 0;
+    for (group = 0; group < ARCHIVE_GROUP_COUNT; group++) {
+        archive->entry_groups[group].entries = archive->entry_groups_buffer + num_grouped_entries;
+        num_grouped_entries += archive->entry_groups[group].count;
+        archive->entry_groups[group].count = 0; /* Re-counted below */
     }
 
-    /* Extract */
-    if (toc_entry->compression_flag == 1) {
-        rc = _pyi_archive_extract_compressed(archive_fp, toc_entry, NULL, data);
-    } else {
-        rc = _pyi_archive_extract_uncompressed(archive_fp, toc_entry, data);
+    /* Allocate the name index; keep the load factor at or below 50% */
+    while (index_size < num_entries * 2) {
+        index_size *= 2;
     }
-    if (rc != 0) {
-        free(data);
-        data = NULL;
+    archive->name_index = (const struct TOC_ENTRY **)calloc(index_size, sizeof(const struct TOC_ENTRY *));
+    if (archive->name_index == NULL) {
+        PYI_DEBUG("LOADER: could not allocate TOC name index; falling back to linear search.\n");
+    } else {
+        archive->name_index_mask = index_size - 1;
     }
 
-cleanup:
-    fclose(archive_fp);
+    /* Populate */
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+        group = _pyi_archive_get_entry_group(toc_entry->typecode);
+        if (group >= 0) {
+            struct ARCHIVE_ENTRY_LIST *entry_list = &archive->entry_groups[group];
+            entry_list->entries[entry_list->count++] = toc_entry;
+        }
 
-    return data;
+        if (archive->name_index) {
+            size_t slot = _pyi_archive_hash_name(toc_entry->name) & archive->name_index_mask;
+            while (archive->name_index[slot] != NULL) {
+                slot = (slot + 1) & archive->name_index_mask;
+            }
+            archive->name_index[slot] = toc_entry;
+        }
+    }
+
+    return 0;
 }
 
 /*
- * Create/extract symbolic link from the archive.
+ * Memory-map the whole archive file (read-only). On success, the
+ * mapped_data and mapped_size fields of the archive structure are
+ * populated; on failure, they are left cleared, and the archive entries
+ * are accessed via regular file I/O.
  */
-static int
-_pyi_archive_create_symlink(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+static void
+_pyi_archive_map_file(struct ARCHIVE *archive, FILE *archive_fp)
 {
-    char *link_target = NULL;
-    int rc = -1;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+    struct _stat64 file_stat;
+    void *mapped_data;
 
-    /* Extract symlink target */
-    link_target = (char *)pyi_archive_extract(archive, toc_entry);
-    if (!link_target) {
-        goto cleanup;
+    if (_fstat64(_fileno(archive_fp), &file_stat) < 0) {
+        return;
+    }
+    if (file_stat.st_size <= 0 || (uint64_t)file_stat.st_size > SIZE_MAX) {
+        return;
     }
 
-    /* Create the symbolic link */
-    rc = pyi_path_mksymlink(link_target, output_filename);
+    file_handle = (HANDLE)_get_osfhandle(_fileno(archive_fp));
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_handle == NULL) {
+        PYI_DEBUG_W(L"LOADER: failed to create file mapping for archive; falling back to file I/O.\n");
+        return;
+    }
+    mapped_data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    /* The view keeps a reference to the mapping object */
+    CloseHandle(mapping_handle);
+    if (mapped_data == NULL) {
+        PYI_DEBUG_W(L"LOADER: failed to map view of archive file; falling back to file I/O.\n");
+        return;
+    }
+#else
+    struct stat file_stat;
+    void *mapped_data;
 
-cleanup:
-    free(link_target);
+    if (fstat(fileno(archive_fp), &file_stat) < 0) {
+        return;
+    }
+    if (file_stat.st_size <= 0 || (uint64_t)file_stat.st_size > SIZE_MAX) {
+        return;
+    }
 
-    return rc;
+    mapped_data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fileno(archive_fp), 0);
+    if (mapped_data == MAP_FAILED) {
+        PYI_DEBUG("LOADER: failed to mmap archive file; falling back to file I/O.\n");
+        return;
+    }
+#endif
+
+    archive->mapped_data = (const unsigned char *)mapped_data;
+    archive->mapped_size = (uint64_t)file_stat.st_size;
 }
 
 /*
- * Extract an archive entry into specified output file.
+ * Unmap the archive file, if it was mapped.
  */
-int
-pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+static void
+_pyi_archive_unmap_file(struct ARCHIVE *archive)
 {
-    FILE *archive_fp = NULL;
-    FILE *out_fp = NULL;
-    int rc = 0;
+    if (archive->mapped_data == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile((void *)archive->mapped_data);
+#else
+    munmap((void *)archive->mapped_data, (size_t)archive->mapped_size);
+#endif
+    archive->mapped_data = NULL;
+    archive->mapped_size = 0;
+}
 
-    /* Handle symbolic links */
-    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
-        rc = _pyi_archive_create_symlink(archive, toc_entry, output_filename);
-        if (rc < 0) {
-            PYI_ERROR("Failed to create symbolic link %s!\n", toc_entry->name);
+/*
+ * Fix the byte order of the fields in the version 2 TOC, in place.
+ * Validates the entries' lengths and the termination of their names,
+ * so that the TOC can be safely iterated over.
+ */
+static int
+_pyi_archive_fixup_toc_v2(struct TOC_ENTRY *toc, const struct TOC_ENTRY *toc_end)
+{
+    struct TOC_ENTRY *toc_entry = toc;
+
+    while (toc_entry < toc_end) {
+        uint64_t remaining_length = (uint64_t)((const char *)toc_end - (const char *)toc_entry);
+
+        /* The fixed-size part of the entry must be available before we
+         * can read (and validate) the entry length */
+        if (remaining_length < offsetof(struct TOC_ENTRY, name) + 1) {
+            return -1;
         }
-        return rc;
-    }
 
-    /* Open target file */
-    out_fp = pyi_path_fopen(output_filename, "wb");
-    if (out_fp == NULL) {
-        PYI_PERROR("fopen", "Failed to extract %s: failed to open target file!\n", toc_entry->name);
-        return -1;
-    }
+        toc_entry->entry_length = pyi_be32toh(toc_entry->entry_length);
+        toc_entry->checksum = pyi_be32toh(toc_entry->checksum);
+        toc_entry->offset = pyi_be64toh(toc_entry->offset);
+        toc_entry->length = pyi_be64toh(toc_entry->length);
+        toc_entry->uncompressed_length = pyi_be64toh(toc_entry->uncompressed_length);
 
-    /* Open archive (source) file... */
-    archive_fp = pyi_path_fopen(archive->filename, "rb");
-    if (archive_fp == NULL) {
-        PYI_ERROR("Failed to extract %s: failed to open archive file!\n", toc_entry->name);
-        rc = -1;
-        goto cleanup;
-    }
-    /* ... and seek to the beginning of entry's data */
-    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_entry->offset, SEEK_SET) < 0) {
-        PYI_PERROR("fseek", "Failed to extract %s: failed to seek to the entry's data!\n", toc_entry->name);
-        rc = -1;
-        goto cleanup;
-    }
+        if (toc_entry->entry_length < offsetof(struct TOC_ENTRY, name) + 1 || toc_entry->entry_length > remaining_length) {
+            return -1;
+        }
 
-    /* Extract */
-    if (toc_entry->compression_flag == 1) {
-        rc = _pyi_archive_extract_compressed(archive_fp, toc_entry, out_fp, NULL);
-    } else {
-        rc = _pyi_archive_extract2fs_uncompressed(archive_fp, toc_entry, out_fp);
-    }
-#ifndef WIN32
-    if (toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
-        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR | S_IXUSR);
-    } else {
-        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR);
-    }
-#endif
+        /* The name must be NUL-terminated within the entry; it is
+         * hashed and compared as a C string. */
+        if (memchr(toc_entry->name, 0, toc_entry->entry_length - offsetof(struct TOC_ENTRY, name)) == NULL) {
+            return -1;
+        }
 
-cleanup:
-    /* Might be NULL if we jumped here due to fopen() failure */
-    if (archive_fp) {
-        fclose(archive_fp);
+        /* Jump to next entry; with the current entry fixed up, we can
+         * use non-const equivalent of pyi_archive_next_toc_entry() */
+        toc_entry = (struct TOC_ENTRY *)((char *)toc_entry + toc_entry->entry_length);
     }
-    fclose(out_fp);
 
-    return rc;
+    return 0;
 }
 
-
 /*
- * Perform full back-to-front scan of the file to search for the
- * MAGIC pattern of the embedded archive's COOKIE header.
- *
- * Returns offset within the file if MAGIC pattern is found, 0 otherwise.
+ * Convert the version 1 TOC (as read from the archive) into newly
+ * allocated buffer with version 2 TOC entries, in host byte order.
+ * Returns NULL on failure.
  */
-static uint64_t
-_pyi_archive_find_pkg_cookie_offset(FILE *fp)
+static struct TOC_ENTRY *
+_pyi_archive_convert_toc_v1(const unsigned char *toc_data, uint64_t toc_length, uint64_t *converted_length)
 {
-    /* Prepare MAGIC pattern; we need to do this programmatically to
-     * prevent the pattern itself being stored in the code and matched
-     * when we scan the executable */
-    unsigned char magic[8];
-    memcpy(magic, MAGIC_BASE, sizeof(magic));
-    magic[3] += 0x0C; /* 0x00 -> 0x0C */
+    const size_t v1_header_length = offsetof(struct TOC_ENTRY_V1, name);
+    const size_t v2_header_length = offsetof(struct TOC_ENTRY, name);
+    const unsigned char *ptr;
+    const unsigned char *end = toc_data + toc_length;
+    struct TOC_ENTRY *toc;
+    struct TOC_ENTRY *toc_entry;
+    uint64_t total_length = 0;
 
-    /* Search using the helper */
-    return pyi_utils_find_magic_pattern(fp, magic, sizeof(magic));
-}
+    /* First pass: validate the entries and compute the length of the
+     * converted TOC */
+    for (ptr = toc_data; ptr < end;) {
+        uint32_t entry_length;
+        size_t name_length;
 
-/* Check if the TOC entry's typecode corresponds to an extractable file */
-static bool
-_pyi_archive_is_extractable(char typecode)
-{
-    switch (typecode) {
-        /* onefile mode */
-        case ARCHIVE_ITEM_BINARY:
-        case ARCHIVE_ITEM_DATA:
-        case ARCHIVE_ITEM_ZIPFILE:
-        case ARCHIVE_ITEM_SYMLINK: {
-            return true;
+        if ((uint64_t)(end - ptr) < v1_header_length + 1) {
+            return NULL;
         }
-        /* MERGE mode */
-        case ARCHIVE_ITEM_DEPENDENCY: {
-            return true;
+        entry_length = pyi_be32toh(((const struct TOC_ENTRY_V1 *)ptr)->entry_length);
+        if (entry_length < v1_header_length + 1 || entry_length > (uint64_t)(end - ptr)) {
+            return NULL;
         }
-        default: {
-            break;
+
+        /* The name must be NUL-terminated within the entry */
+        name_length = entry_length - v1_header_length;
+        if (memchr(((const struct TOC_ENTRY_V1 *)ptr)->name, 0, name_length) == NULL) {
+            return NULL;
         }
+
+        /* Converted entry is padded to multiple of 16 */
+        total_length += (v2_header_length + name_length + 15) & ~(uint64_t)15;
+
+        ptr += entry_length;
     }
 
-    return false;
+    if (total_length > SIZE_MAX) {
+        return NULL;
+    }
+    toc = (struct TOC_ENTRY *)calloc(1, (size_t)total_length > 0 ? (size_t)total_length : 1);
+    if (toc == NULL) {
+        return NULL;
+    }
+
+    /* Second pass: convert */
+    toc_entry = toc;
+    for (ptr = toc_data; ptr < end;) {
+        const struct TOC_ENTRY_V1 *v1_entry = (const struct TOC_ENTRY_V1 *)ptr;
+        uint32_t entry_length = pyi_be32toh(v1_entry->entry_length);
+        size_t name_length = entry_length - v1_header_length;
+
+        toc_entry->entry_length = (uint32_t)((v2_header_length + name_length + 15) & ~(size_t)15);
+        toc_entry->offset = pyi_be32toh(v1_entry->offset);
+        toc_entry->length = pyi_be32toh(v1_entry->length);
+        toc_entry->uncompressed_length = pyi_be32toh(v1_entry->uncompressed_length);
+        toc_entry->compression_flag = v1_entry->compression_flag;
+        toc_entry->typecode = v1_entry->typecode;
+        memcpy(toc_entry->name, v1_entry->name, name_length);
+
+        ptr += entry_length;
+        toc_entry = (struct TOC_ENTRY *)((char *)toc_entry + toc_entry->entry_length);
+    }
+
+    *converted_length = total_length;
+    return toc;
 }
 
 /*
@@ -393,9 +1719,17 @@ pyi_archive_open(const char *filename)
 {
     FILE *archive_fp = NULL;
     uint64_t cookie_pos = 0;
+    struct ARCHIVE_COOKIE_V1 archive_cookie_v1;
     struct ARCHIVE_COOKIE archive_cookie;
+    uint64_t cookie_length;
+    uint64_t pkg_length;
+    uint64_t toc_offset;
+    uint64_t toc_length;
+    unsigned char *toc_data = NULL;
     struct ARCHIVE *archive = NULL;
     struct TOC_ENTRY *toc_entry;
+    size_t num_entries = 0;
+    int group;
 
     PYI_DEBUG("LOADER: attempting to open archive %s\n", filename);
 
@@ -414,16 +1748,45 @@ pyi_archive_open(const char *filename)
     }
     PYI_DEBUG("LOADER: cookie found at offset 0x%" PRIX64 "\n", cookie_pos);
 
-    /* Read the cookie */
+    /* Read the cookie. Version 1 cookie is shorter than version 2 one,
+     * so read that first, and check whether the cookie is actually a
+     * version 2 one. */
     if (pyi_fseek(archive_fp, cookie_pos, SEEK_SET) < 0) {
         PYI_PERROR("fseek", "Failed to seek to cookie position!\n");
         goto cleanup;
     }
-    if (fread(&archive_cookie, sizeof(struct ARCHIVE_COOKIE), 1, archive_fp) < 1) {
+    if (fread(&archive_cookie_v1, sizeof(struct ARCHIVE_COOKIE_V1), 1, archive_fp) < 1) {
         PYI_PERROR("fread", "Failed to read cookie!\n");
         goto cleanup;
     }
 
+    if (archive_cookie_v1.pkg_length == 0) {
+        if (pyi_fseek(archive_fp, cookie_pos, SEEK_SET) < 0) {
+            PYI_PERROR("fseek", "Failed to seek to cookie position!\n");
+            goto cleanup;
+        }
+        if (fread(&archive_cookie, sizeof(struct ARCHIVE_COOKIE), 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Failed to read cookie!\n");
+            goto cleanup;
+        }
+        archive_cookie.format_version = pyi_be32toh(archive_cookie.format_version);
+        if (archive_cookie.format_version != ARCHIVE_FORMAT_VERSION_2) {
+            PYI_ERROR("Unsupported archive format version: %u!\n", archive_cookie.format_version);
+            goto cleanup;
+        }
+    } else {
+        /* Convert version 1 cookie into version 2 one, keeping the fields
+         * in big-endian byte order for the common code below. */
+        memset(&archive_cookie, 0, sizeof(archive_cookie));
+        memcpy(archive_cookie.magic, archive_cookie_v1.magic, sizeof(archive_cookie.magic));
+        archive_cookie.format_version = ARCHIVE_FORMAT_VERSION_1;
+        archive_cookie.pkg_length = pyi_be32toh(archive_cookie_v1.pkg_length);
+        archive_cookie.toc_offset = pyi_be32toh(archive_cookie_v1.toc_offset);
+        archive_cookie.toc_length = pyi_be32toh(archive_cookie_v1.toc_length);
+        archive_cookie.python_version = archive_cookie_v1.python_version;
+        memcpy(archive_cookie.python_libname, archive_cookie_v1.python_libname, sizeof(archive_cookie.python_libname));
+    }
+
     /* Allocate the structure */
     archive = (struct ARCHIVE *)calloc(1, sizeof(struct ARCHIVE));
     if (archive == NULL) {
@@ -435,11 +1798,27 @@ pyi_archive_open(const char *filename)
      * bootloader, the string is guaranteed to be within PYI_PATH_MAX limit */
     snprintf(archive->filename, PYI_PATH_MAX, "%s", filename);
 
+#if defined(__linux__)
+    /* Keep a (close-on-exec) duplicate of archive file descriptor */
+    archive->fd = fcntl(fileno(archive_fp), F_DUPFD_CLOEXEC, 0);
+#endif
+
     /* Fix endianness of cookie fields */
-    archive_cookie.pkg_length = pyi_be32toh(archive_cookie.pkg_length);
-    archive_cookie.toc_offset = pyi_be32toh(archive_cookie.toc_offset);
-    archive_cookie.toc_length = pyi_be32toh(archive_cookie.toc_length);
+    archive->format_version = archive_cookie.format_version;
+    if (archive->format_version == ARCHIVE_FORMAT_VERSION_2) {
+        cookie_length = sizeof(struct ARCHIVE_COOKIE);
+        pkg_length = pyi_be64toh(archive_cookie.pkg_length);
+        toc_offset = pyi_be64toh(archive_cookie.toc_offset);
+        toc_length = pyi_be64toh(archive_cookie.toc_length);
+        archive->has_checksums = (pyi_be32toh(archive_cookie.flags) & ARCHIVE_FLAG_CHECKSUMS) != 0;
+    } else {
+        cookie_length = sizeof(struct ARCHIVE_COOKIE_V1);
+        pkg_length = archive_cookie.pkg_length;
+        toc_offset = archive_cookie.toc_offset;
+        toc_length = archive_cookie.toc_length;
+    }
     archive_cookie.python_version = pyi_be32toh(archive_cookie.python_version);
+    PYI_DEBUG("LOADER: archive format version: %d\n", archive->format_version);
 
     /* Copy python version and python shared library name from cookie */
     archive->python_version = archive_cookie.python_version;
@@ -447,53 +1826,120 @@ pyi_archive_open(const char *filename)
 
     /* From the cookie position and declared archive size, calculate
      * the archive start position */
-    archive->pkg_offset = cookie_pos + sizeof(struct ARCHIVE_COOKIE) - archive_cookie.pkg_length;
+    if (pkg_length > cookie_pos + cookie_length) {
+        PYI_ERROR("Invalid archive: declared archive size exceeds the file size!\n");
+        goto error;
+    }
+    archive->pkg_offset = cookie_pos + cookie_length - pkg_length;
 
-    /* Read the table of contents (TOC) */
-    pyi_fseek(archive_fp, archive->pkg_offset + archive_cookie.toc_offset, SEEK_SET);
-    archive->toc = (struct TOC_ENTRY *)malloc(archive_cookie.toc_length);
+    /* Validate the TOC location */
+    if (toc_offset > pkg_length || toc_length > pkg_length - toc_offset || toc_length > SIZE_MAX) {
+        PYI_ERROR("Invalid archive: TOC extends beyond the archive!\n");
+        goto error;
+    }
+
+    /* Memory-map the archive file, so that the entries' data can be
+     * accessed without having to re-open the file and copy the data
+     * through intermediate buffers. */
+    _pyi_archive_map_file(archive, archive_fp);
 
-    if (archive->toc == NULL) {
+    /* Read the table of contents (TOC) */
+    toc_data = (unsigned char *)malloc(toc_length > 0 ? (size_t)toc_length : 1);
+    if (toc_data == NULL) {
         PYI_PERROR("malloc", "Could not allocate buffer for TOC!\n");
-        goto cleanup;
+        goto error;
     }
 
-    if (fread(archive->toc, archive_cookie.toc_length, 1, archive_fp) < 1) {
-        PYI_PERROR("fread", "Could not read full TOC!\n");
-        goto cleanup;
+    if (archive->mapped_data) {
+        memcpy(toc_data, archive->mapped_data + archive->pkg_offset + toc_offset, (size_t)toc_length);
+    } else {
+        if (pyi_fseek(archive_fp, archive->pkg_offset + toc_offset, SEEK_SET) < 0) {
+            PYI_PERROR("fseek", "Failed to seek to TOC position!\n");
+            goto error;
+        }
+        if (fread(toc_data, (size_t)toc_length, 1, archive_fp) < 1) {
+            PYI_PERROR("fread", "Could not read full TOC!\n");
+            goto error;
+        }
     }
-    archive->toc_end = (const struct TOC_ENTRY *)(((const char *)archive->toc) + archive_cookie.toc_length);
 
     /* Check input file is still ok (should be). */
     if (ferror(archive_fp)) {
         PYI_ERROR("Error on file.\n");
-        goto cleanup;
+        goto error;
     }
 
-    /* Fix the endianness of the fields in the TOC entries. At the same
-     * time, check for extractable entries that imply onefile semantics. */
-    toc_entry = archive->toc;
-    while (toc_entry < archive->toc_end) {
-        /* Fixup the current TOC entry */
-        toc_entry->entry_length = pyi_be32toh(toc_entry->entry_length);
-        toc_entry->offset = pyi_be32toh(toc_entry->offset);
-        toc_entry->length = pyi_be32toh(toc_entry->length);
-        toc_entry->uncompressed_length = pyi_be32toh(toc_entry->uncompressed_length);
+    /* Fix the endianness of the fields in the TOC entries; for version 1
+     * archives, convert the TOC into version 2 layout at the same time. */
+    if (archive->format_version == ARCHIVE_FORMAT_VERSION_2) {
+        archive->toc = (struct TOC_ENTRY *)toc_data;
+        toc_data = NULL;
+        archive->toc_end = (const struct TOC_ENTRY *)(((const char *)archive->toc) + toc_length);
+        if (_pyi_archive_fixup_toc_v2(archive->toc, archive->toc_end) < 0) {
+            PYI_ERROR("Invalid archive: malformed TOC entry!\n");
+            goto error;
+        }
+        if (archive->has_checksums) {
+            archive->verified_entries = (unsigned char *)calloc((size_t)(toc_length / 16) + 1, 1);
+        }
+    } else {
+        archive->toc = _pyi_archive_convert_toc_v1(toc_data, toc_length, &toc_length);
+        if (archive->toc == NULL) {
+            PYI_ERROR("Invalid archive: malformed TOC entry!\n");
+            goto error;
+        }
+        archive->toc_end = (const struct TOC_ENTRY *)(((const char *)archive->toc) + toc_length);
+    }
+
+    /* Validate that entries' data lies within the archive (which is
+     * required for safe access via the memory mapping), and count the
+     * entries in each entry group. */
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = (struct TOC_ENTRY *)((char *)toc_entry + toc_entry->entry_length)) {
+        /* Validate the entry */
+        if (toc_entry->offset > pkg_length || toc_entry->length > pkg_length - toc_entry->offset ||
+            (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE && toc_entry->length != toc_entry->uncompressed_length)) {
+            PYI_ERROR("Invalid archive: data of TOC entry %s lies outside of the archive!\n", toc_entry->name);
+            goto error;
+        }
+        if (toc_entry->compression_flag > ARCHIVE_COMPRESSION_ZLIB_BLOCKS) {
+            PYI_ERROR("Invalid archive: TOC entry %s uses unsupported compression method %d!\n", toc_entry->name, toc_entry->compression_flag);
+            goto error;
+        }
 
-        /* Check if entry is extractable */
-        archive->contains_extractable_entries |= _pyi_archive_is_extractable(toc_entry->typecode);
+        /* Count entries in each group */
+        group = _pyi_archive_get_entry_group(toc_entry->typecode);
+        if (group >= 0) {
+            archive->entry_groups[group].count++;
+        }
 
         /* Check if this is SPLASH entry */
         if (toc_entry->typecode == ARCHIVE_ITEM_SPLASH) {
             archive->toc_splash = toc_entry;
         }
 
-        /* Jump to next entry; with the current entry fixed up, we can
-         * use non-const equivalent of pyi_archive_next_toc_entry() */
-        toc_entry = (struct TOC_ENTRY *)((const char *)toc_entry + toc_entry->entry_length);
+        /* Check if this is directory table entry */
+        if (toc_entry->typecode == ARCHIVE_ITEM_DIRECTORY_TABLE) {
+            archive->toc_directory_table = toc_entry;
+        }
+
+        num_entries++;
+    }
+
+    /* Extractable entries imply onefile semantics */
+    archive->contains_extractable_entries = archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE].count > 0;
+
+    /* Build the per-group entry lists and the hash index over entry names */
+    if (_pyi_archive_build_indices(archive, num_entries) < 0) {
+        goto error;
     }
 
+    goto cleanup;
+
+error:
+    pyi_archive_free(&archive);
+
 cleanup:
+    free(toc_data);
     fclose(archive_fp);
 
     return archive;
@@ -516,7 +1962,20 @@ pyi_archive_free(struct ARCHIVE **archive_ref)
         return;
     }
 
-    /* Free the TOC buffer */
+    /* Unmap the archive file */
+    _pyi_archive_unmap_file(archive);
+
+#if defined(__linux__)
+    /* Close the archive file descriptor */
+    if (archive->fd >= 0) {
+        close(archive->fd);
+    }
+#endif
+
+    /* Free the TOC indices and the TOC buffer */
+    free(archive->verified_entries);
+    free(archive->entry_groups_buffer);
+    free(archive->name_index);
     free(archive->toc);
 
     /* Free the structure itself */
@@ -531,25 +1990,25 @@ const struct TOC_ENTRY *
 pyi_archive_find_entry_by_name(const struct ARCHIVE *archive, const char *name)
 {
     const struct TOC_ENTRY *toc_entry;
+    size_t slot;
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-#if defined(_WIN32) || defined(__APPLE__)
-        /* On Windows and macOS, use case-insensitive comparison to
-         * simulate case-insensitive filesystem for extractable entries. */
-        if (_pyi_archive_is_extractable(toc_entry->typecode)) {
-            if (strcasecmp(toc_entry->name, name) == 0) {
-                return toc_entry;
-            }
-        } else {
-            if (strcmp(toc_entry->name, name) == 0) {
+    /* Fall back to linear scan if name index is unavailable */
+    if (archive->name_index == NULL) {
+        for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+            if (_pyi_archive_entry_name_matches(toc_entry, name)) {
                 return toc_entry;
             }
         }
-#else
-        if (strcmp(toc_entry->name, name) == 0) {
+        return NULL;
+    }
+
+    /* Probe the name index until match or an empty slot is found */
+    slot = _pyi_archive_hash_name(name) & archive->name_index_mask;
+    while ((toc_entry = archive->name_index[slot]) != NULL) {
+        if (_pyi_archive_entry_name_matches(toc_entry, name)) {
             return toc_entry;
         }
-#endif
+        slot = (slot + 1) & archive->name_index_mask;
     }
 
     return NULL;
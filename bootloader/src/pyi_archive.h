@@ -34,21 +34,84 @@
 #define ARCHIVE_ITEM_RUNTIME_OPTION   'o'  /* runtime option */
 #define ARCHIVE_ITEM_SPLASH           'l'  /* splash resources */
 #define ARCHIVE_ITEM_SYMLINK          'n'  /* symbolic link */
+#define ARCHIVE_ITEM_DIRECTORY_TABLE  'D'  /* table of directories of extractable entries */
 
-/* Entry in PKG/CArchive TOC */
+/* Compression methods of CArchive items (value of the compression_flag
+ * field). For backwards compatibility, the value of zlib compression
+ * matches the original boolean compression flag. */
+#define ARCHIVE_COMPRESSION_NONE      0  /* stored without compression */
+#define ARCHIVE_COMPRESSION_ZLIB      1  /* zlib stream */
+#define ARCHIVE_COMPRESSION_LZ4       2  /* LZ4 frame */
+#define ARCHIVE_COMPRESSION_ZLIB_BLOCKS 3  /* independently-compressed zlib blocks; see ARCHIVE_BLOCK_INDEX */
+
+/* Version of the PKG/CArchive format.
+ *
+ * Version 1 archives use 32-bit offsets and lengths, which limits the
+ * size of the archive to 4 GiB. Version 2 archives use 64-bit offsets
+ * and lengths; their cookie is distinguished from the version 1 cookie
+ * by zero in place of the (32-bit) pkg_length field, which is never
+ * zero in version 1 archives, followed by the format version field.
+ *
+ * In memory, the TOC entries are always kept in the version 2 layout;
+ * the version 1 TOC is converted when the archive is opened. */
+#define ARCHIVE_FORMAT_VERSION_1 1
+#define ARCHIVE_FORMAT_VERSION_2 2
+
+/* Archive flags, stored in the cookie (version 2). */
+#define ARCHIVE_FLAG_CHECKSUMS 0x1  /* TOC entries contain checksums of the entries' data */
+
+/* Entry in PKG/CArchive TOC (version 2) */
 struct TOC_ENTRY
+{
+    uint32_t entry_length; /* length of this TOC entry, including full length of the name field */
+    uint32_t checksum; /* CRC-32 of entry's uncompressed data if archive has ARCHIVE_FLAG_CHECKSUMS; otherwise zero */
+    uint64_t offset; /* position of entry's data blob, relative to the start of PKG archive */
+    uint64_t length; /* length of compressed data blob */
+    uint64_t uncompressed_length; /* length of uncompressed data blob */
+    unsigned char compression_flag; /* compression method - see ARCHIVE_COMPRESSION_* definitions */
+    char typecode; /* type code - see ARCHIVE_ITEM_* definitions */
+    char name[1];  /* entry name; padded to multiple of 16 */
+};
+
+/* Entry in PKG/CArchive TOC (version 1) */
+struct TOC_ENTRY_V1
 {
     uint32_t entry_length; /* length of this TOC entry, including full length of the name field */
     uint32_t offset; /* position of entry's data blob, relative to the start of PKG archive */
     uint32_t length; /* length of compressed data blob */
     uint32_t uncompressed_length; /* length of uncompressed data blob */
-    unsigned char compression_flag; /* compression flag (1 = compressed, 0 = uncompressed) */
+    unsigned char compression_flag; /* compression method - see ARCHIVE_COMPRESSION_* definitions */
     char typecode; /* type code - see ARCHIVE_ITEM_* definitions */
     char name[1];  /* entry name; padded to multiple of 16 */
 };
 
-/* The PKG/CArchive cookie, from the end of the archive. */
+/* The PKG/CArchive cookie, from the end of the archive (version 2). */
 struct ARCHIVE_COOKIE
+{
+    char magic[8]; /* 'MEI\014\013\012\013\016' */
+    uint32_t v1_marker; /* always zero; pkg_length field in version 1 cookie */
+    uint32_t format_version; /* archive format version (2) */
+    uint64_t pkg_length; /* length of the entire PKG archive */
+    uint64_t toc_offset; /* position of TOC relative to start of PKG archive */
+    uint64_t toc_length; /* length of TOC data */
+    uint32_t python_version; /* integer representing python version */
+    uint32_t flags; /* archive flags; see ARCHIVE_FLAG_* definitions */
+    char python_libname[64]; /* Name of the of Python shared library (e.g., "python3.10.dll"). */
+};
+
+/* The fixed-size trailer that follows the cookie at the very end of
+ * the PKG/CArchive. It allows the cookie to be located without having
+ * to scan the file for the cookie's MAGIC pattern; archives without
+ * the trailer (i.e., created by older versions of PyInstaller) are
+ * still located by scanning the file. */
+struct ARCHIVE_TRAILER
+{
+    uint64_t cookie_distance; /* distance from the start of the cookie to the end of the trailer */
+    char magic[8]; /* 'MEI\016\013\012\013\016' */
+};
+
+/* The PKG/CArchive cookie, from the end of the archive (version 1). */
+struct ARCHIVE_COOKIE_V1
 {
     char magic[8]; /* 'MEI\014\013\012\013\016' */
     uint32_t pkg_length; /* length of the entire PKG archive */
@@ -58,6 +121,40 @@ struct ARCHIVE_COOKIE
     char python_libname[64]; /* Name of the of Python shared library (e.g., "python3.10.dll"). */
 };
 
+/* Index of an entry compressed as a sequence of independent zlib blocks
+ * (ARCHIVE_COMPRESSION_ZLIB_BLOCKS), which can be decompressed in
+ * parallel. In the archive, the entry's data starts with the block size
+ * and the number of blocks (both 32-bit), followed by the compressed
+ * length of each block (32-bit), and the blocks' compressed data. All
+ * blocks except the last one decompress to exactly block_size bytes.
+ * In memory, the lengths are converted into offsets of the blocks. */
+struct ARCHIVE_BLOCK_INDEX
+{
+    uint32_t block_size; /* uncompressed size of a block */
+    uint32_t num_blocks; /* number of blocks */
+    uint64_t *offsets; /* offsets of blocks' compressed data relative to the entry's data; num_blocks + 1 elements */
+};
+
+/* Groups of TOC entries, indexed when the archive is opened, so that
+ * the consumers can iterate only over the entries they are interested
+ * in, instead of scanning the whole TOC. */
+enum ARCHIVE_ENTRY_GROUP
+{
+    ARCHIVE_GROUP_RUNTIME_OPTION = 0, /* ARCHIVE_ITEM_RUNTIME_OPTION */
+    ARCHIVE_GROUP_PYMODULE, /* ARCHIVE_ITEM_PYMODULE, ARCHIVE_ITEM_PYPACKAGE */
+    ARCHIVE_GROUP_PYSOURCE, /* ARCHIVE_ITEM_PYSOURCE */
+    ARCHIVE_GROUP_PYZ, /* ARCHIVE_ITEM_PYZ */
+    ARCHIVE_GROUP_EXTRACTABLE, /* ARCHIVE_ITEM_BINARY, ARCHIVE_ITEM_DATA, ARCHIVE_ITEM_ZIPFILE, ARCHIVE_ITEM_SYMLINK, ARCHIVE_ITEM_DEPENDENCY */
+    ARCHIVE_GROUP_COUNT
+};
+
+/* List of TOC entries belonging to a group; entries are in TOC order. */
+struct ARCHIVE_ENTRY_LIST
+{
+    const struct TOC_ENTRY **entries;
+    size_t count;
+};
+
 /* The archive structure */
 struct ARCHIVE
 {
@@ -65,10 +162,53 @@ struct ARCHIVE
     char filename[PYI_PATH_MAX];
 
     uint64_t pkg_offset; /* Offset of the PKG archive in the file */
+    int format_version; /* Archive format version; ARCHIVE_FORMAT_VERSION_* */
+
+    /* Read-only memory mapping of the whole archive file, created when
+     * the archive is opened. Entries' data blobs are accessed directly
+     * from the mapping, without having to re-open the file for each
+     * entry. If mapping could not be created (for example, due to
+     * limited address space on 32-bit platforms), this is NULL, and
+     * entries' data is read from the file instead. */
+    const unsigned char *mapped_data;
+    uint64_t mapped_size;
+
+#if defined(__linux__)
+    /* File descriptor of the archive file, kept open (with close-on-exec
+     * flag) for the lifetime of the archive structure, to allow stored
+     * entries to be extracted via copy_file_range() / FICLONERANGE.
+     * -1 if unavailable. */
+    int fd;
+#endif
 
     struct TOC_ENTRY *toc; /* Buffer containing all TOC entries */
     const struct TOC_ENTRY *toc_end; /* The address at which the TOC buffer ends */
 
+    /* Per-group lists of TOC entries; see ARCHIVE_GROUP_* definitions.
+     * The lists share a single buffer (entry_groups_buffer). */
+    struct ARCHIVE_ENTRY_LIST entry_groups[ARCHIVE_GROUP_COUNT];
+    const struct TOC_ENTRY **entry_groups_buffer;
+
+    /* Open-addressing hash index over TOC entry names, used by
+     * pyi_archive_find_entry_by_name(). The size of the table is a
+     * power of two, and empty slots are NULL. If the index could not
+     * be allocated, this is NULL, and lookups fall back to linear scan
+     * of the TOC. */
+    const struct TOC_ENTRY **name_index;
+    size_t name_index_mask;
+
+    /* Flag indicating that TOC entries contain checksums, which are
+     * verified when the entries are extracted */
+    bool has_checksums;
+
+    /* Flags recording the entries whose checksum has already been
+     * verified, so that each entry is verified only once. Indexed by
+     * the entry's offset within the TOC divided by 16 (TOC entries are
+     * aligned to 16 bytes). Allocated only if the archive contains
+     * checksums; if allocation fails, this is NULL, and the checksums
+     * are verified on every access. */
+    unsigned char *verified_entries;
+
     /* Flag indicating that the archive contains extractable files,
      * and thus has onefile semantics */
     bool contains_extractable_entries;
@@ -76,6 +216,12 @@ struct ARCHIVE
     /* Pointer to SPLASH TOC entry, if available */
     const struct TOC_ENTRY *toc_splash;
 
+    /* Pointer to directory table TOC entry, if available. The entry's
+     * data contains NULL-terminated names of all parent directories
+     * of extractable entries, sorted so that each directory is preceded
+     * by its parent directory. */
+    const struct TOC_ENTRY *toc_directory_table;
+
     /* Python version: major * 100 + minor, e.g., 310 for python 3.10 */
     int python_version;
 
@@ -91,7 +237,16 @@ void pyi_archive_free(struct ARCHIVE **archive_ref);
 const struct TOC_ENTRY *pyi_archive_next_toc_entry(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
 
 unsigned char *pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
+const unsigned char *pyi_archive_get_entry_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char **data_buffer);
 int pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename);
+int pyi_archive_write2fs(const struct TOC_ENTRY *toc_entry, const unsigned char *data, const char *output_filename);
+int pyi_archive_decompress_mapped(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf);
+void pyi_archive_set_output_file_permissions(const struct TOC_ENTRY *toc_entry, FILE *out_fp);
+
+int pyi_archive_read_block_index(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, struct ARCHIVE_BLOCK_INDEX *index);
+int pyi_archive_decompress_mapped_block(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const struct ARCHIVE_BLOCK_INDEX *index, uint32_t block, unsigned char *out_buf, size_t *out_length, uint32_t *checksum);
+int pyi_archive_verify_block_checksums(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const struct ARCHIVE_BLOCK_INDEX *index, const uint32_t *block_checksums);
+void pyi_archive_free_block_index(struct ARCHIVE_BLOCK_INDEX *index);
 
 const struct TOC_ENTRY *pyi_archive_find_entry_by_name(const struct ARCHIVE *archive, const char *name);
 
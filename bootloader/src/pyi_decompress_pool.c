@@ -0,0 +1,569 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Pool of worker threads for decompression of archive entries during
+ * onefile extraction.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>  /* _get_osfhandle */
+#else
+    #include <pthread.h>
+    #include <unistd.h>  /* sysconf, pwrite */
+#endif
+#include <errno.h>
+#include <stdio.h>  /* FILE, fileno */
+#include <stdlib.h>  /* calloc, malloc, free */
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_path.h"
+#include "pyi_decompress_pool.h"
+
+
+/* Default number of worker threads is limited to this value, regardless
+ * of the number of available CPUs. */
+#define DECOMPRESS_POOL_DEFAULT_MAX_WORKERS 16
+
+/* Capacity of the job queue. The number of queued jobs is additionally
+ * limited to a few jobs per worker thread. */
+#define DECOMPRESS_POOL_QUEUE_SIZE 256
+#define DECOMPRESS_POOL_JOBS_PER_WORKER 4
+
+/* Larger entries are not decompressed in the pool (and are extracted by
+ * main thread, by streaming the decompressed data into output file). */
+#define DECOMPRESS_POOL_MAX_ENTRY_SIZE (64 * 1024 * 1024)
+
+/* Limit on the amount of decompressed data held by the queued jobs. */
+#define DECOMPRESS_POOL_MAX_BUFFERED_SIZE (256 * 1024 * 1024)
+
+struct DECOMPRESS_JOB
+{
+    const struct TOC_ENTRY *toc_entry;
+    unsigned char *data;
+    int done;
+};
+
+struct DECOMPRESS_POOL
+{
+    const struct ARCHIVE *archive;
+
+#ifdef _WIN32
+    SRWLOCK lock;
+    CONDITION_VARIABLE work_available;
+    CONDITION_VARIABLE job_done;
+    HANDLE *threads;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    pthread_cond_t job_done;
+    pthread_t *threads;
+#endif
+    unsigned int num_threads;
+
+    /* Job queue. The indices increase monotonically, and are mapped
+     * into the jobs array via modulo. The head (next job to be taken
+     * by the main thread) is accessed only by the main thread, while
+     * the tail (end of submitted jobs) is modified only by the main
+     * thread, with lock held. The next_job index (next job to be picked
+     * by a worker thread) is accessed only with lock held. */
+    struct DECOMPRESS_JOB jobs[DECOMPRESS_POOL_QUEUE_SIZE];
+    size_t head;
+    size_t tail;
+    size_t next_job;
+    size_t max_jobs;
+
+    /* Total uncompressed size of the queued jobs; main thread only. */
+    uint64_t buffered_size;
+
+    /* Blocks of the entry that is being extracted by
+     * pyi_decompress_pool_extract_blocks(). The entry, index, and output
+     * file are set up by the main thread, and remain unchanged while
+     * any blocks are in progress; the remaining fields are accessed only
+     * with lock held. */
+    const struct TOC_ENTRY *blocks_entry;
+    struct ARCHIVE_BLOCK_INDEX blocks_index;
+    uint32_t *blocks_checksums; /* NULL if archive has no checksums */
+    FILE *blocks_out_fp;
+    uint32_t next_block;
+    unsigned int blocks_in_progress;
+    int blocks_failed;
+
+    int shutdown;
+};
+
+
+/*
+ * Synchronization primitives.
+ */
+static void
+_pyi_decompress_pool_lock(struct DECOMPRESS_POOL *pool)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&pool->lock);
+#else
+    pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void
+_pyi_decompress_pool_unlock(struct DECOMPRESS_POOL *pool)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&pool->lock);
+#else
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+#ifdef _WIN32
+    #define _pyi_decompress_pool_wait(pool, cond) SleepConditionVariableSRW(&(pool)->cond, &(pool)->lock, INFINITE, 0)
+    #define _pyi_decompress_pool_signal(pool, cond) WakeConditionVariable(&(pool)->cond)
+    #define _pyi_decompress_pool_broadcast(pool, cond) WakeAllConditionVariable(&(pool)->cond)
+#else
+    #define _pyi_decompress_pool_wait(pool, cond) pthread_cond_wait(&(pool)->cond, &(pool)->lock)
+    #define _pyi_decompress_pool_signal(pool, cond) pthread_cond_signal(&(pool)->cond)
+    #define _pyi_decompress_pool_broadcast(pool, cond) pthread_cond_broadcast(&(pool)->cond)
+#endif
+
+
+unsigned int
+pyi_decompress_pool_get_default_worker_count(void)
+{
+    long num_cpus;
+
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    num_cpus = (long)system_info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    num_cpus = 1;
+#endif
+
+    if (num_cpus < 1) {
+        return 1;
+    }
+    if (num_cpus > DECOMPRESS_POOL_DEFAULT_MAX_WORKERS) {
+        return DECOMPRESS_POOL_DEFAULT_MAX_WORKERS;
+    }
+    return (unsigned int)num_cpus;
+}
+
+/* Check whether there are blocks waiting to be processed; must be
+ * called with lock held. */
+static int
+_pyi_decompress_pool_has_blocks(const struct DECOMPRESS_POOL *pool)
+{
+    return pool->blocks_entry != NULL && !pool->blocks_failed && pool->next_block < pool->blocks_index.num_blocks;
+}
+
+/*
+ * Write the data into the file at the given offset, without moving the
+ * file position, so that the blocks can be written concurrently and in
+ * any order.
+ */
+static int
+_pyi_decompress_pool_write_at(FILE *out_fp, const unsigned char *data, size_t length, uint64_t offset)
+{
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(out_fp));
+
+    while (length > 0) {
+        OVERLAPPED overlapped = {0};
+        DWORD chunk_size = (length > 0x40000000) ? 0x40000000 : (DWORD)length;
+        DWORD written;
+
+        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        if (!WriteFile(handle, data, chunk_size, &written, &overlapped) || written == 0) {
+            return -1;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+#else
+    int fd = fileno(out_fp);
+
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Decompress the given block of the entry that is being extracted by
+ * pyi_decompress_pool_extract_blocks(), and write it at its offset in
+ * the output file. Called without lock held.
+ */
+static int
+_pyi_decompress_pool_process_block(struct DECOMPRESS_POOL *pool, uint32_t block)
+{
+    unsigned char *buffer;
+    size_t block_length;
+    int rc = -1;
+
+    buffer = (unsigned char *)malloc(pool->blocks_index.block_size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    if (pyi_archive_decompress_mapped_block(pool->archive, pool->blocks_entry, &pool->blocks_index, block, buffer, &block_length, pool->blocks_checksums ? &pool->blocks_checksums[block] : NULL) == 0) {
+        rc = _pyi_decompress_pool_write_at(pool->blocks_out_fp, buffer, block_length, (uint64_t)block * pool->blocks_index.block_size);
+    }
+    free(buffer);
+
+    return rc;
+}
+
+/* Pick the next block and process it; must be called with lock held,
+ * which is temporarily released while the block is processed. */
+static void
+_pyi_decompress_pool_run_block(struct DECOMPRESS_POOL *pool)
+{
+    uint32_t block = pool->next_block++;
+    int rc;
+
+    pool->blocks_in_progress++;
+    _pyi_decompress_pool_unlock(pool);
+
+    rc = _pyi_decompress_pool_process_block(pool, block);
+
+    _pyi_decompress_pool_lock(pool);
+    pool->blocks_in_progress--;
+    if (rc < 0) {
+        pool->blocks_failed = 1;
+    }
+    _pyi_decompress_pool_broadcast(pool, job_done);
+}
+
+/*
+ * Worker thread's main loop: pick the next block or the next job from
+ * the queue and decompress it, until the pool is shut down. Blocks take
+ * precedence, as the main thread is waiting for them.
+ */
+static void
+_pyi_decompress_pool_worker(struct DECOMPRESS_POOL *pool)
+{
+    _pyi_decompress_pool_lock(pool);
+
+    for (;;) {
+        struct DECOMPRESS_JOB *job;
+        unsigned char *data;
+
+        while (pool->next_job == pool->tail && !_pyi_decompress_pool_has_blocks(pool) && !pool->shutdown) {
+            _pyi_decompress_pool_wait(pool, work_available);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        if (_pyi_decompress_pool_has_blocks(pool)) {
+            _pyi_decompress_pool_run_block(pool);
+            continue;
+        }
+        job = &pool->jobs[pool->next_job % DECOMPRESS_POOL_QUEUE_SIZE];
+        pool->next_job++;
+
+        _pyi_decompress_pool_unlock(pool);
+
+        /* Decompress; errors are not reported here, but by the main
+         * thread, which retries the extraction of the failed entry. */
+        data = (unsigned char *)malloc(job->toc_entry->uncompressed_length > 0 ? (size_t)job->toc_entry->uncompressed_length : 1);
+        if (data != NULL && pyi_archive_decompress_mapped(pool->archive, job->toc_entry, data) < 0) {
+            free(data);
+            data = NULL;
+        }
+
+        _pyi_decompress_pool_lock(pool);
+
+        job->data = data;
+        job->done = 1;
+        _pyi_decompress_pool_broadcast(pool, job_done);
+    }
+
+    _pyi_decompress_pool_unlock(pool);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+_pyi_decompress_pool_thread(LPVOID arg)
+{
+    _pyi_decompress_pool_worker((struct DECOMPRESS_POOL *)arg);
+    return 0;
+}
+#else
+static void *
+_pyi_decompress_pool_thread(void *arg)
+{
+    _pyi_decompress_pool_worker((struct DECOMPRESS_POOL *)arg);
+    return NULL;
+}
+#endif
+
+struct DECOMPRESS_POOL *
+pyi_decompress_pool_new(const struct ARCHIVE *archive, unsigned int num_workers)
+{
+    struct DECOMPRESS_POOL *pool;
+    unsigned int i;
+
+    /* Worker threads decompress data directly from memory mapping */
+    if (archive->mapped_data == NULL) {
+        return NULL;
+    }
+
+    if (num_workers > PYI_DECOMPRESS_POOL_MAX_WORKERS) {
+        num_workers = PYI_DECOMPRESS_POOL_MAX_WORKERS;
+    }
+
+    pool = (struct DECOMPRESS_POOL *)calloc(1, sizeof(struct DECOMPRESS_POOL));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->archive = archive;
+    pool->max_jobs = num_workers * DECOMPRESS_POOL_JOBS_PER_WORKER;
+    if (pool->max_jobs > DECOMPRESS_POOL_QUEUE_SIZE) {
+        pool->max_jobs = DECOMPRESS_POOL_QUEUE_SIZE;
+    }
+
+#ifdef _WIN32
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->work_available);
+    InitializeConditionVariable(&pool->job_done);
+    pool->threads = (HANDLE *)calloc(num_workers, sizeof(HANDLE));
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+    pool->threads = (pthread_t *)calloc(num_workers, sizeof(pthread_t));
+#endif
+    if (pool->threads == NULL) {
+        pyi_decompress_pool_free(&pool);
+        return NULL;
+    }
+
+    /* Start worker threads; if some fail to start, proceed with the
+     * ones that were started. */
+    for (i = 0; i < num_workers; i++) {
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, _pyi_decompress_pool_thread, pool, 0, NULL);
+        if (pool->threads[i] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&pool->threads[i], NULL, _pyi_decompress_pool_thread, pool) != 0) {
+            break;
+        }
+#endif
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        PYI_DEBUG("LOADER: failed to start decompression worker threads.\n");
+        pyi_decompress_pool_free(&pool);
+        return NULL;
+    }
+
+    PYI_DEBUG("LOADER: started %u decompression worker thread(s).\n", pool->num_threads);
+
+    return pool;
+}
+
+int
+pyi_decompress_pool_submit(struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry)
+{
+    struct DECOMPRESS_JOB *job;
+
+    /* Only compressed regular files are decompressed in the pool */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE || toc_entry->uncompressed_length > DECOMPRESS_POOL_MAX_ENTRY_SIZE) {
+        return 0;
+    }
+    switch (toc_entry->typecode) {
+        case ARCHIVE_ITEM_BINARY:
+        case ARCHIVE_ITEM_DATA:
+        case ARCHIVE_ITEM_ZIPFILE: {
+            break;
+        }
+        default: {
+            return 0;
+        }
+    }
+
+    /* Check the limits; an empty queue accepts any suitable entry */
+    if (pool->tail != pool->head) {
+        if (pool->tail - pool->head >= pool->max_jobs || pool->buffered_size + toc_entry->uncompressed_length > DECOMPRESS_POOL_MAX_BUFFERED_SIZE) {
+            return -1;
+        }
+    }
+
+    job = &pool->jobs[pool->tail % DECOMPRESS_POOL_QUEUE_SIZE];
+    job->toc_entry = toc_entry;
+    job->data = NULL;
+    job->done = 0;
+    pool->buffered_size += toc_entry->uncompressed_length;
+
+    _pyi_decompress_pool_lock(pool);
+    pool->tail++;
+    _pyi_decompress_pool_signal(pool, work_available);
+    _pyi_decompress_pool_unlock(pool);
+
+    return 0;
+}
+
+int
+pyi_decompress_pool_is_pending(const struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry)
+{
+    return pool->head != pool->tail && pool->jobs[pool->head % DECOMPRESS_POOL_QUEUE_SIZE].toc_entry == toc_entry;
+}
+
+unsigned char *
+pyi_decompress_pool_take(struct DECOMPRESS_POOL *pool)
+{
+    struct DECOMPRESS_JOB *job = &pool->jobs[pool->head % DECOMPRESS_POOL_QUEUE_SIZE];
+    unsigned char *data;
+
+    _pyi_decompress_pool_lock(pool);
+    while (!job->done) {
+        _pyi_decompress_pool_wait(pool, job_done);
+    }
+    _pyi_decompress_pool_unlock(pool);
+
+    data = job->data;
+    pool->buffered_size -= job->toc_entry->uncompressed_length;
+    pool->head++;
+
+    job->toc_entry = NULL;
+    job->data = NULL;
+    job->done = 0;
+
+    return data;
+}
+
+int
+pyi_decompress_pool_extract_blocks(struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    FILE *out_fp;
+    int rc;
+
+    if (pyi_archive_read_block_index(pool->archive, toc_entry, &pool->blocks_index) < 0) {
+        return -1;
+    }
+
+    /* Checksums of the blocks, combined once all blocks are done */
+    if (pool->archive->has_checksums) {
+        pool->blocks_checksums = (uint32_t *)calloc(pool->blocks_index.num_blocks > 0 ? pool->blocks_index.num_blocks : 1, sizeof(uint32_t));
+        if (pool->blocks_checksums == NULL) {
+            pyi_archive_free_block_index(&pool->blocks_index);
+            return -1;
+        }
+    }
+
+    out_fp = pyi_path_fopen(output_filename, "wb");
+    if (out_fp == NULL) {
+        free(pool->blocks_checksums);
+        pool->blocks_checksums = NULL;
+        pyi_archive_free_block_index(&pool->blocks_index);
+        return -1;
+    }
+
+    _pyi_decompress_pool_lock(pool);
+    pool->blocks_entry = toc_entry;
+    pool->blocks_out_fp = out_fp;
+    pool->next_block = 0;
+    pool->blocks_in_progress = 0;
+    pool->blocks_failed = 0;
+    _pyi_decompress_pool_broadcast(pool, work_available);
+
+    /* The main thread processes the blocks as well, and then waits for
+     * the blocks that are still being processed by worker threads. */
+    while (_pyi_decompress_pool_has_blocks(pool)) {
+        _pyi_decompress_pool_run_block(pool);
+    }
+    while (pool->blocks_in_progress > 0) {
+        _pyi_decompress_pool_wait(pool, job_done);
+    }
+
+    rc = pool->blocks_failed ? -1 : 0;
+    pool->blocks_entry = NULL;
+    pool->blocks_out_fp = NULL;
+    _pyi_decompress_pool_unlock(pool);
+
+    if (rc == 0 && pool->blocks_checksums) {
+        rc = pyi_archive_verify_block_checksums(pool->archive, toc_entry, &pool->blocks_index, pool->blocks_checksums);
+    }
+    free(pool->blocks_checksums);
+    pool->blocks_checksums = NULL;
+    pyi_archive_free_block_index(&pool->blocks_index);
+    pyi_archive_set_output_file_permissions(toc_entry, out_fp);
+    fclose(out_fp);
+
+    PYI_DEBUG("LOADER: extracted %s using parallel decompression of its blocks (%s).\n", toc_entry->name, rc == 0 ? "success" : "failure");
+
+    return rc;
+}
+
+void
+pyi_decompress_pool_free(struct DECOMPRESS_POOL **pool_ref)
+{
+    struct DECOMPRESS_POOL *pool = *pool_ref;
+    unsigned int i;
+
+    *pool_ref = NULL;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    /* Stop the worker threads; jobs that are in progress are completed,
+     * while the remaining ones are discarded. */
+    _pyi_decompress_pool_lock(pool);
+    pool->shutdown = 1;
+    _pyi_decompress_pool_broadcast(pool, work_available);
+    _pyi_decompress_pool_unlock(pool);
+
+    for (i = 0; i < pool->num_threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+    free(pool->threads);
+
+    /* Free the data of jobs that were not taken */
+    for (; pool->head != pool->tail; pool->head++) {
+        free(pool->jobs[pool->head % DECOMPRESS_POOL_QUEUE_SIZE].data);
+    }
+
+#ifndef _WIN32
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+
+    free(pool);
+}
@@ -0,0 +1,70 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Pool of worker threads for decompression of archive entries during
+ * onefile extraction.
+ *
+ * The main thread submits compressed entries ahead of the entry that it
+ * is currently processing, and then takes the decompressed data in the
+ * same order. Thus, the (independent) deflate streams are decompressed
+ * concurrently, while the output files are still created and written by
+ * the main thread, in the order of the archive's TOC.
+ */
+
+#ifndef PYI_DECOMPRESS_POOL_H
+#define PYI_DECOMPRESS_POOL_H
+
+struct ARCHIVE;
+struct TOC_ENTRY;
+struct DECOMPRESS_POOL;
+
+/* Upper limit on the number of worker threads. */
+#define PYI_DECOMPRESS_POOL_MAX_WORKERS 64
+
+/* Default number of worker threads, based on number of available CPUs.
+ * Returns 1 if worker threads should not be used. */
+unsigned int pyi_decompress_pool_get_default_worker_count(void);
+
+/* Create the pool and start the worker threads. Returns NULL if the
+ * pool cannot be used (for example, if the archive is not memory-mapped,
+ * or if worker threads cannot be started). */
+struct DECOMPRESS_POOL *pyi_decompress_pool_new(const struct ARCHIVE *archive, unsigned int num_workers);
+
+/* Submit the entry for decompression. Returns 0 if the entry has been
+ * submitted, or if it is not suitable for decompression in the pool
+ * (in which case it should be extracted by the caller as usual), and
+ * -1 if the pool is full. */
+int pyi_decompress_pool_submit(struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry);
+
+/* Check whether the given entry is the next one in the pool's queue. */
+int pyi_decompress_pool_is_pending(const struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry);
+
+/* Wait for the decompression of the next entry in the queue, and return
+ * its data (to be freed by the caller). Returns NULL if decompression
+ * failed; errors are not reported by the worker threads, so the caller
+ * should retry the extraction using regular codepath. */
+unsigned char *pyi_decompress_pool_take(struct DECOMPRESS_POOL *pool);
+
+/* Extract an entry that is compressed as a sequence of independent
+ * blocks (ARCHIVE_COMPRESSION_ZLIB_BLOCKS) into the output file, by
+ * decompressing the blocks in parallel, and writing each block at its
+ * offset. The main thread participates in the decompression. Returns 0
+ * on success, and -1 on failure; errors are not reported, so the caller
+ * should retry the extraction using regular codepath. */
+int pyi_decompress_pool_extract_blocks(struct DECOMPRESS_POOL *pool, const struct TOC_ENTRY *toc_entry, const char *output_filename);
+
+/* Stop the worker threads, and free the pool. */
+void pyi_decompress_pool_free(struct DECOMPRESS_POOL **pool_ref);
+
+#endif /* PYI_DECOMPRESS_POOL_H */
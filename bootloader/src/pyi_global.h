@@ -250,15 +250,18 @@
      * using ntohl(), which requires linking against ws2 library. */
     #if BYTE_ORDER == LITTLE_ENDIAN
         #if defined(_MSC_VER)
-            #include <stdlib.h>  /* _byteswap_ulong */
+            #include <stdlib.h>  /* _byteswap_ulong, _byteswap_uint64 */
             #define pyi_be32toh(x) _byteswap_ulong(x)
+            #define pyi_be64toh(x) _byteswap_uint64(x)
         #elif defined(__GNUC__) || defined(__clang__)
             #define pyi_be32toh(x) __builtin_bswap32(x)
+            #define pyi_be64toh(x) __builtin_bswap64(x)
         #else
             #error Unsupported compiler
         #endif
     #elif BYTE_ORDER == BIG_ENDIAN
         #define pyi_be32toh(x) (x)
+        #define pyi_be64toh(x) (x)
     #else
         #error Unsupported byte order
     #endif
@@ -271,6 +274,12 @@
         #include <netinet/in.h>  /* ntohl */
     #endif
     #define pyi_be32toh(x) ntohl(x)
+    /* There is no portable 64-bit equivalent of ntohl(), so compose one
+     * from two 32-bit conversions; the byte-order check is evaluated at
+     * compile time. */
+    #define pyi_be64toh(x) \
+        ((ntohl(1) == 1) ? (uint64_t)(x) : \
+         (((uint64_t)ntohl((uint32_t)(x)) << 32) | (uint64_t)ntohl((uint32_t)((uint64_t)(x) >> 32))))
 #endif /* ifdef _WIN32 */
 
 #endif /* PYI_GLOBAL_H */
@@ -0,0 +1,656 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Batched extraction of onefile archive entries using Linux io_uring.
+ *
+ * The queued files are processed in batches, in two stages: first, all
+ * output files in the batch are opened, and then, for each file, the
+ * space is preallocated, the data is written, and the file is closed.
+ * The requests of each stage are submitted together, so the extraction
+ * of the whole batch requires only a couple of system calls.
+ *
+ * The io_uring interface is used directly via system calls, so that
+ * the bootloader does not depend on liburing.
+ */
+
+/* Having a header included outside of the ifdef block prevents the compilation
+ * unit from becoming empty, which is disallowed by pedantic ISO C. */
+#include "pyi_global.h"
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <errno.h>
+#include <fcntl.h>  /* AT_FDCWD, O_* */
+#include <stdlib.h>  /* calloc, free */
+#include <string.h>  /* memset, strcmp, strncmp, strdup */
+#include <unistd.h>  /* close, syscall */
+#include <sys/mman.h>  /* mmap, munmap */
+#include <sys/stat.h>  /* umask */
+#include <sys/syscall.h>  /* __NR_io_uring_* */
+#include <linux/io_uring.h>
+
+/* PyInstaller headers. */
+#include "pyi_archive.h"
+#include "pyi_io_uring.h"
+
+
+/* Maximum number of files in a batch. Each file requires up to three
+ * submission queue entries (fallocate, write, and close). */
+#define IO_URING_BATCH_SIZE 64
+#define IO_URING_QUEUE_DEPTH (3 * IO_URING_BATCH_SIZE)
+
+/* Entries larger than this are extracted immediately, using the regular
+ * codepath. This keeps the data of each file within a single write
+ * request, and bounds the memory used for decompressed data. */
+#define IO_URING_MAX_ENTRY_SIZE (8 * 1024 * 1024)
+
+/* Limit on the amount of decompressed data held by pending files; when
+ * exceeded, the batch is flushed before queueing the next file. */
+#define IO_URING_MAX_BUFFERED_SIZE (64 * 1024 * 1024)
+
+/* Request type, stored in the lower bits of user_data field (the upper
+ * bits hold the index of the file in the batch). */
+#define IO_URING_REQUEST_OPEN 0
+#define IO_URING_REQUEST_FALLOCATE 1
+#define IO_URING_REQUEST_WRITE 2
+#define IO_URING_REQUEST_CLOSE 3
+
+struct IO_URING_FILE
+{
+    const struct TOC_ENTRY *toc_entry;
+    char *filename;
+    const char *open_filename; /* filename, relative to output_dir_fd */
+
+    /* Entry's data; if data_buffer is not NULL, the data is owned by
+     * this structure, otherwise it is borrowed from the archive's
+     * memory mapping. */
+    const unsigned char *data;
+    unsigned char *data_buffer;
+
+    int fd;
+    int failed;
+};
+
+struct IO_URING_EXTRACTOR
+{
+    const struct ARCHIVE *archive;
+
+    /* File descriptor of the output directory, and the length of its
+     * path (including the trailing separator). Output files within the
+     * directory are opened relative to the descriptor, which avoids
+     * resolution of the directory path for each file. */
+    int output_dir_fd;
+    size_t output_dir_length;
+    const char *output_dir;
+
+    int ring_fd;
+
+    /* Mapped rings; if the kernel supports single mapping for both
+     * rings, cq_ring is the same as sq_ring and cq_ring_size is 0. */
+    unsigned char *sq_ring;
+    size_t sq_ring_size;
+    unsigned char *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* Submission queue */
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Pending files */
+    struct IO_URING_FILE files[IO_URING_BATCH_SIZE];
+    int num_files;
+    size_t buffered_size;
+};
+
+
+/*
+ * Check that the kernel supports all io_uring operations that we need.
+ * The opcode probing is available since linux 5.6, which is also the
+ * kernel version that introduced the open, close, and fallocate
+ * operations. Returns 0 if all operations are supported, -1 otherwise.
+ */
+static int
+_pyi_io_uring_probe_operations(int ring_fd)
+{
+    static const unsigned char required_ops[] = {
+        IORING_OP_OPENAT,
+        IORING_OP_FALLOCATE,
+        IORING_OP_WRITE,
+        IORING_OP_CLOSE
+    };
+    const unsigned int MAX_PROBE_OPS = 256;
+    struct io_uring_probe *probe;
+    size_t i;
+    int rc = -1;
+
+    probe = (struct io_uring_probe *)calloc(1, sizeof(struct io_uring_probe) + MAX_PROBE_OPS * sizeof(struct io_uring_probe_op));
+    if (probe == NULL) {
+        return -1;
+    }
+
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, MAX_PROBE_OPS) < 0) {
+        PYI_DEBUG("LOADER: failed to probe io_uring operations: %s\n", strerror(errno));
+        goto cleanup;
+    }
+
+    for (i = 0; i < sizeof(required_ops) / sizeof(required_ops[0]); i++) {
+        if (required_ops[i] > probe->last_op || !(probe->ops[required_ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+            PYI_DEBUG("LOADER: io_uring operation %d is not supported.\n", required_ops[i]);
+            goto cleanup;
+        }
+    }
+
+    rc = 0;
+
+cleanup:
+    free(probe);
+
+    return rc;
+}
+
+/*
+ * Map the submission and completion rings into our address space.
+ */
+static int
+_pyi_io_uring_map_rings(struct IO_URING_EXTRACTOR *extractor, const struct io_uring_params *params)
+{
+    void *ptr;
+
+    extractor->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    extractor->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (extractor->cq_ring_size > extractor->sq_ring_size) {
+            extractor->sq_ring_size = extractor->cq_ring_size;
+        }
+        extractor->cq_ring_size = 0;
+    }
+
+    ptr = mmap(NULL, extractor->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, extractor->ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+        extractor->sq_ring_size = 0;
+        return -1;
+    }
+    extractor->sq_ring = (unsigned char *)ptr;
+
+    if (extractor->cq_ring_size) {
+        ptr = mmap(NULL, extractor->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, extractor->ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) {
+            extractor->cq_ring_size = 0;
+            return -1;
+        }
+        extractor->cq_ring = (unsigned char *)ptr;
+    } else {
+        extractor->cq_ring = extractor->sq_ring;
+    }
+
+    extractor->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, extractor->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, extractor->ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) {
+        extractor->sqes_size = 0;
+        return -1;
+    }
+    extractor->sqes = (struct io_uring_sqe *)ptr;
+
+    extractor->sq_tail = (unsigned *)(extractor->sq_ring + params->sq_off.tail);
+    extractor->sq_array = (unsigned *)(extractor->sq_ring + params->sq_off.array);
+    extractor->sq_mask = *(unsigned *)(extractor->sq_ring + params->sq_off.ring_mask);
+
+    extractor->cq_head = (unsigned *)(extractor->cq_ring + params->cq_off.head);
+    extractor->cq_tail = (unsigned *)(extractor->cq_ring + params->cq_off.tail);
+    extractor->cq_mask = *(unsigned *)(extractor->cq_ring + params->cq_off.ring_mask);
+    extractor->cqes = (struct io_uring_cqe *)(extractor->cq_ring + params->cq_off.cqes);
+
+    return 0;
+}
+
+struct IO_URING_EXTRACTOR *
+pyi_io_uring_extractor_new(const struct ARCHIVE *archive, const char *output_dir)
+{
+    struct IO_URING_EXTRACTOR *extractor;
+    struct io_uring_params params;
+    mode_t mask;
+
+    /* There is no io_uring equivalent of fchmod(), so the files are
+     * created with their final permissions. This works only if umask
+     * does not restrict the permissions of the owner. */
+    mask = umask(0);
+    umask(mask);
+    if (mask & S_IRWXU) {
+        PYI_DEBUG("LOADER: umask %03o is not compatible with io_uring extraction.\n", (unsigned int)mask);
+        return NULL;
+    }
+
+    extractor = (struct IO_URING_EXTRACTOR *)calloc(1, sizeof(struct IO_URING_EXTRACTOR));
+    if (extractor == NULL) {
+        return NULL;
+    }
+    extractor->archive = archive;
+    extractor->output_dir_fd = -1;
+
+    /* Set up the io_uring instance. This fails with ENOSYS on kernels
+     * without io_uring support, and with EPERM if io_uring is disabled
+     * by system policy (e.g., kernel.io_uring_disabled sysctl, seccomp
+     * filters in containers). */
+    memset(&params, 0, sizeof(params));
+    extractor->ring_fd = (int)syscall(__NR_io_uring_setup, IO_URING_QUEUE_DEPTH, &params);
+    if (extractor->ring_fd < 0) {
+        PYI_DEBUG("LOADER: io_uring is not available: %s\n", strerror(errno));
+        goto error;
+    }
+
+    if (_pyi_io_uring_probe_operations(extractor->ring_fd) < 0) {
+        goto error;
+    }
+
+    if (_pyi_io_uring_map_rings(extractor, &params) < 0) {
+        PYI_DEBUG("LOADER: failed to map io_uring rings: %s\n", strerror(errno));
+        goto error;
+    }
+
+    /* Open the output directory; if this fails, the output files are
+     * opened using their full paths. */
+    extractor->output_dir_fd = open(output_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    extractor->output_dir_length = strlen(output_dir) + 1;
+    extractor->output_dir = output_dir;
+
+    return extractor;
+
+error:
+    pyi_io_uring_extractor_free(&extractor);
+    return NULL;
+}
+
+/*
+ * Release resources held by pending files, and clear the batch. Output
+ * files that are still open (if the flush was aborted after they were
+ * opened) are closed.
+ */
+static void
+_pyi_io_uring_clear_batch(struct IO_URING_EXTRACTOR *extractor)
+{
+    int i;
+
+    for (i = 0; i < extractor->num_files; i++) {
+        if (extractor->files[i].fd >= 0) {
+            close(extractor->files[i].fd);
+        }
+        free(extractor->files[i].filename);
+        free(extractor->files[i].data_buffer);
+    }
+    memset(extractor->files, 0, sizeof(extractor->files));
+    extractor->num_files = 0;
+    extractor->buffered_size = 0;
+}
+
+void
+pyi_io_uring_extractor_free(struct IO_URING_EXTRACTOR **extractor_ref)
+{
+    struct IO_URING_EXTRACTOR *extractor = *extractor_ref;
+
+    *extractor_ref = NULL;
+
+    if (extractor == NULL) {
+        return;
+    }
+
+    _pyi_io_uring_clear_batch(extractor);
+
+    if (extractor->sqes_size) {
+        munmap(extractor->sqes, extractor->sqes_size);
+    }
+    if (extractor->cq_ring_size) {
+        munmap(extractor->cq_ring, extractor->cq_ring_size);
+    }
+    if (extractor->sq_ring_size) {
+        munmap(extractor->sq_ring, extractor->sq_ring_size);
+    }
+    if (extractor->ring_fd >= 0) {
+        close(extractor->ring_fd);
+    }
+    if (extractor->output_dir_fd >= 0) {
+        close(extractor->output_dir_fd);
+    }
+
+    free(extractor);
+}
+
+/*
+ * Obtain the next free submission queue entry. The number of entries
+ * queued in the current submission is tracked in *num_queued; the
+ * caller must ensure that it does not exceed the queue depth.
+ */
+static struct io_uring_sqe *
+_pyi_io_uring_get_sqe(struct IO_URING_EXTRACTOR *extractor, unsigned *num_queued, int file_index, int request_type)
+{
+    unsigned index = (*extractor->sq_tail + *num_queued) & extractor->sq_mask;
+    struct io_uring_sqe *sqe = &extractor->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = ((uint64_t)file_index << 2) | request_type;
+    extractor->sq_array[index] = index;
+    (*num_queued)++;
+
+    return sqe;
+}
+
+/*
+ * Process the result of a completed request.
+ */
+static void
+_pyi_io_uring_process_completion(struct IO_URING_EXTRACTOR *extractor, uint64_t user_data, int result)
+{
+    struct IO_URING_FILE *file = &extractor->files[user_data >> 2];
+
+    switch (user_data & 3) {
+        case IO_URING_REQUEST_OPEN: {
+            if (result < 0) {
+                PYI_DEBUG("LOADER: io_uring: failed to open %s: %s\n", file->filename, strerror(-result));
+                file->failed = 1;
+            } else {
+                file->fd = result;
+            }
+            break;
+        }
+        case IO_URING_REQUEST_FALLOCATE: {
+            /* Preallocation is an optimization; failure (for example,
+             * due to file system not supporting it) is not an error. */
+            break;
+        }
+        case IO_URING_REQUEST_WRITE: {
+            if (result < 0 || (uint64_t)result != file->toc_entry->uncompressed_length) {
+                PYI_DEBUG("LOADER: io_uring: failed to write %s: %s\n", file->filename, result < 0 ? strerror(-result) : "short write");
+                file->failed = 1;
+            }
+            break;
+        }
+        case IO_URING_REQUEST_CLOSE: {
+            if (result < 0) {
+                PYI_DEBUG("LOADER: io_uring: failed to close %s: %s\n", file->filename, strerror(-result));
+                file->failed = 1;
+            }
+            file->fd = -1;
+            break;
+        }
+    }
+}
+
+/*
+ * Submit the queued requests, and wait for all of them to complete.
+ */
+static int
+_pyi_io_uring_submit_and_wait(struct IO_URING_EXTRACTOR *extractor, unsigned num_queued)
+{
+    unsigned num_submitted = 0;
+    unsigned num_completed = 0;
+
+    /* Publish the queued entries to the kernel */
+    __atomic_store_n(extractor->sq_tail, *extractor->sq_tail + num_queued, __ATOMIC_RELEASE);
+
+    while (num_completed < num_queued) {
+        unsigned head;
+        unsigned tail;
+        long rc;
+
+        rc = syscall(__NR_io_uring_enter, extractor->ring_fd, num_queued - num_submitted, num_queued - num_completed, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        num_submitted += (unsigned)rc;
+
+        head = *extractor->cq_head;
+        tail = __atomic_load_n(extractor->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const struct io_uring_cqe *cqe = &extractor->cqes[head & extractor->cq_mask];
+            _pyi_io_uring_process_completion(extractor, cqe->user_data, cqe->res);
+            head++;
+            num_completed++;
+        }
+        __atomic_store_n(extractor->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+int
+pyi_io_uring_extractor_flush(struct IO_URING_EXTRACTOR *extractor)
+{
+    unsigned num_queued;
+    int i;
+    int rc = 0;
+
+    if (extractor->num_files == 0) {
+        return 0;
+    }
+
+    /* Stage 1: open (create) all output files. */
+    num_queued = 0;
+    for (i = 0; i < extractor->num_files; i++) {
+        struct IO_URING_FILE *file = &extractor->files[i];
+        struct io_uring_sqe *sqe = _pyi_io_uring_get_sqe(extractor, &num_queued, i, IO_URING_REQUEST_OPEN);
+
+        sqe->opcode = IORING_OP_OPENAT;
+        if (file->open_filename != file->filename) {
+            sqe->fd = extractor->output_dir_fd;
+        } else {
+            sqe->fd = AT_FDCWD;
+        }
+        sqe->addr = (uint64_t)(uintptr_t)file->open_filename;
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        if (file->toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
+            sqe->len = S_IRUSR | S_IWUSR | S_IXUSR;
+        } else {
+            sqe->len = S_IRUSR | S_IWUSR;
+        }
+    }
+
+    if (_pyi_io_uring_submit_and_wait(extractor, num_queued) < 0) {
+        PYI_PERROR("io_uring_enter", "Failed to extract files: failed to submit io_uring requests!\n");
+        rc = -1;
+        goto cleanup;
+    }
+
+    /* Stage 2: for each opened file, preallocate the space, write the
+     * data, and close the file. The requests for each file are linked,
+     * so they are executed in order; hard links ensure that subsequent
+     * requests are executed (most importantly, that the file is closed)
+     * even if the preceding request fails. */
+    num_queued = 0;
+    for (i = 0; i < extractor->num_files; i++) {
+        struct IO_URING_FILE *file = &extractor->files[i];
+        uint64_t length = file->toc_entry->uncompressed_length;
+        struct io_uring_sqe *sqe;
+
+        if (file->fd < 0) {
+            continue;
+        }
+
+        if (length > 0) {
+            sqe = _pyi_io_uring_get_sqe(extractor, &num_queued, i, IO_URING_REQUEST_FALLOCATE);
+            sqe->opcode = IORING_OP_FALLOCATE;
+            sqe->flags = IOSQE_IO_HARDLINK;
+            sqe->fd = file->fd;
+            sqe->off = 0;
+            sqe->addr = length; /* length of the allocated range */
+            sqe->len = 0; /* fallocate mode */
+
+            sqe = _pyi_io_uring_get_sqe(extractor, &num_queued, i, IO_URING_REQUEST_WRITE);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->flags = IOSQE_IO_HARDLINK;
+            sqe->fd = file->fd;
+            sqe->off = 0;
+            sqe->addr = (uint64_t)(uintptr_t)file->data;
+            sqe->len = (uint32_t)length;
+        }
+
+        sqe = _pyi_io_uring_get_sqe(extractor, &num_queued, i, IO_URING_REQUEST_CLOSE);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = file->fd;
+    }
+
+    if (num_queued > 0 && _pyi_io_uring_submit_and_wait(extractor, num_queued) < 0) {
+        PYI_PERROR("io_uring_enter", "Failed to extract files: failed to submit io_uring requests!\n");
+        rc = -1;
+        goto cleanup;
+    }
+
+    /* Stage 3: retry the extraction of failed files using the regular
+     * codepath, which also takes care of reporting the errors. */
+    for (i = 0; i < extractor->num_files; i++) {
+        struct IO_URING_FILE *file = &extractor->files[i];
+
+        if (!file->failed) {
+            continue;
+        }
+
+        if (pyi_archive_extract2fs(extractor->archive, file->toc_entry, file->filename) < 0) {
+            PYI_ERROR("Failed to extract entry: %s.\n", file->toc_entry->name);
+            rc = -1;
+            break;
+        }
+    }
+
+cleanup:
+    _pyi_io_uring_clear_batch(extractor);
+
+    return rc;
+}
+
+/*
+ * Make room for a file in the batch: flush the batch if it is full, or
+ * if it would hold too much data after adding the file.
+ */
+static int
+_pyi_io_uring_reserve_file(struct IO_URING_EXTRACTOR *extractor, uint64_t buffered_size)
+{
+    if (extractor->num_files == IO_URING_BATCH_SIZE || extractor->buffered_size + buffered_size > IO_URING_MAX_BUFFERED_SIZE) {
+        return pyi_io_uring_extractor_flush(extractor);
+    }
+    return 0;
+}
+
+/*
+ * Add a file to the batch; the data_buffer (if not NULL) is owned by
+ * the batch from this point on, including on failure.
+ */
+static int
+_pyi_io_uring_queue_file(struct IO_URING_EXTRACTOR *extractor, const struct TOC_ENTRY *toc_entry, const char *output_filename, const unsigned char *data, unsigned char *data_buffer)
+{
+    struct IO_URING_FILE *file = &extractor->files[extractor->num_files];
+
+    file->filename = strdup(output_filename);
+    if (file->filename == NULL) {
+        free(data_buffer);
+        return -1;
+    }
+    file->open_filename = file->filename;
+    if (extractor->output_dir_fd >= 0 &&
+        strncmp(output_filename, extractor->output_dir, extractor->output_dir_length - 1) == 0 &&
+        output_filename[extractor->output_dir_length - 1] == PYI_SEP) {
+        file->open_filename = file->filename + extractor->output_dir_length;
+    }
+    file->toc_entry = toc_entry;
+    file->data = data;
+    file->data_buffer = data_buffer;
+    file->fd = -1;
+    file->failed = 0;
+
+    extractor->num_files++;
+    if (data_buffer != NULL) {
+        extractor->buffered_size += (size_t)toc_entry->uncompressed_length;
+    }
+
+    return 0;
+}
+
+int
+pyi_io_uring_extractor_add(struct IO_URING_EXTRACTOR *extractor, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    const unsigned char *data;
+    unsigned char *data_buffer;
+
+    /* Symbolic links, large files, and non-empty stored (uncompressed)
+     * files are extracted immediately, using the regular codepath. For
+     * stored files, that codepath copies the data within the kernel
+     * (copy_file_range(), or cloning of data blocks with FICLONERANGE
+     * if the entry is aligned), instead of writing it from the memory
+     * mapping through userspace. Only the files whose data needs to be
+     * decompressed (and empty files) are batched. */
+    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK || toc_entry->uncompressed_length > IO_URING_MAX_ENTRY_SIZE ||
+        (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE && toc_entry->length > 0)) {
+        return pyi_archive_extract2fs(extractor->archive, toc_entry, output_filename);
+    }
+
+    if (_pyi_io_uring_reserve_file(extractor, toc_entry->uncompressed_length) < 0) {
+        return -1;
+    }
+
+    /* Obtain entry's data; this decompresses the data into buffer (or,
+     * for an empty stored file, borrows the pointer from the archive's
+     * memory mapping). */
+    data = pyi_archive_get_entry_data(extractor->archive, toc_entry, &data_buffer);
+    if (data == NULL) {
+        return -1;
+    }
+
+    return _pyi_io_uring_queue_file(extractor, toc_entry, output_filename, data, data_buffer);
+}
+
+int
+pyi_io_uring_extractor_add_data(struct IO_URING_EXTRACTOR *extractor, const struct TOC_ENTRY *toc_entry, const char *output_filename, unsigned char *data)
+{
+    int rc;
+
+    /* Large files are written immediately, using the regular codepath. */
+    if (toc_entry->uncompressed_length > IO_URING_MAX_ENTRY_SIZE) {
+        rc = pyi_archive_write2fs(toc_entry, data, output_filename);
+        free(data);
+        return rc;
+    }
+
+    if (_pyi_io_uring_reserve_file(extractor, toc_entry->uncompressed_length) < 0) {
+        free(data);
+        return -1;
+    }
+
+    return _pyi_io_uring_queue_file(extractor, toc_entry, output_filename, data, data);
+}
+
+int
+pyi_io_uring_extractor_sync_file(struct IO_URING_EXTRACTOR *extractor, const char *output_filename)
+{
+    int i;
+
+    for (i = 0; i < extractor->num_files; i++) {
+        if (strcmp(extractor->files[i].filename, output_filename) == 0) {
+            return pyi_io_uring_extractor_flush(extractor);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* defined(__linux__) && defined(HAVE_IO_URING) */
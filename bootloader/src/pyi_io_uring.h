@@ -0,0 +1,62 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Batched extraction of onefile archive entries using Linux io_uring.
+ *
+ * Instead of opening, writing, and closing each extracted file with
+ * separate system calls, the files are queued and processed in batches;
+ * each batch requires only a couple of io_uring_enter() calls.
+ */
+
+#ifndef PYI_IO_URING_H
+#define PYI_IO_URING_H
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+struct ARCHIVE;
+struct TOC_ENTRY;
+struct IO_URING_EXTRACTOR;
+
+/* Set up io_uring instance for extraction of files from the given
+ * archive into the given output directory; output files within that
+ * directory are opened relative to the directory's file descriptor.
+ * Returns NULL if io_uring is not available (not supported by the
+ * kernel, or disabled by system policy); in that case, the caller
+ * should use the regular extraction codepath. */
+struct IO_URING_EXTRACTOR *pyi_io_uring_extractor_new(const struct ARCHIVE *archive, const char *output_dir);
+
+/* Queue extraction of the archive entry into specified output file.
+ * Entries that are not suitable for batched extraction (symbolic links
+ * and very large files) and stored entries (which are copied within
+ * the kernel) are extracted immediately. */
+int pyi_io_uring_extractor_add(struct IO_URING_EXTRACTOR *extractor, const struct TOC_ENTRY *toc_entry, const char *output_filename);
+
+/* Queue writing of the entry's already-extracted data (for example,
+ * decompressed by a worker thread) into specified output file. The
+ * ownership of the data buffer is transferred to the extractor. */
+int pyi_io_uring_extractor_add_data(struct IO_URING_EXTRACTOR *extractor, const struct TOC_ENTRY *toc_entry, const char *output_filename, unsigned char *data);
+
+/* Complete the pending extraction of the given output file, if any. */
+int pyi_io_uring_extractor_sync_file(struct IO_URING_EXTRACTOR *extractor, const char *output_filename);
+
+/* Complete all pending extractions. */
+int pyi_io_uring_extractor_flush(struct IO_URING_EXTRACTOR *extractor);
+
+/* Tear down the io_uring instance. Pending extractions are discarded,
+ * so pyi_io_uring_extractor_flush() should be called first. */
+void pyi_io_uring_extractor_free(struct IO_URING_EXTRACTOR **extractor_ref);
+
+#endif /* defined(__linux__) && defined(HAVE_IO_URING) */
+
+#endif /* PYI_IO_URING_H */
@@ -19,8 +19,14 @@
     #include <windows.h>
 #else
     #include <stdlib.h>   /* malloc */
+    #include <stdio.h>    /* rename, snprintf */
+    #include <errno.h>
+    #include <fcntl.h>    /* fcntl, FD_CLOEXEC */
+    #include <pthread.h>
+    #include <sys/stat.h> /* mkdir */
+    #include <unistd.h>   /* close, pipe, unlink, write */
 #endif
-#include <string.h>   /* memset */
+#include <string.h>   /* memset, strlen */
 #include <stddef.h>   /* ptrdiff_t */
 
 /* PyInstaller headers. */
@@ -32,11 +38,184 @@
 #include "pyi_utils.h"
 #include "pyi_splash.h"
 #include "pyi_python.h"
+#include "pyi_prewarm.h"
 #include "pyi_pythonlib.h"
 #include "pyi_exception_dialog.h"
 #include "pyi_multipkg.h"
+#include "pyi_io_uring.h"
+#include "pyi_decompress_pool.h"
 
 
+/* Sets of extractable entries; see _pyi_launch_is_entry_selected(). */
+enum PYI_EXTRACTION_SET
+{
+    PYI_EXTRACTION_SET_ALL = 0,
+    PYI_EXTRACTION_SET_CRITICAL = 1,
+    PYI_EXTRACTION_SET_DEFERRED = 2
+};
+
+/* Name of the staging directory for deferred extraction, relative to
+ * the application's top-level directory, and the name of the manifest
+ * file within it. Both names are also used by pyimod05_deferred. */
+#define PYI_DEFERRED_STAGING_DIR ".pyi-deferred"
+#define PYI_DEFERRED_MANIFEST "manifest"
+
+/*
+ * Check whether the entry belongs to the given set. The deferred set
+ * consists of data files that are not needed to start the python
+ * interpreter: the data files from `deferrable_start` onwards (in TOC
+ * order), with exception of the base_library.zip. The critical set
+ * consists of all other extractable entries (shared libraries,
+ * extension modules, symbolic links, dependencies, and data files that
+ * are accessed during startup). If `deferrable_start` is NULL, no entry
+ * is deferred.
+ */
+static int
+_pyi_launch_is_entry_selected(const struct TOC_ENTRY *toc_entry, const struct TOC_ENTRY *deferrable_start, enum PYI_EXTRACTION_SET extraction_set)
+{
+    int is_deferred;
+
+    if (extraction_set == PYI_EXTRACTION_SET_ALL) {
+        return 1;
+    }
+
+    is_deferred = toc_entry->typecode == ARCHIVE_ITEM_DATA && deferrable_start != NULL && toc_entry >= deferrable_start && strcmp(toc_entry->name, "base_library.zip") != 0;
+    return (extraction_set == PYI_EXTRACTION_SET_DEFERRED) == is_deferred;
+}
+
+/*
+ * Return the first extractable entry of the archive that may be
+ * deferred. If the main archive was built with a startup profile, its
+ * extractable entries are ordered by their first access during startup,
+ * and the archive writer records the number of leading entries that
+ * are accessed during startup via the `pyi-startup-entries` run-time
+ * option; these are always extracted as part of the critical set. All
+ * data files of the cold archive can be deferred.
+ */
+static const struct TOC_ENTRY *
+_pyi_launch_get_deferrable_start(const struct PYI_CONTEXT *pyi_ctx, const struct ARCHIVE *archive)
+{
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    size_t startup_entry_count = (archive == pyi_ctx->archive) ? pyi_ctx->startup_entry_count : 0;
+
+    if (startup_entry_count >= extractable_entries->count) {
+        return NULL;
+    }
+    return extractable_entries->entries[startup_entry_count];
+}
+
+#if !defined(_WIN32)
+
+/* Key for identification of entries that share the same data blob. */
+struct PYI_BLOB_KEY
+{
+    const struct TOC_ENTRY *toc_entry;
+    size_t index;
+};
+
+static int
+_pyi_launch_compare_blob_keys(const void *a, const void *b)
+{
+    const struct PYI_BLOB_KEY *key_a = a;
+    const struct PYI_BLOB_KEY *key_b = b;
+
+    if (key_a->toc_entry->offset != key_b->toc_entry->offset) {
+        return key_a->toc_entry->offset < key_b->toc_entry->offset ? -1 : 1;
+    }
+    if (key_a->toc_entry->length != key_b->toc_entry->length) {
+        return key_a->toc_entry->length < key_b->toc_entry->length ? -1 : 1;
+    }
+    if (key_a->toc_entry->compression_flag != key_b->toc_entry->compression_flag) {
+        return key_a->toc_entry->compression_flag < key_b->toc_entry->compression_flag ? -1 : 1;
+    }
+    /* Keep the TOC order among entries with the same blob */
+    return key_a->index < key_b->index ? -1 : (key_a->index > key_b->index);
+}
+
+/*
+ * Find the entries whose data blob is shared with a preceding entry;
+ * the archive writer stores the identical contents only once. Returns
+ * an array that contains, for each extractable entry, the first entry
+ * with the same blob, or NULL if the entry is the first (or only) one
+ * with its blob. Returns NULL if there are no duplicated entries, or if
+ * memory could not be allocated.
+ */
+static const struct TOC_ENTRY **
+_pyi_launch_find_duplicate_entries(const struct ARCHIVE_ENTRY_LIST *extractable_entries)
+{
+    struct PYI_BLOB_KEY *keys;
+    const struct TOC_ENTRY **duplicates = NULL;
+    size_t num_keys = 0;
+    size_t i;
+    size_t run_start;
+
+    keys = calloc(extractable_entries->count, sizeof(struct PYI_BLOB_KEY));
+    if (keys == NULL) {
+        return NULL;
+    }
+
+    /* Only the files that are extracted from their data blob */
+    for (i = 0; i < extractable_entries->count; i++) {
+        const struct TOC_ENTRY *toc_entry = extractable_entries->entries[i];
+        if (toc_entry->length == 0) {
+            continue;
+        }
+        if (toc_entry->typecode == ARCHIVE_ITEM_BINARY || toc_entry->typecode == ARCHIVE_ITEM_DATA || toc_entry->typecode == ARCHIVE_ITEM_ZIPFILE) {
+            keys[num_keys].toc_entry = toc_entry;
+            keys[num_keys].index = i;
+            num_keys++;
+        }
+    }
+
+    qsort(keys, num_keys, sizeof(struct PYI_BLOB_KEY), _pyi_launch_compare_blob_keys);
+
+    for (run_start = 0, i = 1; i < num_keys; i++) {
+        const struct TOC_ENTRY *first_entry = keys[run_start].toc_entry;
+        if (first_entry->offset != keys[i].toc_entry->offset || first_entry->length != keys[i].toc_entry->length || first_entry->compression_flag != keys[i].toc_entry->compression_flag) {
+            run_start = i;
+            continue;
+        }
+        if (duplicates == NULL) {
+            duplicates = calloc(extractable_entries->count, sizeof(const struct TOC_ENTRY *));
+            if (duplicates == NULL) {
+                break;
+            }
+        }
+        duplicates[keys[i].index] = keys[run_start].toc_entry;
+    }
+
+    free(keys);
+    return duplicates;
+}
+
+/*
+ * Return the first entry with the same data blob as the entry with the
+ * given index, if that entry's file is already extracted when the
+ * given set is being extracted: if it belongs to the same set (and thus
+ * precedes the entry in extraction order), or to the critical set, which
+ * is extracted before the deferred one. Otherwise, return NULL.
+ */
+static const struct TOC_ENTRY *
+_pyi_launch_get_link_source(const struct TOC_ENTRY **duplicates, size_t index, const struct TOC_ENTRY *deferrable_start, enum PYI_EXTRACTION_SET extraction_set)
+{
+    const struct TOC_ENTRY *source_entry;
+
+    if (duplicates == NULL || duplicates[index] == NULL) {
+        return NULL;
+    }
+    source_entry = duplicates[index];
+
+    if (_pyi_launch_is_entry_selected(source_entry, deferrable_start, extraction_set)) {
+        return source_entry;
+    }
+    if (extraction_set == PYI_EXTRACTION_SET_DEFERRED && _pyi_launch_is_entry_selected(source_entry, deferrable_start, PYI_EXTRACTION_SET_CRITICAL)) {
+        return source_entry;
+    }
+    return NULL;
+}
+
+#endif /* !defined(_WIN32) */
+
 /*
  * Extract all binaries (type 'b') and all data files (type 'x') to the filesystem
  * and checks for dependencies (type 'd'). If dependencies are found, extract them.
@@ -47,15 +226,35 @@
  *
  * If 'splash screen' feature is enabled, the text on splash screen will be updated
  * during the extraction with the name of currently processed TOC entry.
+ *
+ * The entries are extracted either from the main archive or from the
+ * cold archive. Only the entries of the given set are extracted. Entries
+ * of the deferred set are extracted into the staging directory, and
+ * moved into their place once complete, so that they appear atomically
+ * to the already running child process.
+ *
+ * Entries that share the data blob with an already-extracted entry are
+ * (on POSIX systems) created as reflinks or hard links to the existing
+ * file, instead of extracting the same data again.
  */
-int
-pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
+static int
+_pyi_launch_extract_files(struct PYI_CONTEXT *pyi_ctx, const struct ARCHIVE *archive, enum PYI_EXTRACTION_SET extraction_set)
 {
-    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    const struct TOC_ENTRY *deferrable_start = _pyi_launch_get_deferrable_start(pyi_ctx, archive);
     const struct TOC_ENTRY *toc_entry;
+    size_t i;
     ptrdiff_t index;
     int retcode = 0;
     char output_filename[PYI_PATH_MAX];
+#if !defined(_WIN32)
+    bool use_staging_dir;
+    char final_filename[PYI_PATH_MAX];
+    char source_filename[PYI_PATH_MAX];
+    const struct TOC_ENTRY **duplicates;
+    const struct TOC_ENTRY *link_source;
+#endif
+    bool linked;
 
     struct ARCHIVE *multipkg_archive_pool[PYI_MULTIPKG_ARCHIVE_POOL_SIZE];
     char multipkg_ref[PYI_PATH_MAX];
@@ -63,11 +262,113 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
 
     const char *entry_filename;
 
+    struct DECOMPRESS_POOL *decompress_pool = NULL;
+    unsigned int num_workers;
+    size_t next_submitted_index = 0;
+
+    bool directory_tree_created = false;
+
+    /* If the archive provides the directory table, create the whole
+     * directory tree up front, so that the parent directories of the
+     * extracted files do not need to be checked one by one. In case of
+     * deferred extraction from the main archive, the tree was already
+     * created together with the critical set. */
+    if (archive->toc_directory_table != NULL && extraction_set == PYI_EXTRACTION_SET_DEFERRED && archive == pyi_ctx->archive) {
+        directory_tree_created = true;
+    } else if (archive->toc_directory_table != NULL) {
+        char *directory_table = (char *)pyi_archive_extract(archive, archive->toc_directory_table);
+        if (directory_table == NULL) {
+            return -1;
+        }
+        if (pyi_create_directory_table(pyi_ctx, pyi_ctx->application_home_dir, directory_table, (size_t)archive->toc_directory_table->uncompressed_length) < 0) {
+            PYI_ERROR("Failed to create directory structure.\n");
+            free(directory_table);
+            return -1;
+        }
+        free(directory_table);
+        directory_tree_created = true;
+        PYI_DEBUG("LOADER: created directory tree from the archive's directory table.\n");
+    }
+
+#if !defined(_WIN32)
+    duplicates = _pyi_launch_find_duplicate_entries(extractable_entries);
+
+    /* The staging directory is used only while the deferred set is
+     * extracted by the background thread, concurrently with the running
+     * child process. If the deferred set is extracted synchronously (the
+     * fallback in pyi_launch_start_deferred_extraction()), the files are
+     * extracted straight into their final place. */
+    use_staging_dir = extraction_set == PYI_EXTRACTION_SET_DEFERRED && pyi_ctx->deferred_extraction_active;
+#endif
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+    struct IO_URING_EXTRACTOR *io_uring_extractor = NULL;
+
+    /* Use batched extraction via io_uring, if available and not
+     * disabled. Otherwise, files are extracted one by one. Extraction
+     * via the staging directory moves each file into place as soon as
+     * it is written, and therefore does not use batched extraction. */
+    if (!pyi_ctx->disable_io_uring && !use_staging_dir) {
+        io_uring_extractor = pyi_io_uring_extractor_new(archive, pyi_ctx->application_home_dir);
+        if (io_uring_extractor != NULL) {
+            PYI_DEBUG("LOADER: using io_uring for extraction of files.\n");
+        }
+    }
+#endif
+
+    /* Decompress entries in worker threads, unless the number of worker
+     * threads is explicitly set to 1 (or the default number of worker
+     * threads is 1 due to single available CPU). */
+    num_workers = pyi_ctx->extraction_workers;
+    if (num_workers == 0) {
+        num_workers = pyi_decompress_pool_get_default_worker_count();
+    }
+    if (num_workers > 1) {
+        decompress_pool = pyi_decompress_pool_new(archive, num_workers);
+    }
+
     /* Clear the archive pool array. */
     memset(multipkg_archive_pool, 0, sizeof(multipkg_archive_pool));
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        /* Check if entry is extractable */
+    for (i = 0; i < extractable_entries->count; i++) {
+        toc_entry = extractable_entries->entries[i];
+
+        if (!_pyi_launch_is_entry_selected(toc_entry, deferrable_start, extraction_set)) {
+            continue;
+        }
+
+#if !defined(_WIN32)
+        /* Stop the deferred extraction if the child process has exited */
+        if (__atomic_load_n(&pyi_ctx->deferred_extraction_cancelled, __ATOMIC_RELAXED)) {
+            PYI_DEBUG("LOADER: deferred extraction cancelled.\n");
+            break;
+        }
+#endif
+
+        /* Keep the worker threads busy by submitting entries ahead of
+         * the currently-processed one, as far as the pool's limits allow.
+         * The output files are still created and written here, in order. */
+        if (decompress_pool != NULL) {
+            while (next_submitted_index < extractable_entries->count) {
+                if (!_pyi_launch_is_entry_selected(extractable_entries->entries[next_submitted_index], deferrable_start, extraction_set)) {
+                    next_submitted_index++;
+                    continue;
+                }
+#if !defined(_WIN32)
+                /* Duplicated entries are linked rather than decompressed */
+                if (_pyi_launch_get_link_source(duplicates, next_submitted_index, deferrable_start, extraction_set) != NULL) {
+                    next_submitted_index++;
+                    continue;
+                }
+#endif
+                if (pyi_decompress_pool_submit(decompress_pool, extractable_entries->entries[next_submitted_index]) < 0) {
+                    break; /* Pool is full */
+                }
+                next_submitted_index++;
+            }
+        }
+
+        /* Determine output filename */
         switch (toc_entry->typecode) {
             /* Onefile mode */
             case ARCHIVE_ITEM_BINARY:
@@ -110,6 +411,15 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
             break;
         }
 
+#if defined(__linux__) && defined(HAVE_IO_URING)
+        /* If extraction of a file with the same name is still pending
+         * (duplicated entry), complete it first. */
+        if (io_uring_extractor != NULL && pyi_io_uring_extractor_sync_file(io_uring_extractor, output_filename) < 0) {
+            retcode = -1;
+            break;
+        }
+#endif
+
         /* Check if file already exists (it should not) */
         if (pyi_path_exists(output_filename) == 1) {
             /* Check if file was a splash screen requirement */
@@ -117,6 +427,9 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
                 /* This is splash requirement, so it is expected to exist.
                  * Also, the file should be in use right now, so avoid
                  * overwriting it. */
+                if (decompress_pool != NULL && pyi_decompress_pool_is_pending(decompress_pool, toc_entry)) {
+                    free(pyi_decompress_pool_take(decompress_pool));
+                }
                 continue;
             } else if (pyi_ctx->strict_unpack_mode) {
                 PYI_ERROR("File already exists but should not: %s\n", output_filename);
@@ -127,15 +440,57 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
             }
         }
 
-        /* Create parent directory tree */
-        if (pyi_create_parent_directory_tree(pyi_ctx, pyi_ctx->application_home_dir, entry_filename) < 0) {
+        /* Create parent directory tree, unless already created from the
+         * archive's directory table */
+        if (!directory_tree_created && pyi_create_parent_directory_tree(pyi_ctx, pyi_ctx->application_home_dir, entry_filename) < 0) {
             PYI_ERROR("Failed to create parent directory structure.\n");
             retcode = -1;
             break;
         }
 
+        /* Extract deferred entries into the staging directory; the
+         * file is moved into place once it is completely written. */
+#if !defined(_WIN32)
+        if (use_staging_dir) {
+            snprintf(final_filename, PYI_PATH_MAX, "%s", output_filename);
+            if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s%c%s%lu", pyi_ctx->application_home_dir, PYI_SEP, PYI_DEFERRED_STAGING_DIR, PYI_SEP, (archive == pyi_ctx->archive) ? "" : "cold-", (unsigned long)i) >= PYI_PATH_MAX) {
+                PYI_ERROR("Extraction path length exceeds maximum path length!\n");
+                retcode = -1;
+                break;
+            }
+        }
+#endif
+
+        /* If the entry's data is shared with an already-extracted entry,
+         * try linking the file instead of extracting the data again. Hard
+         * links are used only between entries of the same type, as they
+         * share the permissions. */
+        linked = false;
+#if !defined(_WIN32)
+        link_source = _pyi_launch_get_link_source(duplicates, i, deferrable_start, extraction_set);
+        if (link_source != NULL && snprintf(source_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, link_source->name) >= PYI_PATH_MAX) {
+            link_source = NULL;
+        }
+#if defined(__linux__) && defined(HAVE_IO_URING)
+        /* The source file might still be pending in the batch */
+        if (link_source != NULL && io_uring_extractor != NULL && pyi_io_uring_extractor_sync_file(io_uring_extractor, source_filename) < 0) {
+            retcode = -1;
+            break;
+        }
+#endif
+        if (link_source != NULL && pyi_link_file(source_filename, output_filename, link_source->typecode == toc_entry->typecode) == 0) {
+            PYI_DEBUG("LOADER: linked %s to duplicated entry %s.\n", toc_entry->name, link_source->name);
+            if (link_source->typecode != toc_entry->typecode) {
+                chmod(output_filename, (toc_entry->typecode == ARCHIVE_ITEM_BINARY) ? (S_IRUSR | S_IWUSR | S_IXUSR) : (S_IRUSR | S_IWUSR));
+            }
+            linked = true;
+        }
+#endif
+
         /* Extract */
-        if (toc_entry->typecode == ARCHIVE_ITEM_DEPENDENCY) {
+        if (linked) {
+            /* Nothing to do */
+        } else if (toc_entry->typecode == ARCHIVE_ITEM_DEPENDENCY) {
             retcode = pyi_multipkg_extract_dependency(
                 pyi_ctx,
                 multipkg_archive_pool,
@@ -143,6 +498,32 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
                 multipkg_name,
                 output_filename
             );
+        } else if (decompress_pool != NULL && pyi_decompress_pool_is_pending(decompress_pool, toc_entry)) {
+            unsigned char *data = pyi_decompress_pool_take(decompress_pool);
+            if (data == NULL) {
+                /* Decompression failed; retry using the regular codepath,
+                 * which also reports the error. */
+                retcode = pyi_archive_extract2fs(archive, toc_entry, output_filename);
+#if defined(__linux__) && defined(HAVE_IO_URING)
+            } else if (io_uring_extractor != NULL) {
+                retcode = pyi_io_uring_extractor_add_data(io_uring_extractor, toc_entry, output_filename, data);
+#endif
+            } else {
+                retcode = pyi_archive_write2fs(toc_entry, data, output_filename);
+                free(data);
+            }
+        } else if (decompress_pool != NULL && toc_entry->compression_flag == ARCHIVE_COMPRESSION_ZLIB_BLOCKS) {
+            /* Decompress the blocks of the (large) entry in parallel; if
+             * that fails, retry using the regular codepath, which also
+             * reports the error. */
+            retcode = pyi_decompress_pool_extract_blocks(decompress_pool, toc_entry, output_filename);
+            if (retcode != 0) {
+                retcode = pyi_archive_extract2fs(archive, toc_entry, output_filename);
+            }
+#if defined(__linux__) && defined(HAVE_IO_URING)
+        } else if (io_uring_extractor != NULL) {
+            retcode = pyi_io_uring_extractor_add(io_uring_extractor, toc_entry, output_filename);
+#endif
         } else {
             retcode = pyi_archive_extract2fs(archive, toc_entry, output_filename);
         }
@@ -152,8 +533,42 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
             PYI_ERROR("Failed to extract entry: %s.\n", toc_entry->name);
             break;
         }
+
+#if !defined(_WIN32)
+        if (use_staging_dir) {
+            if (rename(output_filename, final_filename) < 0) {
+                PYI_PERROR("rename", "Failed to move extracted entry %s into place!\n", toc_entry->name);
+                retcode = -1;
+                break;
+            }
+            /* Wake up the child process, if it is waiting for a file. The
+             * write end of the pipe is non-blocking; if the pipe is full,
+             * the child has not consumed the previous notifications yet,
+             * so there is no need for another one. */
+            if (write(pyi_ctx->deferred_extraction_pipe[1], "", 1) < 0) {
+                /* Ignored */
+            }
+        }
+#endif
     }
 
+#if defined(__linux__) && defined(HAVE_IO_URING)
+    /* Complete pending extractions */
+    if (io_uring_extractor != NULL) {
+        if (retcode == 0) {
+            retcode = pyi_io_uring_extractor_flush(io_uring_extractor);
+        }
+        pyi_io_uring_extractor_free(&io_uring_extractor);
+    }
+#endif
+
+    /* Stop worker threads */
+    pyi_decompress_pool_free(&decompress_pool);
+
+#if !defined(_WIN32)
+    free(duplicates);
+#endif
+
     /* Free memory allocated for archive pool. */
     for (index = 0; multipkg_archive_pool[index] != NULL; index++) {
         pyi_archive_free(&multipkg_archive_pool[index]);
@@ -162,6 +577,259 @@ pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
     return retcode;
 }
 
+/*
+ * Extract the entries of the given set from the cold archive, if the
+ * application has one and it contains data files. The cold archive is
+ * opened only for the duration of the extraction.
+ */
+static int
+_pyi_launch_extract_cold_files(struct PYI_CONTEXT *pyi_ctx, enum PYI_EXTRACTION_SET extraction_set)
+{
+    struct ARCHIVE *cold_archive;
+    int retcode;
+
+    if (pyi_ctx->cold_archive_filename[0] == 0 || !pyi_ctx->cold_archive_has_files) {
+        return 0;
+    }
+
+    PYI_DEBUG("LOADER: opening cold PKG archive (%s)...\n", pyi_ctx->cold_archive_filename);
+    cold_archive = pyi_archive_open(pyi_ctx->cold_archive_filename);
+    if (cold_archive == NULL) {
+        PYI_ERROR("Could not load PyInstaller's cold PKG archive from external file (%s)\n", pyi_ctx->cold_archive_filename);
+        return -1;
+    }
+
+    retcode = _pyi_launch_extract_files(pyi_ctx, cold_archive, extraction_set);
+
+    pyi_archive_free(&cold_archive);
+    return retcode;
+}
+
+int
+pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
+{
+#if !defined(_WIN32)
+    /* With deferred extraction, the entries of the cold archive are
+     * extracted together with the deferred set of the main archive. */
+    if (pyi_ctx->deferred_extraction_active) {
+        return _pyi_launch_extract_files(pyi_ctx, pyi_ctx->archive, PYI_EXTRACTION_SET_CRITICAL);
+    }
+#endif
+    if (_pyi_launch_extract_files(pyi_ctx, pyi_ctx->archive, PYI_EXTRACTION_SET_ALL) < 0) {
+        return -1;
+    }
+    return _pyi_launch_extract_cold_files(pyi_ctx, PYI_EXTRACTION_SET_ALL);
+}
+
+
+/**********************************************************************\
+ *                 Deferred extraction (POSIX only)                   *
+\**********************************************************************/
+#if !defined(_WIN32)
+
+/*
+ * Write the names of the entries of the deferred set of the given
+ * archive into the manifest file, each terminated by a NUL character.
+ */
+static int
+_pyi_launch_write_manifest_entries(const struct PYI_CONTEXT *pyi_ctx, const struct ARCHIVE *archive, FILE *manifest)
+{
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    const struct TOC_ENTRY *deferrable_start = _pyi_launch_get_deferrable_start(pyi_ctx, archive);
+    size_t i;
+
+    for (i = 0; i < extractable_entries->count; i++) {
+        const struct TOC_ENTRY *toc_entry = extractable_entries->entries[i];
+        if (!_pyi_launch_is_entry_selected(toc_entry, deferrable_start, PYI_EXTRACTION_SET_DEFERRED)) {
+            continue;
+        }
+        if (fwrite(toc_entry->name, strlen(toc_entry->name) + 1, 1, manifest) != 1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Write the manifest of the deferred set (the entries of the main
+ * archive, followed by the entries of the cold archive) into the
+ * staging directory. The child process reads the manifest at startup,
+ * so that it waits only for accesses to files that are yet to be
+ * extracted.
+ */
+static int
+_pyi_launch_write_deferred_manifest(const struct PYI_CONTEXT *pyi_ctx, const char *staging_dir)
+{
+    char manifest_filename[PYI_PATH_MAX];
+    struct ARCHIVE *cold_archive;
+    FILE *manifest;
+    int retcode;
+
+    if (snprintf(manifest_filename, PYI_PATH_MAX, "%s%c%s", staging_dir, PYI_SEP, PYI_DEFERRED_MANIFEST) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    manifest = pyi_path_fopen(manifest_filename, "wb");
+    if (manifest == NULL) {
+        return -1;
+    }
+
+    retcode = _pyi_launch_write_manifest_entries(pyi_ctx, pyi_ctx->archive, manifest);
+
+    if (retcode == 0 && pyi_ctx->cold_archive_filename[0] != 0 && pyi_ctx->cold_archive_has_files) {
+        cold_archive = pyi_archive_open(pyi_ctx->cold_archive_filename);
+        if (cold_archive == NULL) {
+            retcode = -1;
+        } else {
+            retcode = _pyi_launch_write_manifest_entries(pyi_ctx, cold_archive, manifest);
+            pyi_archive_free(&cold_archive);
+        }
+    }
+
+    if (fclose(manifest) != 0) {
+        retcode = -1;
+    }
+    if (retcode < 0) {
+        unlink(manifest_filename);
+    }
+    return retcode;
+}
+
+/*
+ * Remove the manifest and the (otherwise empty) staging directory.
+ */
+static void
+_pyi_launch_remove_staging_dir(const struct PYI_CONTEXT *pyi_ctx)
+{
+    char path[PYI_PATH_MAX];
+
+    if (snprintf(path, PYI_PATH_MAX, "%s%c%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, PYI_DEFERRED_STAGING_DIR, PYI_SEP, PYI_DEFERRED_MANIFEST) < PYI_PATH_MAX) {
+        unlink(path);
+    }
+    if (snprintf(path, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, PYI_DEFERRED_STAGING_DIR) < PYI_PATH_MAX) {
+        rmdir(path);
+    }
+}
+
+/*
+ * Extract the deferred set of the main archive, followed by the entries
+ * of the cold archive (which contains only data files).
+ */
+static int
+_pyi_launch_extract_deferred_files(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (_pyi_launch_extract_files(pyi_ctx, pyi_ctx->archive, PYI_EXTRACTION_SET_DEFERRED) < 0) {
+        return -1;
+    }
+    if (__atomic_load_n(&pyi_ctx->deferred_extraction_cancelled, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return _pyi_launch_extract_cold_files(pyi_ctx, PYI_EXTRACTION_SET_DEFERRED);
+}
+
+static void *
+_pyi_launch_deferred_extraction_thread(void *arg)
+{
+    struct PYI_CONTEXT *pyi_ctx = arg;
+
+    pyi_ctx->deferred_extraction_status = _pyi_launch_extract_deferred_files(pyi_ctx);
+    PYI_DEBUG("LOADER: deferred extraction finished (status: %d).\n", pyi_ctx->deferred_extraction_status);
+
+    /* Remove the manifest and the (now empty) staging directory */
+    _pyi_launch_remove_staging_dir(pyi_ctx);
+
+    /* Signal completion to the child process */
+    close(pyi_ctx->deferred_extraction_pipe[1]);
+    pyi_ctx->deferred_extraction_pipe[1] = -1;
+
+    return NULL;
+}
+
+int
+pyi_launch_start_deferred_extraction(struct PYI_CONTEXT *pyi_ctx)
+{
+    char staging_dir[PYI_PATH_MAX];
+    bool staging_dir_created = false;
+    char fd_str[16];
+
+    pyi_ctx->deferred_extraction_pipe[0] = -1;
+    pyi_ctx->deferred_extraction_pipe[1] = -1;
+
+    if (snprintf(staging_dir, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, PYI_DEFERRED_STAGING_DIR) >= PYI_PATH_MAX) {
+        goto fallback;
+    }
+    if (mkdir(staging_dir, 0700) < 0) {
+        PYI_DEBUG("LOADER: failed to create staging directory for deferred extraction: %s\n", strerror(errno));
+        goto fallback;
+    }
+    staging_dir_created = true;
+
+    if (_pyi_launch_write_deferred_manifest(pyi_ctx, staging_dir) < 0) {
+        PYI_DEBUG("LOADER: failed to write manifest for deferred extraction!\n");
+        goto fallback;
+    }
+
+    /* The read end is inherited by the child process, while the write
+     * end is held only by this process. */
+    if (pipe(pyi_ctx->deferred_extraction_pipe) < 0) {
+        PYI_DEBUG("LOADER: failed to create pipe for deferred extraction: %s\n", strerror(errno));
+        goto fallback;
+    }
+    fcntl(pyi_ctx->deferred_extraction_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(pyi_ctx->deferred_extraction_pipe[1], F_SETFL, O_NONBLOCK);
+
+    /* Set the environment variable before the thread is started, as
+     * modification of the environment is not thread-safe. */
+    snprintf(fd_str, sizeof(fd_str), "%d", pyi_ctx->deferred_extraction_pipe[0]);
+    pyi_setenv("_PYI_EXTRACTION_PIPE", fd_str);
+
+    __atomic_store_n(&pyi_ctx->deferred_extraction_cancelled, 0, __ATOMIC_RELAXED);
+    if (pthread_create(&pyi_ctx->deferred_extraction_thread, NULL, _pyi_launch_deferred_extraction_thread, pyi_ctx) != 0) {
+        PYI_DEBUG("LOADER: failed to start deferred extraction thread!\n");
+        pyi_unsetenv("_PYI_EXTRACTION_PIPE");
+        goto fallback;
+    }
+
+    return 0;
+
+fallback:
+    /* Extract the deferred set here, before the child is started */
+    if (pyi_ctx->deferred_extraction_pipe[0] >= 0) {
+        close(pyi_ctx->deferred_extraction_pipe[0]);
+        close(pyi_ctx->deferred_extraction_pipe[1]);
+        pyi_ctx->deferred_extraction_pipe[0] = -1;
+        pyi_ctx->deferred_extraction_pipe[1] = -1;
+    }
+    pyi_ctx->deferred_extraction_active = 0;
+    if (staging_dir_created) {
+        _pyi_launch_remove_staging_dir(pyi_ctx);
+    }
+
+    /* With deferred extraction inactive, the files are extracted into
+     * their final place, without going through the staging directory. */
+    return _pyi_launch_extract_deferred_files(pyi_ctx);
+}
+
+int
+pyi_launch_finish_deferred_extraction(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (!pyi_ctx->deferred_extraction_active) {
+        return 0;
+    }
+
+    /* The child process has exited; there is no need to extract the
+     * remaining files. */
+    __atomic_store_n(&pyi_ctx->deferred_extraction_cancelled, 1, __ATOMIC_RELAXED);
+    pthread_join(pyi_ctx->deferred_extraction_thread, NULL);
+    pyi_ctx->deferred_extraction_active = 0;
+
+    close(pyi_ctx->deferred_extraction_pipe[0]);
+    pyi_ctx->deferred_extraction_pipe[0] = -1;
+
+    return pyi_ctx->deferred_extraction_status;
+}
+
+#endif /* !defined(_WIN32) */
+
 
 /* These helper functions are used only in windowed bootloader variants. */
 #if defined(WINDOWED)
@@ -278,9 +946,12 @@ static int
 _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
 {
     const struct ARCHIVE *archive = pyi_ctx->archive;
-    unsigned char *data;
+    const struct ARCHIVE_ENTRY_LIST *script_entries = &archive->entry_groups[ARCHIVE_GROUP_PYSOURCE];
+    const unsigned char *data;
+    unsigned char *data_buffer;
     char buf[PYI_PATH_MAX];
     const struct TOC_ENTRY *toc_entry;
+    size_t i;
     PyObject *__main__;
     PyObject *__file__;
     PyObject *main_dict;
@@ -300,14 +971,12 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
         return -1;
     }
 
-    /* Iterate through toc looking for scripts (type 's') */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_PYSOURCE) {
-            continue;
-        }
+    /* Iterate through scripts (type 's') */
+    for (i = 0; i < script_entries->count; i++) {
+        toc_entry = script_entries->entries[i];
 
         /* Get data out of the archive.  */
-        data = pyi_archive_extract(archive, toc_entry);
+        data = pyi_archive_get_entry_data(archive, toc_entry, &data_buffer);
         if (data == NULL) {
             PYI_ERROR("Failed to extract script from archive!\n");
             return -1;
@@ -317,6 +986,7 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
          * full compatibility with normal execution. */
         if (snprintf(buf, PYI_PATH_MAX, "%s%c%s.py", pyi_ctx->application_home_dir, PYI_SEP, toc_entry->name) >= PYI_PATH_MAX) {
             PYI_ERROR("Absolute path to script exceeds PYI_PATH_MAX\n");
+            free(data_buffer);
             return -1;
         }
 
@@ -328,7 +998,7 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
 
         /* Unmarshall code object */
         code = PI_PyMarshal_ReadObjectFromString((const char *)data, toc_entry->uncompressed_length);
-        free(data);
+        free(data_buffer);
         if (!code) {
             PYI_ERROR("Failed to unmarshal code object for %s\n", toc_entry->name);
             PI_PyErr_Print();
@@ -434,6 +1104,13 @@ pyi_launch_execute(struct PYI_CONTEXT *pyi_ctx)
 {
     int rc = 0;
 
+#if !defined(_WIN32)
+    /* Start reading the python shared library and the early-imported
+     * extension modules into the page cache, while the interpreter is
+     * being loaded and initialized. */
+    pyi_prewarm_start(pyi_ctx);
+#endif
+
     /* Load Python shared library and import symbols from it */
     if (pyi_pylib_load(pyi_ctx)) {
         return -1;
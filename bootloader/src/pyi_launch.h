@@ -24,6 +24,31 @@ struct PYI_CONTEXT;
  */
 int pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx);
 
+/*
+ * Deferred extraction (onefile mode, POSIX only). If deferred extraction
+ * is active, pyi_launch_extract_files_from_archive() extracts only the
+ * startup-critical files (all extractable entries except for data files,
+ * with exception of base_library.zip), and the remaining data files are
+ * extracted in a background thread, started by
+ * pyi_launch_start_deferred_extraction(). The deferred files are moved
+ * into place only once completely written. The names of the deferred
+ * files are listed in a manifest in the staging directory, and the child
+ * process is notified via a pipe, whose read end is passed in
+ * _PYI_EXTRACTION_PIPE environment variable: a byte is written into the
+ * pipe whenever a file is moved into place, and the write end is closed
+ * once the extraction is complete. If the manifest cannot be written or
+ * the thread cannot be started, the deferred files are extracted by the
+ * calling thread.
+ *
+ * pyi_launch_finish_deferred_extraction() stops the extraction (if it
+ * is still running) and waits for the thread to finish. Both functions
+ * return 0 on success, and -1 on failure.
+ */
+#if !defined(_WIN32)
+int pyi_launch_start_deferred_extraction(struct PYI_CONTEXT *pyi_ctx);
+int pyi_launch_finish_deferred_extraction(struct PYI_CONTEXT *pyi_ctx);
+#endif
+
 /*
  * Wrapped platform specific initialization before loading Python and executing
  * all scripts in the archive.
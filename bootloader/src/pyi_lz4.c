@@ -0,0 +1,283 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Decoder for LZ4-compressed archive entries.
+ *
+ * The entries are stored in the LZ4 frame format, as produced by the
+ * lz4 command-line tool and python's lz4.frame module:
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ *
+ * The block and content checksums are skipped, but not verified; the
+ * integrity of archive's data is the responsibility of the archive
+ * format itself.
+ */
+
+#include <string.h>  /* memcpy */
+
+/* PyInstaller headers. */
+#include "pyi_lz4.h"
+
+
+#define LZ4_FRAME_MAGIC 0x184D2204U
+
+/* Frame descriptor flags (FLG byte) */
+#define LZ4_FLG_VERSION_MASK 0xC0
+#define LZ4_FLG_VERSION_01 0x40
+#define LZ4_FLG_BLOCK_INDEPENDENCE 0x20
+#define LZ4_FLG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLG_CONTENT_SIZE 0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_RESERVED 0x02
+#define LZ4_FLG_DICT_ID 0x01
+
+/* Block size word; the highest bit marks uncompressed block */
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000U
+
+/* Minimum length of a match */
+#define LZ4_MIN_MATCH 4
+
+
+static unsigned int
+_pyi_lz4_read_le32(const unsigned char *ptr)
+{
+    return (unsigned int)ptr[0] | ((unsigned int)ptr[1] << 8) | ((unsigned int)ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+}
+
+/*
+ * Read the variable-length extension of literal or match length; the
+ * value is extended by bytes until one that is not 255 is encountered.
+ */
+static int
+_pyi_lz4_read_length(const unsigned char **ip_ref, const unsigned char *iend, size_t *length)
+{
+    const unsigned char *ip = *ip_ref;
+    unsigned char value;
+
+    do {
+        if (ip >= iend) {
+            return -1;
+        }
+        value = *ip++;
+        *length += value;
+    } while (value == 255);
+
+    *ip_ref = ip;
+    return 0;
+}
+
+/*
+ * Decode a single LZ4 block into the output buffer, at the given
+ * position, and store the length of decoded data into *block_length.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_lz4_decode_block(const unsigned char *src, size_t src_length, unsigned char *dst, size_t dst_position, size_t dst_length, size_t *block_length)
+{
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + src_length;
+    unsigned char *op = dst + dst_position;
+    unsigned char *oend = dst + dst_length;
+
+    while (ip < iend) {
+        unsigned int token = *ip++;
+        size_t literal_length = token >> 4;
+        size_t match_length = token & 0x0F;
+        size_t offset;
+        const unsigned char *match;
+
+        /* Literals */
+        if (literal_length == 15 && _pyi_lz4_read_length(&ip, iend, &literal_length) < 0) {
+            return -1;
+        }
+        if (literal_length > (size_t)(iend - ip) || literal_length > (size_t)(oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        /* The last sequence of the block contains only literals */
+        if (ip == iend) {
+            break;
+        }
+
+        /* Match */
+        if (iend - ip < 2) {
+            return -1;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return -1;
+        }
+
+        if (match_length == 15 && _pyi_lz4_read_length(&ip, iend, &match_length) < 0) {
+            return -1;
+        }
+        match_length += LZ4_MIN_MATCH;
+        if (match_length > (size_t)(oend - op)) {
+            return -1;
+        }
+
+        match = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            /* Overlapping match (repeated pattern); copy byte by byte */
+            while (match_length-- > 0) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    *block_length = (size_t)(op - (dst + dst_position));
+    return 0;
+}
+
+int
+pyi_lz4_frame_open(struct PYI_LZ4_FRAME_READER *reader, const unsigned char *src, size_t src_length)
+{
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + src_length;
+    unsigned int flags;
+    unsigned int block_size_id;
+
+    memset(reader, 0, sizeof(struct PYI_LZ4_FRAME_READER));
+
+    /* Magic, FLG and BD bytes */
+    if (src_length < 7 || _pyi_lz4_read_le32(ip) != LZ4_FRAME_MAGIC) {
+        return -1;
+    }
+    ip += 4;
+
+    flags = *ip++;
+    if ((flags & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION_01 || (flags & LZ4_FLG_RESERVED)) {
+        return -1;
+    }
+    /* Dictionaries are not supported */
+    if (flags & LZ4_FLG_DICT_ID) {
+        return -1;
+    }
+
+    block_size_id = (*ip++ >> 4) & 0x07;
+    if (block_size_id < 4) {
+        return -1;
+    }
+    reader->block_max_size = (size_t)1 << (8 + 2 * block_size_id); /* 64 KiB, 256 KiB, 1 MiB, 4 MiB */
+
+    /* Optional content size (ignored), and header checksum byte */
+    if (flags & LZ4_FLG_CONTENT_SIZE) {
+        ip += 8;
+    }
+    ip += 1;
+    if (ip > iend) {
+        return -1;
+    }
+
+    reader->ptr = ip;
+    reader->end = iend;
+    reader->independent_blocks = (flags & LZ4_FLG_BLOCK_INDEPENDENCE) != 0;
+    reader->block_checksums = (flags & LZ4_FLG_BLOCK_CHECKSUM) != 0;
+    reader->content_checksum = (flags & LZ4_FLG_CONTENT_CHECKSUM) != 0;
+
+    return 0;
+}
+
+int
+pyi_lz4_frame_read_block(struct PYI_LZ4_FRAME_READER *reader, unsigned char *dst, size_t dst_position, size_t dst_length, size_t *block_length)
+{
+    const unsigned char *ip = reader->ptr;
+    unsigned int block_size;
+    size_t data_length;
+
+    *block_length = 0;
+
+    if (reader->finished) {
+        return 0;
+    }
+
+    if (reader->end - ip < 4) {
+        return -1;
+    }
+    block_size = _pyi_lz4_read_le32(ip);
+    ip += 4;
+
+    /* End mark; followed by optional content checksum */
+    if (block_size == 0) {
+        if (reader->content_checksum) {
+            ip += 4;
+        }
+        if (ip > reader->end) {
+            return -1;
+        }
+        reader->ptr = ip;
+        reader->finished = 1;
+        return 0;
+    }
+
+    data_length = block_size & ~LZ4_BLOCK_UNCOMPRESSED;
+    if (data_length > reader->block_max_size || data_length > (size_t)(reader->end - ip)) {
+        return -1;
+    }
+
+    if (block_size & LZ4_BLOCK_UNCOMPRESSED) {
+        if (data_length > dst_length - dst_position) {
+            return -1;
+        }
+        memcpy(dst + dst_position, ip, data_length);
+        *block_length = data_length;
+    } else {
+        if (_pyi_lz4_decode_block(ip, data_length, dst, dst_position, dst_length, block_length) < 0) {
+            return -1;
+        }
+    }
+    ip += data_length;
+
+    /* Optional block checksum */
+    if (reader->block_checksums) {
+        ip += 4;
+        if (ip > reader->end) {
+            return -1;
+        }
+    }
+
+    reader->ptr = ip;
+    return 1;
+}
+
+int
+pyi_lz4_decompress(const unsigned char *src, size_t src_length, unsigned char *dst, size_t dst_length)
+{
+    struct PYI_LZ4_FRAME_READER reader;
+    size_t position = 0;
+    size_t block_length;
+    int rc;
+
+    if (pyi_lz4_frame_open(&reader, src, src_length) < 0) {
+        return -1;
+    }
+
+    /* Decode blocks one after another into the output buffer; as they
+     * are placed contiguously, matches in linked blocks can refer to
+     * data of the preceding blocks. */
+    while ((rc = pyi_lz4_frame_read_block(&reader, dst, position, dst_length, &block_length)) > 0) {
+        position += block_length;
+    }
+    if (rc < 0 || position != dst_length) {
+        return -1;
+    }
+
+    return 0;
+}
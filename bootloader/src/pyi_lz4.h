@@ -0,0 +1,52 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Decoder for LZ4-compressed archive entries (LZ4 frame format).
+ */
+
+#ifndef PYI_LZ4_H
+#define PYI_LZ4_H
+
+#include <stddef.h>  /* size_t */
+
+/* State of the LZ4 frame reader. */
+struct PYI_LZ4_FRAME_READER
+{
+    const unsigned char *ptr; /* current position in the frame */
+    const unsigned char *end; /* end of the frame */
+
+    size_t block_max_size; /* maximum size of a decoded block */
+    int independent_blocks; /* blocks can be decoded independently of each other */
+    int block_checksums; /* each block is followed by a checksum */
+    int content_checksum; /* the frame ends with the content checksum */
+    int finished; /* end mark has been reached */
+};
+
+/* Parse the LZ4 frame header, and initialize the frame reader.
+ * Returns 0 on success, -1 if frame is invalid or unsupported. */
+int pyi_lz4_frame_open(struct PYI_LZ4_FRAME_READER *reader, const unsigned char *src, size_t src_length);
+
+/* Decode next data block of the frame into the output buffer of given
+ * length, at the given position, and store the length of decoded data
+ * into *block_length. Matches in linked blocks may refer to the data
+ * that precedes the position, down to the start of the output buffer.
+ * Returns 1 if a block was decoded, 0 at the end of the frame, and -1
+ * on error. */
+int pyi_lz4_frame_read_block(struct PYI_LZ4_FRAME_READER *reader, unsigned char *dst, size_t dst_position, size_t dst_length, size_t *block_length);
+
+/* Decode the whole LZ4 frame into the output buffer, whose length must
+ * match the length of decoded data. Returns 0 on success, -1 on error. */
+int pyi_lz4_decompress(const unsigned char *src, size_t src_length, unsigned char *dst, size_t dst_length);
+
+#endif /* PYI_LZ4_H */
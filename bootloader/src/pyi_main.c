@@ -55,6 +55,7 @@
 #include "pyi_launch.h"
 #include "pyi_splash.h"
 #include "pyi_apple_events.h"
+#include "pyi_memfd.h"
 
 
 /* Global PYI_CONTEXT structure used for bookkeeping of state variables.
@@ -89,6 +90,7 @@ static int _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx);
 
 static int _pyi_main_resolve_executable(struct PYI_CONTEXT *pyi_context);
 static int _pyi_main_resolve_pkg_archive(struct PYI_CONTEXT *pyi_context);
+static void _pyi_main_resolve_cold_archive_filename(struct PYI_CONTEXT *pyi_context);
 
 #if !defined(_WIN32) && !defined(__APPLE__)
 static int _pyi_main_handle_posix_onedir(struct PYI_CONTEXT *pyi_ctx);
@@ -193,8 +195,14 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
         pyi_unsetenv("_PYI_SPLASH_IPC");
 
+#if !defined(_WIN32)
+        pyi_unsetenv("_PYI_EXTRACTION_PIPE"); /* POSIX only */
+#endif
+
 #if defined(__linux__)
         pyi_unsetenv("_PYI_LINUX_PROCESS_NAME"); /* Linux only */
+
+        pyi_unsetenv("_PYI_MEMFD_MANIFEST"); /* Linux only */
 #endif
     }
 
@@ -266,6 +274,53 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
     }
     free(env_var_value);
 
+    /* Read the number of worker threads for extraction of onefile
+     * builds from corresponding environment variable. */
+    env_var_value = pyi_getenv("PYINSTALLER_EXTRACTION_WORKERS"); /* strdup'd copy or NULL */
+    if (env_var_value) {
+        int num_workers = atoi(env_var_value);
+        if (num_workers > 0) {
+            pyi_ctx->extraction_workers = (unsigned int)num_workers;
+        }
+    }
+    free(env_var_value);
+
+    /* Read the setting for disabling io_uring based extraction from
+     * corresponding environment variable. */
+#if defined(__linux__)
+    env_var_value = pyi_getenv("PYINSTALLER_DISABLE_IO_URING"); /* strdup'd copy or NULL */
+    if (env_var_value) {
+        pyi_ctx->disable_io_uring = strcmp(env_var_value, "0") != 0;
+    }
+    free(env_var_value);
+#endif
+
+    /* Read the setting for removal of temporary directory in a detached
+     * reaper process from corresponding environment variable. */
+#if !defined(_WIN32)
+    env_var_value = pyi_getenv("PYINSTALLER_DETACHED_CLEANUP"); /* strdup'd copy or NULL */
+    if (env_var_value) {
+        pyi_ctx->detached_cleanup = strcmp(env_var_value, "0") != 0;
+    }
+    free(env_var_value);
+
+    /* Read the timeout for waiting on population of the extraction
+     * cache by another instance of the application from corresponding
+     * environment variable. */
+    pyi_ctx->extraction_cache_timeout = PYI_EXTRACTION_CACHE_DEFAULT_TIMEOUT;
+    pyi_ctx->extraction_cache_lock_fd = -1;
+    pyi_ctx->deferred_extraction_pipe[0] = -1;
+    pyi_ctx->deferred_extraction_pipe[1] = -1;
+    env_var_value = pyi_getenv("PYINSTALLER_EXTRACTION_CACHE_TIMEOUT"); /* strdup'd copy or NULL */
+    if (env_var_value) {
+        int timeout = atoi(env_var_value);
+        if (timeout >= 0) {
+            pyi_ctx->extraction_cache_timeout = (unsigned int)timeout;
+        }
+    }
+    free(env_var_value);
+#endif
+
     /* On Linux, restore process name (passed from parent process via
      * environment variable. */
 #if defined(__linux__)
@@ -298,15 +353,50 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             }
 #endif
 
-            /* Create temporary directory */
-            PYI_DEBUG("LOADER: creating temporary directory (runtime_tmpdir=%s)...\n", pyi_ctx->runtime_tmpdir);
+            /* In diskless mode, the files are extracted into memory-backed
+             * files, which are accessible via parent's /proc/<pid>/fd
+             * directory. If the diskless mode is not supported, fall back
+             * to extraction cache or temporary directory. The diskless
+             * mode takes precedence over the extraction cache. Entries of
+             * the cold archive are not extracted in diskless mode, so the
+             * diskless mode is not used if the cold archive has any. */
+#if defined(__linux__)
+            if (pyi_ctx->diskless) {
+                if (pyi_memfd_is_supported(pyi_ctx->archive) && !pyi_ctx->cold_archive_has_files) {
+                    snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "/proc/%d/fd", (int)getpid());
+                    pyi_ctx->diskless_active = 1;
+                    pyi_ctx->extraction_cache_dir = NULL;
+                } else {
+                    PYI_DEBUG("LOADER: diskless mode is not available; extracting files to disk.\n");
+                }
+            }
+#endif
 
-            if (pyi_create_temporary_application_directory(pyi_ctx) < 0) {
-                PYI_ERROR("Could not create temporary directory!\n");
-                return -1;
+            /* Use the persistent extraction cache, if enabled. If the
+             * cache cannot be used, fall back to temporary directory. */
+#if !defined(_WIN32)
+            if (pyi_ctx->extraction_cache_dir != NULL) {
+                if (pyi_open_extraction_cache(pyi_ctx) < 0) {
+                    PYI_DEBUG("LOADER: extraction cache is not available; using temporary directory.\n");
+                }
             }
+#endif
+
+            /* Create temporary directory */
+#if defined(__linux__)
+            if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_UNUSED && !pyi_ctx->diskless_active) {
+#else
+            if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_UNUSED) {
+#endif
+                PYI_DEBUG("LOADER: creating temporary directory (runtime_tmpdir=%s)...\n", pyi_ctx->runtime_tmpdir);
 
-            PYI_DEBUG("LOADER: created temporary directory: %s\n", pyi_ctx->application_home_dir);
+                if (pyi_create_temporary_application_directory(pyi_ctx) < 0) {
+                    PYI_ERROR("Could not create temporary directory!\n");
+                    return -1;
+                }
+
+                PYI_DEBUG("LOADER: created temporary directory: %s\n", pyi_ctx->application_home_dir);
+            }
         } else {
             /* Child process; the path to ephemeral application top-level
              * directory should be available in _PYI_APPLICATION_HOME_DIR
@@ -331,6 +421,21 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             }
 
             free(env_var_value);
+
+            /* In diskless mode, read the manifest of memory-backed files,
+             * whose path is available in _PYI_MEMFD_MANIFEST environment
+             * variable. */
+#if defined(__linux__)
+            env_var_value = pyi_getenv("_PYI_MEMFD_MANIFEST");
+            if (env_var_value && env_var_value[0]) {
+                PYI_DEBUG("LOADER: reading manifest of memory-backed files: %s\n", env_var_value);
+                if (pyi_memfd_load_manifest(pyi_ctx, env_var_value) < 0) {
+                    free(env_var_value);
+                    return -1;
+                }
+            }
+            free(env_var_value);
+#endif
         }
     } else {
         char executable_dir[PYI_PATH_MAX];
@@ -460,13 +565,12 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 static void
 _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
 {
-    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct ARCHIVE_ENTRY_LIST *options = &pyi_ctx->archive->entry_groups[ARCHIVE_GROUP_RUNTIME_OPTION];
     const struct TOC_ENTRY *toc_entry;
+    size_t i;
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
+    for (i = 0; i < options->count; i++) {
+        toc_entry = options->entries[i];
 
         /* NOTE: option names are constants, so we use hard-coded
          * lengths as well to avoid invoking strlen() on each
@@ -497,6 +601,103 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
             pyi_ctx->runtime_tmpdir = toc_entry->name + 19;
         }
 
+        /* pyi-tmpdir-policy <value>
+         *
+         * Run-time temporary directory selection policy for onefile
+         * programs (Linux only). */
+#if defined(__linux__)
+        if (strncmp(toc_entry->name, "pyi-tmpdir-policy", 17) == 0) {
+            pyi_ctx->runtime_tmpdir_policy = toc_entry->name + 18;
+            continue;
+        }
+#endif
+
+        /* pyi-diskless
+         *
+         * Diskless mode for onefile programs (Linux only). */
+#if defined(__linux__)
+        if (strcmp(toc_entry->name, "pyi-diskless") == 0) {
+            pyi_ctx->diskless = 1;
+            continue;
+        }
+#endif
+
+        /* pyi-extraction-cache [<value>]
+         *
+         * Persistent extraction cache for onefile programs, with optional
+         * cache directory override (POSIX only). */
+#if !defined(_WIN32)
+        if (strncmp(toc_entry->name, "pyi-extraction-cache", 20) == 0) {
+            pyi_ctx->extraction_cache_dir = (toc_entry->name[20] == ' ') ? toc_entry->name + 21 : "";
+            continue;
+        }
+#endif
+
+        /* pyi-deferred-extraction
+         *
+         * Deferred extraction of data files for onefile programs (POSIX
+         * only). */
+#if !defined(_WIN32)
+        if (strcmp(toc_entry->name, "pyi-deferred-extraction") == 0) {
+            pyi_ctx->deferred_extraction = 1;
+            continue;
+        }
+#endif
+
+        /* pyi-startup-entries <value>
+         *
+         * Number of leading extractable entries that are accessed
+         * during startup, as recorded from the startup profile. */
+        if (strncmp(toc_entry->name, "pyi-startup-entries", 19) == 0) {
+            pyi_ctx->startup_entry_count = (size_t)strtoul(toc_entry->name + 20, NULL, 10);
+            continue;
+        }
+
+        /* pyi-prewarm [<value>]
+         *
+         * Background prewarming of the page cache for the python shared
+         * library and for the files listed via the option values (POSIX
+         * only). Might be specified multiple times, once for each listed
+         * file. */
+#if !defined(_WIN32)
+        if (strncmp(toc_entry->name, "pyi-prewarm", 11) == 0) {
+            pyi_ctx->prewarm = 1;
+            continue;
+        }
+#endif
+
+        /* pyi-cold-archive <value>
+         *
+         * Presence of the companion cold PKG archive; the value is the
+         * hash of the cold archive's contents, which makes the main
+         * archive's hash cover the cold archive as well. The cold archive
+         * is located next to the executable, and its name is inferred in
+         * the same way as the name of side-loaded PKG archive. */
+        if (strncmp(toc_entry->name, "pyi-cold-archive", 16) == 0) {
+            _pyi_main_resolve_cold_archive_filename(pyi_ctx);
+            continue;
+        }
+
+        /* pyi-cold-data-files
+         *
+         * The cold PKG archive contains data files that need to be
+         * extracted in onefile mode. */
+        if (strcmp(toc_entry->name, "pyi-cold-data-files") == 0) {
+            pyi_ctx->cold_archive_has_files = 1;
+            continue;
+        }
+
+        /* pyi-archive-hash <value>
+         *
+         * Hash of the archive's contents; stored by the archive writer
+         * when the persistent extraction cache is enabled. */
+#if !defined(_WIN32)
+        if (strncmp(toc_entry->name, "pyi-archive-hash", 16) == 0) {
+            pyi_ctx->archive_hash = toc_entry->name + 17;
+            continue;
+        }
+#endif
+
         /* pyi-contents-directory <value>
          *
          * Contents sub-directory in onedir programs. */
@@ -736,6 +937,10 @@ _pyi_main_onedir_or_onefile_child(struct PYI_CONTEXT *pyi_ctx)
     ret = pyi_launch_execute(pyi_ctx);
     pyi_launch_finalize(pyi_ctx);
 
+#if defined(__linux__)
+    pyi_memfd_free_manifest(pyi_ctx);
+#endif
+
     /* Clean up splash screen resources; required when in single-process
      * execution mode, i.e. when using --onedir on Windows or macOS. */
     pyi_splash_finalize(pyi_ctx->splash);
@@ -759,11 +964,87 @@ _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
 {
     int ret;
 
-    /* Extract files to temporary directory */
-    PYI_DEBUG("LOADER: extracting files to temporary directory...\n");
-    if (pyi_launch_extract_files_from_archive(pyi_ctx) < 0) {
-        PYI_DEBUG("LOADER: failed to extract files!\n");
-        return -1;
+    /* Defer the extraction of data files until after the child process
+     * is started, if requested. This is possible only with temporary
+     * directory (the extraction cache directory must be complete before
+     * it is marked as ready) and without splash screen (which displays
+     * the progress of extraction). */
+#if !defined(_WIN32)
+    pyi_ctx->deferred_extraction_active = (
+        pyi_ctx->deferred_extraction &&
+        pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_UNUSED &&
+#if defined(__linux__)
+        !pyi_ctx->diskless_active &&
+#endif
+        pyi_ctx->splash == NULL
+    );
+#endif
+
+    /* Extract files to temporary directory, unless they are already
+     * available in the extraction cache. In diskless mode, extract them
+     * into memory-backed files. */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_READY) {
+        PYI_DEBUG("LOADER: files are already extracted in the extraction cache.\n");
+#if defined(__linux__)
+    } else if (pyi_ctx->diskless_active) {
+        PYI_DEBUG("LOADER: extracting files to memory-backed files...\n");
+        if (pyi_memfd_extract_files(pyi_ctx) < 0) {
+            PYI_DEBUG("LOADER: failed to extract files!\n");
+            return -1;
+        }
+#endif
+    } else {
+        PYI_DEBUG("LOADER: extracting files to temporary directory...\n");
+        if (pyi_launch_extract_files_from_archive(pyi_ctx) < 0) {
+            PYI_DEBUG("LOADER: failed to extract files!\n");
+#if !defined(_WIN32)
+            /* Remove the partially-populated cache directory, so that
+             * subsequent runs can try to populate it again. */
+            if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_POPULATE) {
+                pyi_recursive_rmdir(pyi_ctx->application_home_dir);
+                pyi_release_extraction_cache(pyi_ctx);
+            }
+#endif
+            return -1;
+        }
+
+#if !defined(_WIN32)
+        /* Mark the populated cache directory as ready, and release the
+         * lock, so that other instances of the application that are
+         * waiting for it can use the directory. If that fails, the cache
+         * directory is removed and the lock is released (so that other
+         * instances do not wait for it), and the files are extracted
+         * into a temporary directory instead. */
+        if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_POPULATE) {
+            if (pyi_publish_extraction_cache(pyi_ctx) == 0) {
+                pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_READY;
+                pyi_release_extraction_cache(pyi_ctx);
+            } else {
+                PYI_DEBUG("LOADER: failed to mark extraction cache directory as ready; using temporary directory.\n");
+                pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_UNUSED;
+                if (pyi_create_temporary_application_directory(pyi_ctx) < 0) {
+                    PYI_ERROR("Could not create temporary directory!\n");
+                    return -1;
+                }
+                PYI_DEBUG("LOADER: created temporary directory: %s\n", pyi_ctx->application_home_dir);
+                if (pyi_launch_extract_files_from_archive(pyi_ctx) < 0) {
+                    PYI_DEBUG("LOADER: failed to extract files!\n");
+                    return -1;
+                }
+            }
+        }
+#endif
+
+        /* Start extraction of the deferred files in the background */
+#if !defined(_WIN32)
+        if (pyi_ctx->deferred_extraction_active) {
+            PYI_DEBUG("LOADER: starting deferred extraction of data files...\n");
+            if (pyi_launch_start_deferred_extraction(pyi_ctx) < 0) {
+                PYI_DEBUG("LOADER: failed to extract files!\n");
+                return -1;
+            }
+        }
+#endif
     }
 
     /* At this point, extraction to temporary directory is complete,
@@ -852,12 +1133,28 @@ _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
     PYI_DEBUG("LOADER: setting _PYI_APPLICATION_HOME_DIR to %s\n", pyi_ctx->application_home_dir);
     pyi_setenv("_PYI_APPLICATION_HOME_DIR", pyi_ctx->application_home_dir);
 
+    /* In diskless mode, pass the path to the manifest of memory-backed
+     * files to the child process. */
+#if defined(__linux__)
+    if (pyi_ctx->diskless_active) {
+        PYI_DEBUG("LOADER: setting _PYI_MEMFD_MANIFEST to %s\n", pyi_ctx->memfd_manifest_path);
+        pyi_setenv("_PYI_MEMFD_MANIFEST", pyi_ctx->memfd_manifest_path);
+    }
+#endif
+
     /* Start the child process that will execute user's program. */
     PYI_DEBUG("LOADER: starting the child process...\n");
     ret = pyi_utils_create_child(pyi_ctx);
 
     PYI_DEBUG("LOADER: child process exited (return code: %d)\n", ret);
 
+    /* Stop the deferred extraction, if it is still running */
+#if !defined(_WIN32)
+    if (pyi_launch_finish_deferred_extraction(pyi_ctx) < 0) {
+        PYI_WARNING("Deferred extraction of data files failed!\n");
+    }
+#endif
+
     PYI_DEBUG("LOADER: performing cleanup...\n");
 
     /* The cleanup code for onefile parent process is organized in a
@@ -895,6 +1192,36 @@ int pyi_main_onefile_parent_cleanup(struct PYI_CONTEXT *pyi_ctx)
     pyi_splash_finalize(pyi_ctx->splash);
     pyi_splash_context_free(&pyi_ctx->splash);
 
+    /* In diskless mode, there is nothing to remove; the memory-backed
+     * files are released when the process exits. */
+#if defined(__linux__)
+    if (pyi_ctx->diskless_active) {
+        pyi_archive_free(&pyi_ctx->archive);
+        return 0;
+    }
+#endif
+
+    /* Keep the extraction cache directory for subsequent runs */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_READY) {
+        PYI_DEBUG("LOADER: keeping extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+        pyi_archive_free(&pyi_ctx->archive);
+        return 0;
+    }
+
+#if !defined(_WIN32)
+    /* Hand the removal of the application's temporary directory off
+     * to a detached reaper process, if requested. If the reaper cannot
+     * be started, fall back to removing the directory here. */
+    if (pyi_ctx->detached_cleanup && !pyi_ctx->strict_unpack_mode) {
+        PYI_DEBUG("LOADER: removing temporary directory in detached process: %s\n", pyi_ctx->application_home_dir);
+        if (pyi_recursive_rmdir_detached(pyi_ctx->application_home_dir) == 0) {
+            pyi_archive_free(&pyi_ctx->archive);
+            return 0;
+        }
+        PYI_DEBUG("LOADER: failed to start detached process for removal of temporary directory!\n");
+    }
+#endif
+
     /* Remove the application's temporary directory */
     PYI_DEBUG("LOADER: removing temporary directory: %s\n", pyi_ctx->application_home_dir);
     cleanup_status = pyi_recursive_rmdir(pyi_ctx->application_home_dir);
@@ -1181,7 +1508,9 @@ _pyi_allow_pkg_sideload(const char *executable)
 {
     FILE *file = NULL;
     uint64_t magic_offset;
+    uint64_t data_end;
     unsigned char magic[8];
+    unsigned char signature[8];
 
     /* First, find the PKG sideload signature in the executable */
     file = pyi_path_fopen(executable, "rb");
@@ -1193,10 +1522,24 @@ _pyi_allow_pkg_sideload(const char *executable)
     memcpy(magic, MAGIC_BASE, sizeof(magic));
     magic[3] += 0x0D;  /* 0x00 -> 0x0D */
 
-    /* Find magic pattern in the executable */
-    magic_offset = pyi_utils_find_magic_pattern(file, magic, sizeof(magic));
+    /* The signature is expected to be found at the end of data appended
+     * to the executable; check there first, and fall back to scanning
+     * the whole executable. */
+    magic_offset = 0;
+    data_end = pyi_utils_find_appended_data_end(file);
+    if (data_end >= sizeof(magic)) {
+        if (pyi_fseek(file, data_end - sizeof(magic), SEEK_SET) == 0 &&
+            fread(signature, sizeof(signature), 1, file) == 1 &&
+            memcmp(signature, magic, sizeof(magic)) == 0) {
+            magic_offset = data_end - sizeof(magic);
+        }
+    }
+    if (magic_offset == 0) {
+        magic_offset = pyi_utils_find_magic_pattern(file, magic, sizeof(magic));
+    }
+    fclose(file);
+
     if (magic_offset == 0) {
-        fclose(file);
         return 1; /* Error code 1: no embedded PKG sideload signature */
     }
 
@@ -1259,6 +1602,28 @@ _pyi_main_resolve_pkg_archive(struct PYI_CONTEXT *pyi_ctx)
     return 0;
 }
 
+static void
+_pyi_main_resolve_cold_archive_filename(struct PYI_CONTEXT *pyi_ctx)
+{
+    int length;
+
+    /* On Windows, the .exe suffix is replaced with .cold.pkg, while
+     * elsewhere, .cold.pkg suffix is appended to the executable file
+     * name. */
+#ifdef _WIN32
+    length = snprintf(pyi_ctx->cold_archive_filename, PYI_PATH_MAX, "%.*scold.pkg", (int)strlen(pyi_ctx->executable_filename) - 3, pyi_ctx->executable_filename);
+#else
+    length = snprintf(pyi_ctx->cold_archive_filename, PYI_PATH_MAX, "%s.cold.pkg", pyi_ctx->executable_filename);
+#endif
+    if (length < 0 || length >= PYI_PATH_MAX) {
+        PYI_WARNING("Path to the cold PKG archive exceeds maximum path length!\n");
+        pyi_ctx->cold_archive_filename[0] = 0;
+        return;
+    }
+
+    PYI_DEBUG("LOADER: cold archive file: %s\n", pyi_ctx->cold_archive_filename);
+}
+
 
 /**********************************************************************\
  *                 POSIX single-process onedir helper                 *
@@ -18,6 +18,7 @@
 
 #ifndef _WIN32
     #include <sys/types.h> /* pid_t */
+    #include <pthread.h> /* pthread_t */
 #endif
 
 
@@ -71,6 +72,24 @@ enum PYI_PROCESS_LEVEL
     PYI_PROCESS_LEVEL_SUBPROCESS = 2
 };
 
+/* State of the persistent extraction cache (onefile, POSIX only) */
+enum PYI_EXTRACTION_CACHE_STATE
+{
+    /* Extraction cache is not used; the application is extracted into
+     * ephemeral temporary directory, which is removed at exit. */
+    PYI_EXTRACTION_CACHE_UNUSED = 0,
+    /* The cache directory was created by this process, which needs to
+     * extract the application into it, and mark it as ready. */
+    PYI_EXTRACTION_CACHE_POPULATE = 1,
+    /* The cache directory contains fully-extracted application, and
+     * is kept at exit. */
+    PYI_EXTRACTION_CACHE_READY = 2
+};
+
+/* Default timeout (in seconds) for waiting on another instance of the
+ * application to populate the extraction cache. */
+#define PYI_EXTRACTION_CACHE_DEFAULT_TIMEOUT 300
+
 
 struct PYI_CONTEXT
 {
@@ -127,6 +146,21 @@ struct PYI_CONTEXT
     /* Main PKG archive */
     struct ARCHIVE *archive;
 
+    /* Fully resolved path to the companion cold PKG archive, which
+     * contains rarely-used entries that were split off the main archive
+     * at build time; empty string if the application has no cold
+     * archive. The cold archive is opened only when its entries are
+     * needed (i.e., when they are extracted in onefile mode), and the
+     * PYZ archive embedded in it is opened by the PYZ reader when one
+     * of its modules is first imported. */
+    char cold_archive_filename[PYI_PATH_MAX];
+
+    /* Whether the cold PKG archive contains data files that need to be
+     * extracted in onefile mode. Set by the `pyi-cold-data-files` run-time
+     * option; if the cold archive contains only the cold PYZ archive, it
+     * does not need to be opened by the bootloader at all. */
+    unsigned char cold_archive_has_files;
+
     /* Splash screen context structure */
     struct SPLASH_CONTEXT *splash;
 
@@ -149,6 +183,11 @@ struct PYI_CONTEXT
      * itself. */
     char application_home_dir[PYI_PATH_MAX];
 
+    /* State of the persistent extraction cache; see definitions of
+     * PYI_EXTRACTION_CACHE_STATE enum. If the cache is used, the
+     * application's top-level directory is the cache directory. */
+    unsigned char extraction_cache_state;
+
     /* Handle to loaded python shared library. */
     pyi_dylib_t python_dll;
 
@@ -168,7 +207,72 @@ struct PYI_CONTEXT
      * PyInstaller's CI. */
     unsigned char strict_unpack_mode;
 
+    /* Number of worker threads used for decompression during extraction
+     * of onefile builds. This value is dynamically controlled by the
+     * `PYINSTALLER_EXTRACTION_WORKERS` environment variable; 0 (default)
+     * means that the number of worker threads is determined from the
+     * number of available CPUs, and 1 disables the worker threads. */
+    unsigned int extraction_workers;
+
+    /* Number of leading extractable entries of the main archive that
+     * are accessed during startup, according to the startup profile the
+     * application was built with; set by the `pyi-startup-entries`
+     * run-time option. These entries are always extracted as part of
+     * the startup-critical set in deferred extraction. */
+    size_t startup_entry_count;
+
+#if defined(__linux__)
+    /* Disable batched extraction of onefile builds via io_uring. This
+     * flag is dynamically controlled by `PYINSTALLER_DISABLE_IO_URING`
+     * environment variable (enabled by a value different from 0). If
+     * io_uring is not disabled, but is not available (not supported by
+     * the kernel, or disabled by system policy), the files are extracted
+     * one by one, same as if it was disabled. */
+    unsigned char disable_io_uring;
+#endif
+
 #if !defined(_WIN32)
+    /* Remove the temporary directory of onefile builds in a detached
+     * reaper process, so that the parent process can exit (with the
+     * child's exit code) without waiting for the removal to complete.
+     * This flag is dynamically controlled by `PYINSTALLER_DETACHED_CLEANUP`
+     * environment variable (enabled by a value different from 0). It
+     * has no effect in strict unpack mode, where failure to remove the
+     * directory must be reported. */
+    unsigned char detached_cleanup;
+
+    /* Maximum time (in seconds) to wait for another instance of the
+     * application to populate the persistent extraction cache, before
+     * falling back to extraction into a temporary directory. This value
+     * is dynamically controlled by `PYINSTALLER_EXTRACTION_CACHE_TIMEOUT`
+     * environment variable; 0 disables waiting. */
+    unsigned int extraction_cache_timeout;
+
+    /* File descriptor of the lock file that is held (with exclusive
+     * flock) while this process is populating the extraction cache;
+     * -1 if the lock is not held. */
+    int extraction_cache_lock_fd;
+
+    /* Deferred extraction of data files in onefile builds, enabled via
+     * `pyi-deferred-extraction` run-time option. If active, the child
+     * process is started as soon as the startup-critical files are
+     * extracted, while the remaining data files are extracted by a
+     * background thread of the parent process. The child is notified
+     * about extracted files via the pipe, and about completion of the
+     * deferred extraction by the closing of its write end. See
+     * pyi_launch.h. */
+    unsigned char deferred_extraction;
+    unsigned char deferred_extraction_active;
+    int deferred_extraction_cancelled; /* Accessed only via __atomic builtins */
+    int deferred_extraction_status;
+    int deferred_extraction_pipe[2];
+    pthread_t deferred_extraction_thread;
+
+    /* Background prewarming of the page cache for the python shared
+     * library and the early-imported extension modules, enabled via
+     * `pyi-prewarm` run-time option. See pyi_prewarm.h. */
+    unsigned char prewarm;
+
     /* Path to the dynamic linker/loader; if executable is launched
      * via explicitly specified dynamic linker/loader (for example,
      * /lib64/ld-linux-x86-64.so.2 /path/to/executable), we need to
@@ -231,6 +335,44 @@ struct PYI_CONTEXT
      * the `archive` structure! */
     const char *runtime_tmpdir;
 
+    /* Run-time temporary directory selection policy in onefile builds
+     * (Linux only). If set to "prefer-memory", the temporary directory
+     * is created on a memory-backed file system (tmpfs), provided that
+     * the files to extract fit into available memory. Has no effect if
+     * `runtime_tmpdir` is specified.
+     *
+     * NOTE: if non-NULL, the pointer points at the TOC buffer entry in
+     * the `archive` structure! */
+#if defined(__linux__)
+    const char *runtime_tmpdir_policy;
+
+    /* Diskless mode of onefile builds (Linux only). If enabled via
+     * `pyi-diskless` run-time option, the files are extracted into
+     * memory-backed files (memfd) instead of the temporary directory,
+     * provided that the archive and the kernel support it (in which
+     * case `diskless_active` is set in the parent process). The path to
+     * the manifest that maps the entries' names to the paths of the
+     * memory-backed files is passed to the child process, which reads
+     * it into `memfd_manifest`. See pyi_memfd.h. */
+    unsigned char diskless;
+    unsigned char diskless_active;
+    char memfd_manifest_path[64];
+    char *memfd_manifest;
+    size_t memfd_manifest_length;
+#endif
+
+    /* Persistent extraction cache in onefile builds (POSIX only). If
+     * enabled, this is the path to the user-specified cache directory,
+     * or an empty string to use the default cache directory; NULL if
+     * the cache is not enabled. The archive hash (hex digest of the
+     * archive's contents, computed at build time) identifies the
+     * application's directory within the cache directory.
+     *
+     * NOTE: if non-NULL, the pointers point at the TOC buffer entries
+     * in the `archive` structure! */
+    const char *extraction_cache_dir;
+    const char *archive_hash;
+
     /* Contents sub-directory in onedir builds.
      *
      * NOTE: if non-NULL, the pointer points at the TOC buffer entry in
@@ -0,0 +1,757 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Diskless extraction of onefile archive entries into anonymous
+ * memory-backed files (Linux memfd).
+ *
+ * The onefile parent process extracts each file into a memory-backed
+ * file created by memfd_create(), instead of a file in the temporary
+ * directory. The file descriptors are kept open (but are not inherited
+ * by the child process) for as long as the parent process is alive, so
+ * that the files can be accessed by the child process (and its own
+ * subprocesses) via /proc/<parent pid>/fd/<fd> paths.
+ *
+ * The mapping from the entries' names to the paths of memory-backed
+ * files is stored in a manifest, which is also a memory-backed file.
+ * Its path is passed to the child process via _PYI_MEMFD_MANIFEST
+ * environment variable. The manifest consists of records, each of
+ * which contains the entry's typecode followed by its name, and the
+ * path of the corresponding file, both NULL-terminated.
+ */
+
+/* Having a header included outside of the ifdef block prevents the compilation
+ * unit from becoming empty, which is disallowed by pedantic ISO C. */
+#include "pyi_global.h"
+
+#if defined(__linux__)
+
+#include <dlfcn.h>  /* dlopen */
+#include <errno.h>
+#include <link.h>  /* ElfW */
+#include <stdio.h>  /* snprintf */
+#include <stdlib.h>  /* calloc, free, realloc */
+#include <string.h>  /* memcpy, strcmp, strlen, strrchr, strstr */
+#include <unistd.h>  /* close, ftruncate, getpid, read, syscall, sysconf, write */
+#include <sys/mman.h>  /* mmap, munmap */
+#include <sys/resource.h>  /* getrlimit, setrlimit */
+#include <sys/stat.h>  /* fstat */
+#include <sys/syscall.h>  /* __NR_memfd_create */
+#include <fcntl.h>  /* open, O_* */
+
+/* PyInstaller headers. */
+#include "pyi_archive.h"
+#include "pyi_main.h"
+#include "pyi_memfd.h"
+
+
+#ifndef MFD_CLOEXEC
+    #define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_EXEC
+    #define MFD_EXEC 0x0010U
+#endif
+
+/* Number of file descriptors that are reserved for purposes other than
+ * the memory-backed files (standard streams, the archive, the manifest,
+ * and the files opened by the parent process during its lifetime). */
+#define PYI_MEMFD_RESERVED_FDS 64
+
+/* ELF class of the bootloader, and thus of the libraries it can load. */
+#define PYI_MEMFD_ELF_CLASS (sizeof(void *) == 8 ? ELFCLASS64 : ELFCLASS32)
+
+/* Growable buffer for the manifest records. */
+struct MEMFD_MANIFEST_BUFFER
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+
+/* Create anonymous memory-backed file with the given name (which is
+ * used only for debugging purposes, and need not be unique). The file
+ * descriptor is not inherited by the child process.
+ *
+ * The file is explicitly created as executable (MFD_EXEC), because the
+ * shared libraries and extension modules are loaded from it; with the
+ * vm.memfd_noexec sysctl (linux 6.3 and later) set to 1, files would be
+ * sealed as non-executable by default. Older kernels reject the unknown
+ * flag with EINVAL, in which case the file is created without it. With
+ * vm.memfd_noexec set to 2, the creation of executable files fails with
+ * EACCES. */
+static int
+_pyi_memfd_create(const char *name)
+{
+#if defined(__NR_memfd_create)
+    static int exec_flag_unsupported = 0;
+    int fd;
+
+    if (!exec_flag_unsupported) {
+        fd = (int)syscall(__NR_memfd_create, name, MFD_CLOEXEC | MFD_EXEC);
+        if (fd >= 0 || errno != EINVAL) {
+            return fd;
+        }
+        exec_flag_unsupported = 1;
+    }
+    return (int)syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+#else
+    (void)name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Check that code can be loaded from the memory-backed file, by mapping
+ * it as executable via its path in /proc (in the same way as the
+ * dynamic loader maps a library that is loaded from that path).
+ * Returns 0 on success, and -1 on failure. */
+static int
+_pyi_memfd_probe_exec(int fd)
+{
+    char path[64];
+    long page_size;
+    int path_fd;
+    void *mapping;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || ftruncate(fd, (off_t)page_size) < 0) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    path_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (path_fd < 0) {
+        return -1;
+    }
+    mapping = mmap(NULL, (size_t)page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, path_fd, 0);
+    close(path_fd);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    munmap(mapping, (size_t)page_size);
+    return 0;
+}
+
+/* Ensure that the process can keep at least the given number of file
+ * descriptors open, raising the soft limit (up to the hard limit) if
+ * necessary. The raised limit is inherited by the child process.
+ * Returns 0 on success, and -1 if the limit cannot be raised. */
+static int
+_pyi_memfd_ensure_fd_limit(rlim_t num_fds)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return -1;
+    }
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= num_fds) {
+        return 0;
+    }
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < num_fds) {
+        return -1;
+    }
+
+    limit.rlim_cur = num_fds;
+    if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return -1;
+    }
+    PYI_DEBUG("LOADER: raised the limit on open file descriptors to %lu.\n", (unsigned long)num_fds);
+    return 0;
+}
+
+int
+pyi_memfd_is_supported(const struct ARCHIVE *archive)
+{
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    size_t num_files = 0;
+    size_t i;
+    int fd;
+
+    /* Splash screen resources are loaded by Tcl/Tk from the filesystem */
+    if (archive->toc_splash != NULL) {
+        PYI_DEBUG("LOADER: diskless mode is not supported for archives with splash screen.\n");
+        return 0;
+    }
+
+    /* MERGE dependencies are copied from other archives into the
+     * application's top-level directory */
+    for (i = 0; i < extractable_entries->count; i++) {
+        if (extractable_entries->entries[i]->typecode == ARCHIVE_ITEM_DEPENDENCY) {
+            PYI_DEBUG("LOADER: diskless mode is not supported for archives with dependencies.\n");
+            return 0;
+        }
+        if (extractable_entries->entries[i]->typecode != ARCHIVE_ITEM_SYMLINK) {
+            num_files++;
+        }
+    }
+
+    /* Kernel support for memfd_create() (linux 3.17 and later), and for
+     * executable memory-backed files (which may be prohibited by the
+     * vm.memfd_noexec sysctl, or by a security module) */
+    fd = _pyi_memfd_create("pyi-probe");
+    if (fd < 0) {
+        PYI_DEBUG("LOADER: memfd_create() is not available (errno: %d).\n", errno);
+        return 0;
+    }
+    if (_pyi_memfd_probe_exec(fd) < 0) {
+        PYI_DEBUG("LOADER: memory-backed files cannot be mapped as executable (errno: %d).\n", errno);
+        close(fd);
+        return 0;
+    }
+    close(fd);
+
+    /* Each memory-backed file is kept open for as long as the process is
+     * alive, so all of them need to fit under the limit on number of
+     * open file descriptors. */
+    if (_pyi_memfd_ensure_fd_limit((rlim_t)(num_files + PYI_MEMFD_RESERVED_FDS)) < 0) {
+        PYI_DEBUG("LOADER: diskless mode is not supported: %lu files exceed the limit on open file descriptors.\n", (unsigned long)num_files);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**********************************************************************\
+ *                         Manifest creation                          *
+\**********************************************************************/
+static int
+_pyi_memfd_manifest_append(struct MEMFD_MANIFEST_BUFFER *manifest, char typecode, const char *name, const char *path)
+{
+    size_t name_length = strlen(name) + 1;
+    size_t path_length = strlen(path) + 1;
+    size_t record_length = 1 + name_length + path_length;
+
+    if (manifest->length + record_length > manifest->capacity) {
+        size_t new_capacity = manifest->capacity ? manifest->capacity * 2 : 16 * 1024;
+        char *new_data;
+
+        while (new_capacity < manifest->length + record_length) {
+            new_capacity *= 2;
+        }
+        new_data = realloc(manifest->data, new_capacity);
+        if (new_data == NULL) {
+            return -1;
+        }
+        manifest->data = new_data;
+        manifest->capacity = new_capacity;
+    }
+
+    manifest->data[manifest->length] = typecode;
+    memcpy(manifest->data + manifest->length + 1, name, name_length);
+    memcpy(manifest->data + manifest->length + 1 + name_length, path, path_length);
+    manifest->length += record_length;
+
+    return 0;
+}
+
+/* Find the path of the given name among manifest records. */
+static const char *
+_pyi_memfd_manifest_find(const char *data, size_t length, const char *name)
+{
+    const char *record = data;
+    const char *end = data + length;
+
+    while (record < end) {
+        const char *record_name = record + 1;
+        const char *record_path = record_name + strlen(record_name) + 1;
+
+        if (strcmp(record_name, name) == 0) {
+            return record_path;
+        }
+        record = record_path + strlen(record_path) + 1;
+    }
+
+    return NULL;
+}
+
+/* Resolve the (relative) symbolic link target against the link's parent
+ * directory, and normalize the . and .. components. Returns 0 on success,
+ * and -1 if the target is absolute, points outside of the application's
+ * top-level directory, or exceeds the buffer size. */
+static int
+_pyi_memfd_resolve_link_target(const char *link_name, const char *target, char *resolved)
+{
+    char joined_path[PYI_PATH_MAX];
+    const char *separator;
+    char *component;
+    char *saveptr;
+    size_t length = 0;
+    int ret;
+
+    if (target[0] == '/') {
+        return -1;
+    }
+
+    separator = strrchr(link_name, '/');
+    if (separator != NULL) {
+        ret = snprintf(joined_path, PYI_PATH_MAX, "%.*s/%s", (int)(separator - link_name), link_name, target);
+    } else {
+        ret = snprintf(joined_path, PYI_PATH_MAX, "%s", target);
+    }
+    if (ret >= PYI_PATH_MAX) {
+        return -1;
+    }
+
+    resolved[0] = 0;
+    for (component = strtok_r(joined_path, "/", &saveptr); component != NULL; component = strtok_r(NULL, "/", &saveptr)) {
+        size_t component_length;
+
+        if (strcmp(component, ".") == 0) {
+            continue;
+        }
+        if (strcmp(component, "..") == 0) {
+            char *last_separator;
+
+            if (length == 0) {
+                return -1;
+            }
+            last_separator = strrchr(resolved, '/');
+            length = last_separator ? (size_t)(last_separator - resolved) : 0;
+            resolved[length] = 0;
+            continue;
+        }
+
+        component_length = strlen(component);
+        if (length + component_length + 2 > PYI_PATH_MAX) {
+            return -1;
+        }
+        if (length > 0) {
+            resolved[length++] = '/';
+        }
+        memcpy(resolved + length, component, component_length + 1);
+        length += component_length;
+    }
+
+    return 0;
+}
+
+/* Extract the entry into a new memory-backed file, and store the path
+ * under which it can be accessed by other processes into memfd_path. */
+static int
+_pyi_memfd_extract_entry(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, char *memfd_path)
+{
+    char output_filename[64];
+    const char *basename;
+    int fd;
+
+    basename = strrchr(toc_entry->name, '/');
+    basename = basename ? basename + 1 : toc_entry->name;
+
+    fd = _pyi_memfd_create(basename);
+    if (fd < 0) {
+        PYI_PERROR("memfd_create", "Failed to create memory-backed file for %s!\n", toc_entry->name);
+        return -1;
+    }
+
+    /* The regular extraction codepath (re)opens the file via its path
+     * in /proc/self/fd; this way, all compression methods, checksum
+     * verification, and file permissions are handled in the same way
+     * as with on-disk files. */
+    snprintf(output_filename, sizeof(output_filename), "/proc/self/fd/%d", fd);
+    if (pyi_archive_extract2fs(archive, toc_entry, output_filename) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* Keep the file descriptor open; the file is accessed by the child
+     * process via the parent's /proc entry. */
+    snprintf(memfd_path, 64, "/proc/%d/fd/%d", (int)getpid(), fd);
+    return 0;
+}
+
+int
+pyi_memfd_extract_files(struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    struct MEMFD_MANIFEST_BUFFER manifest = { NULL, 0, 0 };
+    char memfd_path[64];
+    size_t i;
+    int manifest_fd;
+    int rc = -1;
+
+    /* Extract regular files */
+    for (i = 0; i < extractable_entries->count; i++) {
+        const struct TOC_ENTRY *toc_entry = extractable_entries->entries[i];
+
+        if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+            continue;
+        }
+
+        if (_pyi_memfd_extract_entry(archive, toc_entry, memfd_path) < 0) {
+            PYI_ERROR("Failed to extract %s into memory-backed file!\n", toc_entry->name);
+            goto cleanup;
+        }
+        if (_pyi_memfd_manifest_append(&manifest, toc_entry->typecode, toc_entry->name, memfd_path) < 0) {
+            PYI_ERROR("Could not allocate memory for memory-backed file manifest!\n");
+            goto cleanup;
+        }
+    }
+
+    /* Symbolic links are mapped to the files that they point to; links
+     * to directories and to files outside of the archive are skipped. */
+    for (i = 0; i < extractable_entries->count; i++) {
+        const struct TOC_ENTRY *toc_entry = extractable_entries->entries[i];
+        char resolved_target[PYI_PATH_MAX];
+        const char *target_path;
+        unsigned char *link_target;
+
+        if (toc_entry->typecode != ARCHIVE_ITEM_SYMLINK) {
+            continue;
+        }
+
+        link_target = pyi_archive_extract(archive, toc_entry);
+        if (link_target == NULL) {
+            goto cleanup;
+        }
+        if (_pyi_memfd_resolve_link_target(toc_entry->name, (const char *)link_target, resolved_target) < 0) {
+            target_path = NULL;
+        } else {
+            target_path = _pyi_memfd_manifest_find(manifest.data, manifest.length, resolved_target);
+        }
+        free(link_target);
+
+        if (target_path == NULL) {
+            PYI_DEBUG("LOADER: skipping symbolic link %s with unresolved target.\n", toc_entry->name);
+            continue;
+        }
+
+        /* Copy the target path, as appending may re-allocate the buffer */
+        snprintf(memfd_path, sizeof(memfd_path), "%s", target_path);
+        if (_pyi_memfd_manifest_append(&manifest, toc_entry->typecode, toc_entry->name, memfd_path) < 0) {
+            PYI_ERROR("Could not allocate memory for memory-backed file manifest!\n");
+            goto cleanup;
+        }
+    }
+
+    /* Write the manifest */
+    manifest_fd = _pyi_memfd_create("pyi-manifest");
+    if (manifest_fd < 0) {
+        PYI_PERROR("memfd_create", "Failed to create memory-backed file manifest!\n");
+        goto cleanup;
+    }
+    if (manifest.length > 0 && write(manifest_fd, manifest.data, manifest.length) != (ssize_t)manifest.length) {
+        PYI_PERROR("write", "Failed to write memory-backed file manifest!\n");
+        close(manifest_fd);
+        goto cleanup;
+    }
+    snprintf(pyi_ctx->memfd_manifest_path, sizeof(pyi_ctx->memfd_manifest_path), "/proc/%d/fd/%d", (int)getpid(), manifest_fd);
+
+    rc = 0;
+
+cleanup:
+    free(manifest.data);
+    return rc;
+}
+
+
+/**********************************************************************\
+ *                      Manifest use (child process)                  *
+\**********************************************************************/
+int
+pyi_memfd_load_manifest(struct PYI_CONTEXT *pyi_ctx, const char *manifest_path)
+{
+    struct stat stat_buf;
+    size_t length = 0;
+    char *data;
+    int fd;
+
+    fd = open(manifest_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        PYI_PERROR("open", "Failed to open memory-backed file manifest %s!\n", manifest_path);
+        return -1;
+    }
+    if (fstat(fd, &stat_buf) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    data = malloc(stat_buf.st_size + 1);
+    if (data == NULL) {
+        close(fd);
+        return -1;
+    }
+    while (length < (size_t)stat_buf.st_size) {
+        ssize_t num_read = read(fd, data + length, stat_buf.st_size - length);
+        if (num_read <= 0) {
+            if (num_read < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        length += num_read;
+    }
+    close(fd);
+
+    /* Guard against truncated records */
+    if (length != (size_t)stat_buf.st_size || (length > 0 && data[length - 1] != 0)) {
+        PYI_ERROR("Failed to read memory-backed file manifest %s!\n", manifest_path);
+        free(data);
+        return -1;
+    }
+    data[length] = 0;
+
+    pyi_ctx->memfd_manifest = data;
+    pyi_ctx->memfd_manifest_length = length;
+    return 0;
+}
+
+void
+pyi_memfd_free_manifest(struct PYI_CONTEXT *pyi_ctx)
+{
+    free(pyi_ctx->memfd_manifest);
+    pyi_ctx->memfd_manifest = NULL;
+    pyi_ctx->memfd_manifest_length = 0;
+}
+
+const char *
+pyi_memfd_lookup(const struct PYI_CONTEXT *pyi_ctx, const char *name)
+{
+    if (pyi_ctx->memfd_manifest == NULL) {
+        return NULL;
+    }
+    return _pyi_memfd_manifest_find(pyi_ctx->memfd_manifest, pyi_ctx->memfd_manifest_length, name);
+}
+
+/* Check whether the manifest record describes a shared library that
+ * should be pre-loaded. */
+static int
+_pyi_memfd_is_preloadable_library(const struct PYI_CONTEXT *pyi_ctx, const char *record)
+{
+    const char *name = record + 1;
+    const char *basename;
+
+    if (record[0] != ARCHIVE_ITEM_BINARY) {
+        return 0;
+    }
+
+    basename = strrchr(name, '/');
+    basename = basename ? basename + 1 : name;
+
+    /* Shared libraries, but not python extension modules */
+    if (strncmp(basename, "lib", 3) != 0 || strstr(basename, ".so") == NULL) {
+        return 0;
+    }
+    if (strstr(basename, ".cpython-") != NULL || strstr(basename, ".abi3.") != NULL) {
+        return 0;
+    }
+
+    /* The python shared library is loaded separately */
+    if (strcmp(name, pyi_ctx->archive->python_libname) == 0) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* State of pre-loading of the shared libraries. */
+struct MEMFD_PRELOAD_STATE
+{
+    /* Manifest records of the libraries to be pre-loaded */
+    const char **records;
+    size_t count;
+    /* Per-library state: 0 = not visited, 1 = being loaded (i.e., its
+     * dependencies are being loaded), 2 = done (loaded or failed). */
+    unsigned char *state;
+};
+
+static void _pyi_memfd_preload_library(struct MEMFD_PRELOAD_STATE *preload, size_t index);
+
+/* Convert the virtual address to the file offset, using the PT_LOAD
+ * program headers. Returns 0 on success, -1 if address is not mapped
+ * from the file. */
+static int
+_pyi_memfd_elf_vaddr_to_offset(const ElfW(Phdr) *phdrs, size_t num_phdrs, ElfW(Addr) vaddr, size_t *offset)
+{
+    size_t i;
+
+    for (i = 0; i < num_phdrs; i++) {
+        if (phdrs[i].p_type == PT_LOAD && vaddr >= phdrs[i].p_vaddr && vaddr - phdrs[i].p_vaddr < phdrs[i].p_filesz) {
+            *offset = (size_t)(phdrs[i].p_offset + (vaddr - phdrs[i].p_vaddr));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Pre-load the collected libraries that the given library depends on
+ * (i.e., whose names are listed in its DT_NEEDED entries), so that the
+ * dynamic loader can resolve them via their sonames when the library
+ * itself is loaded. */
+static void
+_pyi_memfd_preload_dependencies(struct MEMFD_PRELOAD_STATE *preload, const char *path)
+{
+    const unsigned char *data;
+    const ElfW(Ehdr) *elf_header;
+    const ElfW(Phdr) *phdrs;
+    const ElfW(Dyn) *dyn = NULL;
+    size_t num_dyn = 0;
+    ElfW(Addr) strtab_addr = 0;
+    size_t strtab_size = 0;
+    size_t strtab_offset;
+    struct stat stat_buf;
+    size_t file_size;
+    size_t i;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &stat_buf) < 0 || (size_t)stat_buf.st_size < sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return;
+    }
+    file_size = (size_t)stat_buf.st_size;
+    data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    /* ELF header and program headers */
+    elf_header = (const ElfW(Ehdr) *)data;
+    if (memcmp(elf_header->e_ident, ELFMAG, SELFMAG) != 0 || elf_header->e_ident[EI_CLASS] != PYI_MEMFD_ELF_CLASS) {
+        goto cleanup;
+    }
+    if (elf_header->e_phentsize != sizeof(ElfW(Phdr)) || elf_header->e_phoff > file_size || (file_size - elf_header->e_phoff) / sizeof(ElfW(Phdr)) < elf_header->e_phnum) {
+        goto cleanup;
+    }
+    phdrs = (const ElfW(Phdr) *)(data + elf_header->e_phoff);
+
+    /* Dynamic section */
+    for (i = 0; i < elf_header->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_DYNAMIC && phdrs[i].p_offset <= file_size && phdrs[i].p_filesz <= file_size - phdrs[i].p_offset) {
+            dyn = (const ElfW(Dyn) *)(data + phdrs[i].p_offset);
+            num_dyn = phdrs[i].p_filesz / sizeof(ElfW(Dyn));
+            break;
+        }
+    }
+    if (dyn == NULL) {
+        goto cleanup;
+    }
+
+    /* String table with the names of needed libraries */
+    for (i = 0; i < num_dyn && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag == DT_STRTAB) {
+            strtab_addr = dyn[i].d_un.d_ptr;
+        } else if (dyn[i].d_tag == DT_STRSZ) {
+            strtab_size = dyn[i].d_un.d_val;
+        }
+    }
+    if (strtab_size == 0 || _pyi_memfd_elf_vaddr_to_offset(phdrs, elf_header->e_phnum, strtab_addr, &strtab_offset) < 0) {
+        goto cleanup;
+    }
+    if (strtab_offset > file_size || strtab_size > file_size - strtab_offset) {
+        goto cleanup;
+    }
+
+    /* Pre-load the needed libraries that are among the collected ones */
+    for (i = 0; i < num_dyn && dyn[i].d_tag != DT_NULL; i++) {
+        const char *needed_name;
+        size_t j;
+
+        if (dyn[i].d_tag != DT_NEEDED || dyn[i].d_un.d_val >= strtab_size) {
+            continue;
+        }
+        needed_name = (const char *)data + strtab_offset + dyn[i].d_un.d_val;
+        if (memchr(needed_name, 0, strtab_size - dyn[i].d_un.d_val) == NULL) {
+            continue;
+        }
+
+        for (j = 0; j < preload->count; j++) {
+            const char *name = preload->records[j] + 1;
+            const char *basename = strrchr(name, '/');
+            basename = basename ? basename + 1 : name;
+            if (strcmp(basename, needed_name) == 0) {
+                _pyi_memfd_preload_library(preload, j);
+                break;
+            }
+        }
+    }
+
+cleanup:
+    munmap((void *)data, file_size);
+}
+
+/* Pre-load the library with the given index, after its dependencies. */
+static void
+_pyi_memfd_preload_library(struct MEMFD_PRELOAD_STATE *preload, size_t index)
+{
+    const char *record = preload->records[index];
+    const char *path = record + 1 + strlen(record + 1) + 1;
+
+    /* Already loaded (or failed to load), or part of a dependency cycle */
+    if (preload->state[index] != 0) {
+        return;
+    }
+    preload->state[index] = 1;
+
+    _pyi_memfd_preload_dependencies(preload, path);
+
+    if (dlopen(path, RTLD_LAZY | RTLD_LOCAL) != NULL) {
+        PYI_DEBUG("LOADER: pre-loaded shared library %s from %s\n", record + 1, path);
+    } else {
+        PYI_DEBUG("LOADER: failed to pre-load shared library %s: %s\n", record + 1, dlerror());
+    }
+    preload->state[index] = 2;
+}
+
+void
+pyi_memfd_preload_libraries(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const char *manifest_end = pyi_ctx->memfd_manifest + pyi_ctx->memfd_manifest_length;
+    struct MEMFD_PRELOAD_STATE preload = { NULL, 0, NULL };
+    const char *record;
+    size_t num_records = 0;
+    size_t i;
+
+    if (pyi_ctx->memfd_manifest == NULL) {
+        return;
+    }
+
+    /* Count the records */
+    for (record = pyi_ctx->memfd_manifest; record < manifest_end; num_records++) {
+        record += 1 + strlen(record + 1) + 1;
+        record += strlen(record) + 1;
+    }
+
+    preload.records = calloc(num_records ? num_records : 1, sizeof(const char *));
+    preload.state = calloc(num_records ? num_records : 1, 1);
+    if (preload.records == NULL || preload.state == NULL) {
+        goto cleanup;
+    }
+
+    /* Collect the records of libraries to be pre-loaded */
+    for (record = pyi_ctx->memfd_manifest; record < manifest_end;) {
+        const char *path = record + 1 + strlen(record + 1) + 1;
+        if (_pyi_memfd_is_preloadable_library(pyi_ctx, record)) {
+            preload.records[preload.count++] = record;
+        }
+        record = path + strlen(path) + 1;
+    }
+
+    /* Load each library once, after the collected libraries it depends
+     * on, which are determined from its DT_NEEDED entries. */
+    for (i = 0; i < preload.count; i++) {
+        _pyi_memfd_preload_library(&preload, i);
+    }
+
+cleanup:
+    free(preload.records);
+    free(preload.state);
+}
+
+#endif /* defined(__linux__) */
@@ -0,0 +1,67 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Diskless extraction of onefile archive entries into anonymous
+ * memory-backed files (Linux memfd).
+ */
+
+#ifndef PYI_MEMFD_H
+#define PYI_MEMFD_H
+
+#if defined(__linux__)
+
+struct ARCHIVE;
+struct PYI_CONTEXT;
+
+/* Check whether the archive can be extracted into memory-backed files;
+ * this requires kernel support for memfd_create(), and an archive
+ * without splash screen resources and without MERGE dependencies, which
+ * are expected to be found on the filesystem. As the memory-backed files
+ * are kept open, the limit on number of open file descriptors is raised
+ * (up to the hard limit) to accommodate them, if necessary; if they do
+ * not fit, the diskless mode is not supported. Returns 1 if supported,
+ * and 0 otherwise. */
+int pyi_memfd_is_supported(const struct ARCHIVE *archive);
+
+/* Extract all extractable entries from the archive into memory-backed
+ * files, and write the manifest that maps the entries' names to the
+ * paths of corresponding files (/proc/<pid>/fd/<fd>). The files remain
+ * available for as long as the calling process is alive. The path to
+ * the manifest is stored in pyi_ctx->memfd_manifest_path. Returns 0 on
+ * success, -1 on failure. */
+int pyi_memfd_extract_files(struct PYI_CONTEXT *pyi_ctx);
+
+/* Read the manifest from the given path into pyi_ctx->memfd_manifest.
+ * Returns 0 on success, -1 on failure. */
+int pyi_memfd_load_manifest(struct PYI_CONTEXT *pyi_ctx, const char *manifest_path);
+
+/* Free the manifest that was read by pyi_memfd_load_manifest(). */
+void pyi_memfd_free_manifest(struct PYI_CONTEXT *pyi_ctx);
+
+/* Look up the path to the memory-backed file for the given entry name.
+ * Returns NULL if the manifest does not contain the entry. */
+const char *pyi_memfd_lookup(const struct PYI_CONTEXT *pyi_ctx, const char *name);
+
+/* Pre-load the collected shared libraries (binary entries whose names
+ * start with "lib" and are not python extension modules) from their
+ * memory-backed files. As they cannot be found by the dynamic loader
+ * via library search path, this allows their dependents (for example,
+ * extension modules) to resolve them via their already-loaded sonames.
+ * Each library is loaded once, after the collected libraries that it
+ * depends on. */
+void pyi_memfd_preload_libraries(const struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* defined(__linux__) */
+
+#endif /* PYI_MEMFD_H */
@@ -184,7 +184,13 @@ pyi_multipkg_extract_dependency(
     }
     if (ret == true) {
         PYI_DEBUG("LOADER: file %s found on filesystem (%s), assuming onedir reference.\n", dependency_name, full_srcpath);
-        if (pyi_copy_file(full_srcpath, output_filename) == -1) {
+        /* Avoid duplicating the data of the file that already exists on
+         * the filesystem: try a reflink or a hard link first, and copy
+         * the file only if neither can be created (for example, if the
+         * file is located on a different file system). */
+        if (pyi_link_file(full_srcpath, output_filename, true) == 0) {
+            PYI_DEBUG("LOADER: linked file %s from %s.\n", dependency_name, full_srcpath);
+        } else if (pyi_copy_file(full_srcpath, output_filename) == -1) {
             PYI_ERROR("Failed to copy file %s from %s!\n", dependency_name, full_srcpath);
             return -1;
         }
@@ -0,0 +1,147 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Background prewarming of the page cache for the python shared library
+ * and the early-imported extension modules.
+ */
+
+/* Having a header included outside of the ifdef block prevents the compilation
+ * unit from becoming empty, which is disallowed by pedantic ISO C. */
+#include "pyi_global.h"
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>  /* open, posix_fadvise */
+#include <limits.h>  /* INT_MAX */
+#include <pthread.h>
+#include <stdio.h>  /* snprintf */
+#include <stdlib.h>  /* calloc, free */
+#include <string.h>  /* strncmp */
+#include <unistd.h>  /* close */
+#include <sys/stat.h>  /* fstat */
+
+/* PyInstaller headers. */
+#include "pyi_prewarm.h"
+#include "pyi_archive.h"
+#include "pyi_main.h"
+#include "pyi_memfd.h"
+
+
+struct PREWARM_LIST
+{
+    size_t count;
+    char filenames[1][PYI_PATH_MAX];  /* Variable-length array */
+};
+
+
+/*
+ * Issue the read-ahead request for the whole file.
+ */
+static void
+_pyi_prewarm_file(const char *filename)
+{
+    struct stat statbuf;
+    int fd;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0) {
+        /* On Linux, this initiates the read-ahead of the whole file (the
+         * same as readahead()), and may block until the read requests are
+         * submitted, which is fine in the helper thread. */
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, 0, statbuf.st_size, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+        struct radvisory advisory;
+        advisory.ra_offset = 0;
+        advisory.ra_count = (statbuf.st_size > INT_MAX) ? INT_MAX : (int)statbuf.st_size;
+        fcntl(fd, F_RDADVISE, &advisory);
+#endif
+    }
+
+    close(fd);
+}
+
+static void *
+_pyi_prewarm_thread(void *arg)
+{
+    struct PREWARM_LIST *list = arg;
+    size_t i;
+
+    for (i = 0; i < list->count; i++) {
+        _pyi_prewarm_file(list->filenames[i]);
+    }
+    PYI_DEBUG("LOADER: page cache prewarming finished (%zu files).\n", list->count);
+
+    free(list);
+    return NULL;
+}
+
+/*
+ * Add the file with given name (relative to the application's top-level
+ * directory) to the list. Files that are backed by memory (diskless
+ * mode) are skipped.
+ */
+static void
+_pyi_prewarm_add_file(struct PREWARM_LIST *list, const struct PYI_CONTEXT *pyi_ctx, const char *name)
+{
+#if defined(__linux__)
+    if (pyi_memfd_lookup(pyi_ctx, name) != NULL) {
+        return;
+    }
+#endif
+    if (snprintf(list->filenames[list->count], PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, name) >= PYI_PATH_MAX) {
+        return;
+    }
+    list->count++;
+}
+
+void
+pyi_prewarm_start(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct ARCHIVE_ENTRY_LIST *options = &pyi_ctx->archive->entry_groups[ARCHIVE_GROUP_RUNTIME_OPTION];
+    struct PREWARM_LIST *list;
+    pthread_t thread;
+    size_t i;
+
+    if (!pyi_ctx->prewarm) {
+        return;
+    }
+
+    /* The python shared library, followed by the listed files */
+    list = calloc(1, sizeof(struct PREWARM_LIST) + options->count * PYI_PATH_MAX);
+    if (list == NULL) {
+        return;
+    }
+
+    _pyi_prewarm_add_file(list, pyi_ctx, pyi_ctx->archive->python_libname);
+    for (i = 0; i < options->count; i++) {
+        if (strncmp(options->entries[i]->name, "pyi-prewarm ", 12) == 0) {
+            _pyi_prewarm_add_file(list, pyi_ctx, options->entries[i]->name + 12);
+        }
+    }
+
+    if (list->count == 0 || pthread_create(&thread, NULL, _pyi_prewarm_thread, list) != 0) {
+        free(list);
+        return;
+    }
+    pthread_detach(thread);
+
+    PYI_DEBUG("LOADER: started page cache prewarming thread.\n");
+}
+
+#endif /* !defined(_WIN32) */
@@ -0,0 +1,43 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Background prewarming of the page cache for the python shared library
+ * and the early-imported extension modules (POSIX only).
+ *
+ * When the application directory is on a slow or network-backed file
+ * system, loading the python shared library and the extension modules
+ * that are imported at startup is dominated by page faults that are
+ * serviced one at a time. The helper thread issues read-ahead requests
+ * for these files while the interpreter is being loaded and initialized,
+ * so that their data is already in the page cache when needed.
+ */
+
+#ifndef PYI_PREWARM_H
+#define PYI_PREWARM_H
+
+#if !defined(_WIN32)
+
+struct PYI_CONTEXT;
+
+/* Start the prewarming thread, if enabled via `pyi-prewarm` run-time
+ * option. The files to prewarm are the python shared library and the
+ * files listed via `pyi-prewarm <name>` options (in the listed order),
+ * relative to the top-level application directory. The thread is
+ * detached and does not access the context after it is started. Any
+ * failure is silently ignored, as prewarming is merely an optimization. */
+void pyi_prewarm_start(const struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* !defined(_WIN32) */
+
+#endif /* PYI_PREWARM_H */
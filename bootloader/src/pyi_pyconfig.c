@@ -23,6 +23,7 @@
 #include "pyi_global.h"
 #include "pyi_main.h"
 #include "pyi_utils.h"
+#include "pyi_memfd.h"
 
 
 /*
@@ -141,8 +142,9 @@ struct PyiRuntimeOptions *
 pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
 {
     struct PyiRuntimeOptions *options;
-    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct ARCHIVE_ENTRY_LIST *option_entries = &pyi_ctx->archive->entry_groups[ARCHIVE_GROUP_RUNTIME_OPTION];
     const struct TOC_ENTRY *toc_entry;
+    size_t i;
     int num_wflags = 0;
     int num_xflags = 0;
     int failed = 0;
@@ -156,13 +158,10 @@ pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
     options->utf8_mode = -1; /* default: auto-select based on locale */
 
     /* Parse run-time options from PKG archive */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+    for (i = 0; i < option_entries->count; i++) {
         const char *value_str;
 
-        /* We are only interested in OPTION entries */
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
+        toc_entry = option_entries->entries[i];
 
         /* Skip bootloader options; these start with "pyi-" */
         if (strncmp(toc_entry->name, "pyi-", 4) == 0) {
@@ -219,11 +218,8 @@ pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
     }
 
     /* Collect */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        /* We are only interested in OPTION entries */
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
+    for (i = 0; i < option_entries->count; i++) {
+        toc_entry = option_entries->entries[i];
 
         if (strncmp(toc_entry->name, "W ", 2) == 0) {
             /* Copy for pass-through */
@@ -470,7 +466,13 @@ pyi_pyconfig_set_module_search_paths(PyConfig *config, const struct PYI_CONTEXT
     int ret = 0;
     int i;
 
-    /* home/base_library.zip */
+    /* home/base_library.zip; in diskless mode, the corresponding
+     * memory-backed file. */
+#if defined(__linux__)
+    if (pyi_memfd_lookup(pyi_ctx, "base_library.zip") != NULL) {
+        snprintf(base_library_path, PYI_PATH_MAX, "%s", pyi_memfd_lookup(pyi_ctx, "base_library.zip"));
+    } else
+#endif
     if (snprintf(base_library_path, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, "base_library.zip") >= PYI_PATH_MAX) {
         return -1;
     }
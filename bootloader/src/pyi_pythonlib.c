@@ -36,6 +36,7 @@
 #include "pyi_utils.h"
 #include "pyi_python.h"
 #include "pyi_pyconfig.h"
+#include "pyi_memfd.h"
 
 /*
  * Load the Python shared library, and bind all required symbols from it.
@@ -110,7 +111,13 @@ pyi_pylib_load(struct PYI_CONTEXT *pyi_ctx)
     }
 #endif
 
-    /* Look for python shared library in top-level application directory */
+    /* Look for python shared library in top-level application directory;
+     * in diskless mode, use the corresponding memory-backed file. */
+#if defined(__linux__)
+    if (pyi_memfd_lookup(pyi_ctx, dll_name) != NULL) {
+        snprintf(dll_fullpath, PYI_PATH_MAX, "%s", pyi_memfd_lookup(pyi_ctx, dll_name));
+    } else
+#endif
     if (pyi_path_join(dll_fullpath, pyi_ctx->application_home_dir, dll_name) == NULL) {
         PYI_ERROR("Path of Python shared library (%s) and its name (%s) exceed buffer size (%d)\n", pyi_ctx->application_home_dir, PYI_PATH_MAX);
         return -1;
@@ -132,6 +139,12 @@ pyi_pylib_load(struct PYI_CONTEXT *pyi_ctx)
         return -1;
     }
 
+    /* In diskless mode, pre-load the collected shared libraries, so that
+     * they can be resolved by extension modules that depend on them. */
+#if defined(__linux__)
+    pyi_memfd_preload_libraries(pyi_ctx);
+#endif
+
     return pyi_python_bind_functions(pyi_ctx->python_dll, archive->python_version);
 }
 
@@ -261,8 +274,11 @@ int
 pyi_pylib_import_modules(const struct PYI_CONTEXT *pyi_ctx)
 {
     const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct ARCHIVE_ENTRY_LIST *module_entries = &archive->entry_groups[ARCHIVE_GROUP_PYMODULE];
     const struct TOC_ENTRY *toc_entry;
-    unsigned char *data;
+    const unsigned char *data;
+    unsigned char *data_buffer;
+    size_t i;
     PyObject *co;
     PyObject *mod;
     PyObject *meipass_obj;
@@ -285,19 +301,22 @@ pyi_pylib_import_modules(const struct PYI_CONTEXT *pyi_ctx)
 
     PYI_DEBUG("LOADER: importing modules from PKG/CArchive\n");
 
-    /* Iterate through toc looking for module entries (type 'm')
-     * this is normally just bootstrap stuff (archive and iu) */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_PYMODULE && toc_entry->typecode != ARCHIVE_ITEM_PYPACKAGE) {
-            continue;
-        }
+    /* Iterate through module entries (type 'm' and 'M'); this is
+     * normally just bootstrap stuff (archive and iu) */
+    for (i = 0; i < module_entries->count; i++) {
+        toc_entry = module_entries->entries[i];
 
-        data = pyi_archive_extract(archive, toc_entry);
+        /* Obtain the data; if possible, directly from memory mapping */
+        data = pyi_archive_get_entry_data(archive, toc_entry, &data_buffer);
+        if (data == NULL) {
+            PYI_ERROR("Failed to extract module %s from archive!\n", toc_entry->name);
+            return -1;
+        }
         PYI_DEBUG("LOADER: extracted %s\n", toc_entry->name);
 
         /* Unmarshal the stored code object */
         co = PI_PyMarshal_ReadObjectFromString((const char *)data, toc_entry->uncompressed_length);
-        free(data);
+        free(data_buffer);
 
         if (co == NULL) {
             PYI_ERROR("Failed to unmarshal code object for module %s!\n", toc_entry->name);
@@ -342,16 +361,12 @@ pyi_pylib_install_pyz(const struct PYI_CONTEXT *pyi_ctx)
 
     PYI_DEBUG("LOADER: looking for PYZ archive TOC entry...\n");
 
-    /* Iterate through TOC and look for PYZ entry (type 'z') */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode == ARCHIVE_ITEM_PYZ) {
-            break;
-        }
-    }
-    if (toc_entry >= archive->toc_end) {
+    /* Look up the PYZ entry (type 'z') */
+    if (archive->entry_groups[ARCHIVE_GROUP_PYZ].count == 0) {
         PYI_ERROR("PYZ archive entry not found in the TOC!\n");
         return -1;
     }
+    toc_entry = archive->entry_groups[ARCHIVE_GROUP_PYZ].entries[0];
 
     /* Store archive filename as Python string. */
 #ifdef _WIN32
@@ -386,6 +401,35 @@ pyi_pylib_install_pyz(const struct PYI_CONTEXT *pyi_ctx)
     }
 
     PYI_DEBUG("LOADER: path to PYZ archive stored into sys.%s...\n", attr_name);
+
+    /* If the application has a cold archive, store its path into
+     * sys._pyinstaller_cold_pyz; the PYZ archive with cold modules is
+     * stored at its very beginning. The archive is not opened here; the
+     * PYZ reader opens it once one of its modules is imported. */
+    if (pyi_ctx->cold_archive_filename[0] != 0) {
+        attr_name = "_pyinstaller_cold_pyz";
+
+#ifdef _WIN32
+        pyz_path_obj = PI_PyUnicode_Decode(pyi_ctx->cold_archive_filename, strlen(pyi_ctx->cold_archive_filename), "utf-8", "strict");
+#else
+        pyz_path_obj = PI_PyUnicode_DecodeFSDefault(pyi_ctx->cold_archive_filename);
+#endif
+        if (pyz_path_obj == NULL) {
+            PYI_ERROR("Failed to decode path to cold PKG archive\n");
+            return -1;
+        }
+
+        rc = PI_PySys_SetObject(attr_name, pyz_path_obj);
+        PI_Py_DecRef(pyz_path_obj);
+
+        if (rc != 0) {
+            PYI_ERROR("Failed to store path to cold PYZ archive into sys.%s!\n", attr_name);
+            return -1;
+        }
+
+        PYI_DEBUG("LOADER: path to cold PYZ archive stored into sys.%s...\n", attr_name);
+    }
+
     return 0;
 }
 
@@ -265,6 +265,11 @@ pyi_splash_extract(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_
         return 0;
     }
 
+    /* No-op if files are already available in the extraction cache */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_READY) {
+        return 0;
+    }
+
     /* Iterate over the requirements array */
     for (pos = 0; pos < (size_t)splash->requirements_len; pos += strlen(requirement_filename) + 1) {
         /* Read filename from requirements array */
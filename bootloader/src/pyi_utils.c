@@ -21,13 +21,28 @@
 #ifdef _WIN32
     #include <windows.h>
 #else
+    #include <errno.h>
+    #include <fcntl.h>  /* open, O_* */
     #include <stdlib.h>
     #include <unistd.h>
     #include <sys/stat.h>
 #endif
 
+#include <stddef.h>  /* offsetof */
 #include <string.h>
 
+#if defined(__APPLE__)
+    #include <mach-o/fat.h>  /* fat_header, fat_arch */
+    #include <mach-o/loader.h>  /* mach_header_64, linkedit_data_command */
+#endif
+
+#if defined(__linux__)
+    #include <elf.h>
+    #include <sys/ioctl.h>  /* ioctl */
+    #include <sys/syscall.h>  /* __NR_copy_file_range */
+    #include <linux/fs.h>  /* FICLONE */
+#endif
+
 /* PyInstaller headers. */
 #include "pyi_utils.h"
 
@@ -88,9 +103,106 @@ pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *
     return 0;
 }
 
+/*
+ * Helper that creates all directories listed in the given directory
+ * table (as stored in the archive), rooted under the given prefix path.
+ * The table consists of NULL-terminated relative paths, and each
+ * directory must be preceded by its parent directory, so that the
+ * directories can be created one after another, without checking for
+ * existence of their parents. Directories that already exist are
+ * skipped. On POSIX systems, the directories are created relative to
+ * the file descriptor of the prefix directory, which avoids repeated
+ * resolution of the prefix path.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+pyi_create_directory_table(const struct PYI_CONTEXT *pyi_ctx, const char *prefix_path, const char *directory_table, size_t table_length)
+{
+    const char *name = directory_table;
+    const char *table_end = directory_table + table_length;
+    int rc = 0;
+#ifdef _WIN32
+    char path[PYI_PATH_MAX];
+    wchar_t path_w[PYI_PATH_MAX];
+#else
+    int dir_fd;
+
+    (void)pyi_ctx;
+
+    dir_fd = open(prefix_path, O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        return -1;
+    }
+#endif
+
+    while (name < table_end) {
+        const char *name_end = memchr(name, 0, table_end - name);
+        if (name_end == NULL) {
+            rc = -1; /* Last name is not NULL-terminated */
+            break;
+        }
+
+#ifdef _WIN32
+        if (snprintf(path, PYI_PATH_MAX, "%s%c%s", prefix_path, PYI_SEP, name) >= PYI_PATH_MAX) {
+            rc = -1;
+            break;
+        }
+        pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX);
+
+        /* CreateDirectoryW returns 0 on failure. */
+        if (CreateDirectoryW(path_w, pyi_ctx->security_attr) == 0 && GetLastError() != ERROR_ALREADY_EXISTS) {
+            rc = -1;
+            break;
+        }
+#else
+        if (mkdirat(dir_fd, name, 0700) < 0 && errno != EEXIST) {
+            rc = -1;
+            break;
+        }
+#endif
+
+        name = name_end + 1;
+    }
+
+#ifndef _WIN32
+    close(dir_fd);
+#endif
+
+    return rc;
+}
+
+#if defined(__linux__) && defined(__NR_copy_file_range)
+
+/*
+ * Copy the data from the source file descriptor to the destination file
+ * descriptor within the kernel, using copy_file_range() system call
+ * (which is called directly, as the glibc wrapper requires glibc 2.27 or
+ * newer). The data is copied from/to the current file offsets, which are
+ * advanced by the amount of copied data. Returns 0 if all data was
+ * copied, and -1 on failure (for example, if the system call is not
+ * supported by the kernel or by the file system); in that case, the
+ * remaining data can be copied from the updated file offsets.
+ */
+static int
+_pyi_utils_copy_file_range(int src_fd, int dest_fd)
+{
+    long ret;
+
+    do {
+        ret = syscall(__NR_copy_file_range, src_fd, NULL, dest_fd, NULL, (size_t)0x40000000, 0U);
+    } while (ret > 0);
+
+    return (ret == 0) ? 0 : -1;
+}
+
+#endif
+
 /*
  * Copy the source file to destination, in chunkc of 4 kB. The parent
- * directory tree of the destination must file must already exist
+ * directory tree of the destination must file must already exist. On
+ * Linux, the data is copied within the kernel via copy_file_range(),
+ * if supported; the buffered copy is used as a fallback.
  */
 int
 pyi_copy_file(const char *src_filename, const char *dest_filename)
@@ -100,6 +212,7 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
     char buffer[4096];
     size_t byte_count = 0;
     int error = 0;
+    bool copied = false;
 
     fp_in = pyi_path_fopen(src_filename, "rb");
     if (fp_in == NULL) {
@@ -112,7 +225,14 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
         return -1;
     }
 
-    while (!feof(fp_in)) {
+#if defined(__linux__) && defined(__NR_copy_file_range)
+    /* Nothing has been read or written through the streams yet, so if
+     * the in-kernel copy fails midway, the buffered copy below continues
+     * from the updated file offsets. */
+    copied = (_pyi_utils_copy_file_range(fileno(fp_in), fileno(fp_out)) == 0);
+#endif
+
+    while (!copied && !feof(fp_in)) {
         /* Read chunk */
         byte_count = fread(buffer, 1, 4096, fp_in);
         if (byte_count <= 0) {
@@ -155,6 +275,61 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
     return error;
 }
 
+/*
+ * Create the destination file as a link to the source file, without
+ * copying the data: as a reflink (a copy-on-write clone of the source
+ * file's data blocks, on file systems that support it; Linux only) or,
+ * if allowed by the caller, as a hard link. The reflinked file receives
+ * the permissions of the source file (with user read and write bits
+ * always set), while the hard link shares the source file's inode, and
+ * thus its permissions as well as any subsequent modifications.
+ *
+ * Returns 0 on success, -1 if neither link could be created; in that
+ * case, the caller is expected to fall back to copying the data. Not
+ * implemented on Windows, where -1 is always returned.
+ */
+int
+pyi_link_file(const char *src_filename, const char *dest_filename, bool allow_hardlink)
+{
+#ifndef _WIN32
+#if defined(__linux__) && defined(FICLONE)
+    int src_fd;
+    int dest_fd;
+    struct stat stat_buf;
+    int rc = -1;
+
+    src_fd = open(src_filename, O_RDONLY | O_CLOEXEC);
+    if (src_fd >= 0) {
+        if (fstat(src_fd, &stat_buf) == 0) {
+            dest_fd = open(dest_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, (stat_buf.st_mode & 0777) | S_IRUSR | S_IWUSR);
+            if (dest_fd >= 0) {
+                rc = ioctl(dest_fd, FICLONE, src_fd);
+                close(dest_fd);
+                if (rc < 0) {
+                    unlink(dest_filename);
+                }
+            }
+        }
+        close(src_fd);
+    }
+    if (rc == 0) {
+        return 0;
+    }
+#endif
+
+    if (allow_hardlink && link(src_filename, dest_filename) == 0) {
+        return 0;
+    }
+
+    return -1;
+#else
+    (void)src_filename;
+    (void)dest_filename;
+    (void)allow_hardlink;
+    return -1;
+#endif
+}
+
 
 /**********************************************************************\
  *                       Magic pattern scanning                       *
@@ -180,7 +355,7 @@ const unsigned char MAGIC_BASE[8] = {
 uint64_t
 pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_len)
 {
-    static const int SEARCH_CHUNK_SIZE = 8192;
+    static const int SEARCH_CHUNK_SIZE = 64 * 1024;
     unsigned char *buffer = NULL;
     uint64_t start_pos, end_pos;
     uint64_t offset = 0;  /* return value */
@@ -208,7 +383,7 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
     /* Search the file back to front, in overlapping SEARCH_CHUNK_SIZE
      * chunks. */
     do {
-        size_t chunk_size, i;
+        size_t chunk_size;
         start_pos = (end_pos >= SEARCH_CHUNK_SIZE) ? (end_pos - SEARCH_CHUNK_SIZE) : 0;
         chunk_size = (size_t)(end_pos - start_pos);
 
@@ -227,10 +402,24 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
             goto cleanup;
         }
 
-        /* Scan the chunk */
-        for (i = chunk_size - magic_len + 1; i > 0; i--) {
-            if (memcmp(buffer + i -1, magic, magic_len) == 0) {
-                offset = start_pos + i - 1;
+        /* Scan the chunk. Use memchr() (which is typically vectorized)
+         * to find candidates for the first byte of the pattern, and keep
+         * the last match within the chunk. */
+        {
+            const unsigned char *candidate = buffer;
+            const unsigned char *last_match = NULL;
+            size_t remaining = chunk_size - magic_len + 1;
+
+            while (remaining > 0 && (candidate = memchr(candidate, magic[0], remaining)) != NULL) {
+                if (memcmp(candidate, magic, magic_len) == 0) {
+                    last_match = candidate;
+                }
+                candidate++;
+                remaining = (size_t)(buffer + chunk_size - magic_len + 1 - candidate);
+            }
+
+            if (last_match) {
+                offset = start_pos + (uint64_t)(last_match - buffer);
                 goto cleanup;
             }
         }
@@ -244,3 +433,392 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
 
     return offset;
 }
+
+#if defined(__linux__)
+
+/* Name of the ELF section into which the PKG archive (or PKG side-load
+ * signature) is added via objcopy at build time. */
+#define PYI_ELF_DATA_SECTION_NAME "pydata"
+
+/*
+ * Read the ELF section header at the given offset, and return its name
+ * offset, data offset, and data size. Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_utils_read_elf_section_header(FILE *fp, int is_64bit, uint64_t offset, uint32_t *name, uint64_t *data_offset, uint64_t *data_size)
+{
+    if (pyi_fseek(fp, offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    if (is_64bit) {
+        Elf64_Shdr section_header;
+        if (fread(&section_header, sizeof(section_header), 1, fp) < 1) {
+            return -1;
+        }
+        *name = section_header.sh_name;
+        *data_offset = section_header.sh_offset;
+        *data_size = section_header.sh_size;
+    } else {
+        Elf32_Shdr section_header;
+        if (fread(&section_header, sizeof(section_header), 1, fp) < 1) {
+            return -1;
+        }
+        *name = section_header.sh_name;
+        *data_offset = section_header.sh_offset;
+        *data_size = section_header.sh_size;
+    }
+    return 0;
+}
+
+/*
+ * Look up the PyInstaller's data section in the (native) ELF file, and
+ * return the file offset at which the section's data ends. Returns 0
+ * if the file has no such section.
+ */
+static uint64_t
+_pyi_utils_find_elf_data_section_end(FILE *fp, int is_64bit, uint64_t file_size)
+{
+    uint64_t section_headers_offset;
+    size_t section_header_size;
+    unsigned int num_sections;
+    unsigned int strtab_index;
+    uint32_t strtab_name;
+    uint64_t strtab_offset;
+    uint64_t strtab_size;
+    char name[sizeof(PYI_ELF_DATA_SECTION_NAME)];
+    unsigned int i;
+
+    /* Read the ELF header */
+    if (pyi_fseek(fp, 0, SEEK_SET) < 0) {
+        return 0;
+    }
+    if (is_64bit) {
+        Elf64_Ehdr elf_header;
+        if (fread(&elf_header, sizeof(elf_header), 1, fp) < 1) {
+            return 0;
+        }
+        section_headers_offset = elf_header.e_shoff;
+        section_header_size = elf_header.e_shentsize;
+        num_sections = elf_header.e_shnum;
+        strtab_index = elf_header.e_shstrndx;
+        if (section_header_size != sizeof(Elf64_Shdr)) {
+            return 0;
+        }
+    } else {
+        Elf32_Ehdr elf_header;
+        if (fread(&elf_header, sizeof(elf_header), 1, fp) < 1) {
+            return 0;
+        }
+        section_headers_offset = elf_header.e_shoff;
+        section_header_size = elf_header.e_shentsize;
+        num_sections = elf_header.e_shnum;
+        strtab_index = elf_header.e_shstrndx;
+        if (section_header_size != sizeof(Elf32_Shdr)) {
+            return 0;
+        }
+    }
+    if (strtab_index >= num_sections) {
+        return 0;
+    }
+
+    /* Read the section header of the section names string table */
+    if (_pyi_utils_read_elf_section_header(fp, is_64bit, section_headers_offset + (uint64_t)strtab_index * section_header_size, &strtab_name, &strtab_offset, &strtab_size) < 0) {
+        return 0;
+    }
+
+    /* Look up the section by its name */
+    for (i = 0; i < num_sections; i++) {
+        uint32_t section_name;
+        uint64_t section_offset;
+        uint64_t section_size;
+
+        if (_pyi_utils_read_elf_section_header(fp, is_64bit, section_headers_offset + (uint64_t)i * section_header_size, &section_name, &section_offset, &section_size) < 0) {
+            return 0;
+        }
+        if ((uint64_t)section_name + sizeof(name) > strtab_size) {
+            continue;
+        }
+        if (pyi_fseek(fp, strtab_offset + section_name, SEEK_SET) < 0 || fread(name, sizeof(name), 1, fp) < 1) {
+            return 0;
+        }
+        if (memcmp(name, PYI_ELF_DATA_SECTION_NAME, sizeof(name)) == 0) {
+            if (section_offset > file_size || section_size > file_size - section_offset) {
+                return 0;
+            }
+            return section_offset + section_size;
+        }
+    }
+
+    return 0;
+}
+
+#endif /* defined(__linux__) */
+
+/* Maximum number of zero bytes between the end of appended data and the
+ * code signature that follows it. The signature data is aligned to 16
+ * bytes by macOS codesign, and to 8 bytes by Windows signtool. */
+#define PYI_SIGNATURE_PADDING_MAX 16
+
+#if defined(__APPLE__) || defined(_WIN32)
+
+/*
+ * Step back over the zero padding (of at most `max_padding` bytes) that
+ * precedes the given file offset, and return the offset at which the
+ * padding starts. The appended data itself always ends with non-zero
+ * MAGIC pattern.
+ */
+static uint64_t
+_pyi_utils_skip_zero_padding(FILE *fp, uint64_t offset, size_t max_padding)
+{
+    unsigned char buffer[PYI_SIGNATURE_PADDING_MAX];
+    size_t length = max_padding < sizeof(buffer) ? max_padding : sizeof(buffer);
+
+    if (length > offset) {
+        length = (size_t)offset;
+    }
+    if (length == 0 || pyi_fseek(fp, offset - length, SEEK_SET) < 0 || fread(buffer, length, 1, fp) < 1) {
+        return offset;
+    }
+    while (length > 0 && buffer[length - 1] == 0) {
+        length--;
+        offset--;
+    }
+    return offset;
+}
+
+#endif /* defined(__APPLE__) || defined(_WIN32) */
+
+#if defined(__APPLE__)
+
+/*
+ * Look up the code signature (LC_CODE_SIGNATURE load command) of the
+ * 64-bit Mach-O image that starts at the given file offset, and return
+ * the file offset of the signature data. Returns 0 if the image is not
+ * signed.
+ */
+static uint64_t
+_pyi_utils_find_macho_signature_offset(FILE *fp, uint64_t image_offset, uint64_t file_size)
+{
+    struct mach_header_64 header;
+    struct load_command command;
+    struct linkedit_data_command signature_command;
+    uint64_t command_offset;
+    uint32_t i;
+
+    if (pyi_fseek(fp, image_offset, SEEK_SET) < 0 || fread(&header, sizeof(header), 1, fp) < 1) {
+        return 0;
+    }
+    if (header.magic != MH_MAGIC_64) {
+        return 0;
+    }
+
+    command_offset = image_offset + sizeof(header);
+    for (i = 0; i < header.ncmds; i++) {
+        if (pyi_fseek(fp, command_offset, SEEK_SET) < 0 || fread(&command, sizeof(command), 1, fp) < 1) {
+            return 0;
+        }
+        if (command.cmd == LC_CODE_SIGNATURE) {
+            if (pyi_fseek(fp, command_offset, SEEK_SET) < 0 || fread(&signature_command, sizeof(signature_command), 1, fp) < 1) {
+                return 0;
+            }
+            if (signature_command.dataoff > file_size - image_offset) {
+                return 0;
+            }
+            return image_offset + signature_command.dataoff;
+        }
+        if (command.cmdsize < sizeof(command)) {
+            return 0;
+        }
+        command_offset += command.cmdsize;
+    }
+
+    return 0;
+}
+
+/*
+ * Look up the code signature of the signed (thin or fat) Mach-O file,
+ * and return the file offset at which the appended data ends. In a fat
+ * file, the data is appended to the last image. The data was made part
+ * of the __LINKEDIT segment at build time, and the code signature that
+ * was added afterwards follows it. Returns 0 if the file is not signed.
+ */
+static uint64_t
+_pyi_utils_find_macho_data_end(FILE *fp, uint64_t file_size)
+{
+    uint32_t magic;
+    uint64_t image_offset = 0;
+    uint64_t signature_offset;
+
+    if (pyi_fseek(fp, 0, SEEK_SET) < 0 || fread(&magic, sizeof(magic), 1, fp) < 1) {
+        return 0;
+    }
+
+    /* The header of a fat file is stored in big-endian byte order */
+    if (pyi_be32toh(magic) == FAT_MAGIC) {
+        struct fat_header fat_header;
+        struct fat_arch fat_arch;
+        uint32_t num_archs;
+        uint32_t i;
+
+        if (pyi_fseek(fp, 0, SEEK_SET) < 0 || fread(&fat_header, sizeof(fat_header), 1, fp) < 1) {
+            return 0;
+        }
+        num_archs = pyi_be32toh(fat_header.nfat_arch);
+        for (i = 0; i < num_archs; i++) {
+            if (fread(&fat_arch, sizeof(fat_arch), 1, fp) < 1) {
+                return 0;
+            }
+            if (pyi_be32toh(fat_arch.offset) > image_offset) {
+                image_offset = pyi_be32toh(fat_arch.offset);
+            }
+        }
+    } else if (magic != MH_MAGIC_64) {
+        return 0;
+    }
+
+    signature_offset = _pyi_utils_find_macho_signature_offset(fp, image_offset, file_size);
+    if (signature_offset == 0) {
+        return 0;
+    }
+    return _pyi_utils_skip_zero_padding(fp, signature_offset, PYI_SIGNATURE_PADDING_MAX);
+}
+
+#endif /* defined(__APPLE__) */
+
+#if defined(_WIN32)
+
+/*
+ * Look up the certificate table (Authenticode signature) of the signed
+ * PE file, and return the file offset at which the appended data ends.
+ * The signature is added at the end of the file, after the appended
+ * data, and the certificate table's data directory entry records its
+ * file offset (unlike other data directory entries, which record the
+ * relative virtual addresses). Returns 0 if the file is not signed.
+ */
+static uint64_t
+_pyi_utils_find_pe_data_end(FILE *fp, uint64_t file_size)
+{
+    IMAGE_DOS_HEADER dos_header;
+    DWORD nt_signature;
+    IMAGE_FILE_HEADER file_header;
+    WORD optional_header_magic;
+    uint64_t optional_header_offset;
+    uint64_t num_directories_offset;
+    uint64_t directories_offset;
+    DWORD num_directories;
+    IMAGE_DATA_DIRECTORY certificate_table;
+
+    if (pyi_fseek(fp, 0, SEEK_SET) < 0 || fread(&dos_header, sizeof(dos_header), 1, fp) < 1) {
+        return 0;
+    }
+    if (dos_header.e_magic != IMAGE_DOS_SIGNATURE || dos_header.e_lfanew <= 0) {
+        return 0;
+    }
+
+    if (pyi_fseek(fp, (uint64_t)dos_header.e_lfanew, SEEK_SET) < 0 ||
+        fread(&nt_signature, sizeof(nt_signature), 1, fp) < 1 ||
+        fread(&file_header, sizeof(file_header), 1, fp) < 1 ||
+        fread(&optional_header_magic, sizeof(optional_header_magic), 1, fp) < 1) {
+        return 0;
+    }
+    if (nt_signature != IMAGE_NT_SIGNATURE) {
+        return 0;
+    }
+
+    optional_header_offset = (uint64_t)dos_header.e_lfanew + sizeof(nt_signature) + sizeof(file_header);
+    if (optional_header_magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+        num_directories_offset = optional_header_offset + offsetof(IMAGE_OPTIONAL_HEADER64, NumberOfRvaAndSizes);
+        directories_offset = optional_header_offset + offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory);
+    } else if (optional_header_magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+        num_directories_offset = optional_header_offset + offsetof(IMAGE_OPTIONAL_HEADER32, NumberOfRvaAndSizes);
+        directories_offset = optional_header_offset + offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory);
+    } else {
+        return 0;
+    }
+
+    if (pyi_fseek(fp, num_directories_offset, SEEK_SET) < 0 || fread(&num_directories, sizeof(num_directories), 1, fp) < 1) {
+        return 0;
+    }
+    if (num_directories <= IMAGE_DIRECTORY_ENTRY_SECURITY) {
+        return 0;
+    }
+    if (pyi_fseek(fp, directories_offset + IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY), SEEK_SET) < 0 ||
+        fread(&certificate_table, sizeof(certificate_table), 1, fp) < 1) {
+        return 0;
+    }
+    if (certificate_table.VirtualAddress == 0 || certificate_table.Size == 0 || certificate_table.VirtualAddress > file_size) {
+        return 0;
+    }
+    return _pyi_utils_skip_zero_padding(fp, certificate_table.VirtualAddress, PYI_SIGNATURE_PADDING_MAX);
+}
+
+#endif /* defined(_WIN32) */
+
+/*
+ * Determine the file offset at which the data appended to the file by
+ * PyInstaller (PKG archive or PKG side-load signature) is expected to
+ * end. This is the end of file, unless the data is known to have been
+ * placed elsewhere:
+ *  - on Linux, the data is added to executable as an ELF section, which
+ *    is followed by the section header table;
+ *  - on macOS, the code signature of a signed executable follows the
+ *    data (LC_CODE_SIGNATURE load command);
+ *  - on Windows, the Authenticode signature of a signed executable
+ *    follows the data (certificate table data directory entry).
+ *
+ * This allows the caller to look for fixed-size trailer at the returned
+ * position, instead of scanning the file for the MAGIC pattern.
+ *
+ * Returns 0 on failure.
+ */
+uint64_t
+pyi_utils_find_appended_data_end(FILE *fp)
+{
+    uint64_t file_size;
+
+    if (pyi_fseek(fp, 0, SEEK_END) < 0) {
+        return 0;
+    }
+    file_size = pyi_ftell(fp);
+
+#if defined(__linux__)
+    {
+        unsigned char ident[EI_NIDENT];
+        uint64_t section_end = 0;
+
+        if (pyi_fseek(fp, 0, SEEK_SET) == 0 && fread(ident, sizeof(ident), 1, fp) == 1 &&
+            memcmp(ident, ELFMAG, SELFMAG) == 0) {
+    #if BYTE_ORDER == LITTLE_ENDIAN
+            const unsigned char native_data_encoding = ELFDATA2LSB;
+    #else
+            const unsigned char native_data_encoding = ELFDATA2MSB;
+    #endif
+            if (ident[EI_DATA] == native_data_encoding) {
+                if (ident[EI_CLASS] == ELFCLASS64 || ident[EI_CLASS] == ELFCLASS32) {
+                    section_end = _pyi_utils_find_elf_data_section_end(fp, ident[EI_CLASS] == ELFCLASS64, file_size);
+                }
+            }
+        }
+
+        if (section_end > 0) {
+            return section_end;
+        }
+    }
+#elif defined(__APPLE__)
+    {
+        uint64_t data_end = _pyi_utils_find_macho_data_end(fp, file_size);
+        if (data_end > 0) {
+            return data_end;
+        }
+    }
+#elif defined(_WIN32)
+    {
+        uint64_t data_end = _pyi_utils_find_pe_data_end(fp, file_size);
+        if (data_end > 0) {
+            return data_end;
+        }
+    }
+#endif
+
+    return file_size;
+}
@@ -33,12 +33,24 @@ int pyi_unsetenv(const char *variable);
 /* Temporary top-level application directory (onefile). */
 int pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx);
 
+/* Persistent extraction cache (onefile). */
+#ifndef _WIN32
+int pyi_open_extraction_cache(struct PYI_CONTEXT *pyi_ctx);
+int pyi_publish_extraction_cache(struct PYI_CONTEXT *pyi_ctx);
+void pyi_release_extraction_cache(struct PYI_CONTEXT *pyi_ctx);
+#endif
+
 /* Recursive directory deletion. */
 int pyi_recursive_rmdir(const char *dir);
+#ifndef _WIN32
+int pyi_recursive_rmdir_detached(const char *dir);
+#endif
 
 /* Misc. file/directory manipulation. */
 int pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *prefix_path, const char *filename);
+int pyi_create_directory_table(const struct PYI_CONTEXT *pyi_ctx, const char *prefix_path, const char *directory_table, size_t table_length);
 int pyi_copy_file(const char *src_filename, const char *dest_filename);
+int pyi_link_file(const char *src_filename, const char *dest_filename, bool allow_hardlink);
 
 /* Shared library loading. */
 pyi_dylib_t pyi_utils_dlopen(const char *filename);
@@ -62,6 +74,7 @@ char *const *pyi_prepend_dynamic_loader_to_argv(const int argc, char *const argv
 /* Magic pattern matching */
 extern const unsigned char MAGIC_BASE[8];
 uint64_t pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_len);
+uint64_t pyi_utils_find_appended_data_end(FILE *fp);
 
 /* Security descriptor for temporary directory (Windows only) */
 #if defined(_WIN32)
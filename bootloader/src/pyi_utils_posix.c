@@ -33,6 +33,15 @@
 #include <sys/wait.h>
 
 #include <dirent.h>
+#include <fcntl.h> /* openat, O_*, AT_* */
+#include <sys/file.h> /* flock */
+#include <time.h> /* nanosleep */
+#include <sys/resource.h> /* getrlimit */
+#if defined(__linux__)
+    #include <sys/syscall.h> /* syscall, __NR_syncfs */
+    #include <sys/vfs.h> /* statfs */
+    #include <sys/statvfs.h> /* statvfs, ST_* */
+#endif
 
 /*
  * On AIX  RTLD_MEMBER  flag is only visible when _ALL_SOURCE flag is defined.
@@ -62,6 +71,7 @@
 #include "pyi_utils.h"
 #include "pyi_path.h"
 #include "pyi_main.h"
+#include "pyi_archive.h"
 #include "pyi_apple_events.h"
 
 
@@ -129,14 +139,40 @@ mkdtemp(char *template)
 
 #endif /* !defined(HAVE_MKDTEMP) */
 
+/* Create the given directory path, including all missing parent
+ * directories, using the given mode. Errors are ignored; if we fail to
+ * create (a part of) the directory tree, the caller will catch the
+ * error when trying to use the directory. */
+static void
+_pyi_create_directory_path(const char *path, mode_t mode)
+{
+    char directory_tree_path[PYI_PATH_MAX];
+    char *subpath_cursor;
+
+    for(subpath_cursor = strchr(path, '/'); subpath_cursor != NULL; subpath_cursor = strchr(++subpath_cursor, '/')) {
+        int subpath_length = subpath_cursor - path;
+
+        /* Initial / in absolute path */
+        if (subpath_length == 0) {
+            continue;
+        }
+
+        snprintf(directory_tree_path, PYI_PATH_MAX, "%.*s", subpath_length, path);
+        PYI_DEBUG("LOADER: creating directory path component: %s\n", directory_tree_path);
+        mkdir(directory_tree_path, mode);
+    }
+
+    /* Create full path; necessary if the path did not end with path
+     * separator. */
+    PYI_DEBUG("LOADER: creating directory path: %s\n", path);
+    mkdir(path, mode);
+}
+
 /* Resolve the temporary directory specified by user via runtime_tmpdir
  * option, and create corresponding directory tree. */
 static char *
 _pyi_create_runtime_tmpdir(const char *runtime_tmpdir)
 {
-    char directory_tree_path[PYI_PATH_MAX];
-    char *subpath_cursor;
-
     /* Ensure runtime_tmpdir (and thus also its sub-path components)
      * do not exceed path limit. */
     if (strlen(runtime_tmpdir) >= PYI_PATH_MAX) {
@@ -155,23 +191,7 @@ _pyi_create_runtime_tmpdir(const char *runtime_tmpdir)
      * NOTE2: we ignore errors returned by mkdir; if we actually fail to
      * create (a part of) directory tree here, we will catch the error
      * when we try to resolve the full path to it later on. */
-    for(subpath_cursor = strchr(runtime_tmpdir, '/'); subpath_cursor != NULL; subpath_cursor = strchr(++subpath_cursor, '/')) {
-        int subpath_length = subpath_cursor - runtime_tmpdir;
-
-        /* Initial / in absolute path */
-        if (subpath_length == 0) {
-            continue;
-        }
-
-        snprintf(directory_tree_path, PYI_PATH_MAX, "%.*s", subpath_length, runtime_tmpdir);
-        PYI_DEBUG("LOADER: creating runtime-tmpdir path component: %s\n", directory_tree_path);
-        mkdir(directory_tree_path, 0777);
-    }
-
-    /* Create full path; necessary if runtime_tmpdir did not end with
-     * path separator. */
-    PYI_DEBUG("LOADER: creating runtime-tmpdir path: %s\n", runtime_tmpdir);
-    mkdir(runtime_tmpdir, 0777);
+    _pyi_create_directory_path(runtime_tmpdir, 0777);
 
     /* Now that directory exists, try to resolve full path to it. */
     return realpath(runtime_tmpdir, NULL); /* Let realpath allocate the buffer */
@@ -213,6 +233,232 @@ _pyi_format_and_create_tmpdir(char *tmpdir_path)
     return 0;
 }
 
+#if defined(__linux__)
+
+/* Magic number of tmpfs file system (TMPFS_MAGIC from linux/magic.h). */
+#define PYI_TMPFS_MAGIC 0x01021994
+
+#ifndef ST_NOEXEC
+    #define ST_NOEXEC 8 /* Not exposed by glibc without _GNU_SOURCE */
+#endif
+
+/* Read unsigned 64-bit value from a (sysfs/cgroupfs) file. Returns 0
+ * on success, 1 if file contains "max" (no limit), and -1 on error. */
+static int
+_pyi_read_uint64_from_file(const char *filename, uint64_t *value)
+{
+    char buffer[32];
+    char *end;
+    ssize_t length;
+    int fd;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return -1;
+    }
+    buffer[length] = 0;
+
+    if (strncmp(buffer, "max", 3) == 0) {
+        return 1;
+    }
+    errno = 0;
+    *value = strtoull(buffer, &end, 10);
+    if (errno != 0 || end == buffer) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Walk the cgroup hierarchy from the given group up to the root, and
+ * determine the smallest difference between memory limit and usage.
+ * Returns 0 on success, -1 if none of the groups has a memory limit. */
+static int
+_pyi_walk_cgroup_memory_limits(const char *root, char *cgroup_path, const char *limit_file, const char *usage_file, uint64_t *headroom)
+{
+    char filename[PYI_PATH_MAX];
+    uint64_t limit;
+    uint64_t usage;
+    int found = 0;
+
+    for (;;) {
+        char *separator;
+
+        /* In cgroup v1, absence of the limit is denoted by a very large
+         * value instead of "max". */
+        snprintf(filename, PYI_PATH_MAX, "%s%s/%s", root, cgroup_path, limit_file);
+        if (_pyi_read_uint64_from_file(filename, &limit) == 0 && limit < ((uint64_t)1 << 62)) {
+            snprintf(filename, PYI_PATH_MAX, "%s%s/%s", root, cgroup_path, usage_file);
+            if (_pyi_read_uint64_from_file(filename, &usage) == 0) {
+                uint64_t group_headroom = (limit > usage) ? limit - usage : 0;
+                if (!found || group_headroom < *headroom) {
+                    *headroom = group_headroom;
+                }
+                found = 1;
+            }
+        }
+
+        /* Parent group */
+        separator = strrchr(cgroup_path, '/');
+        if (separator == NULL || cgroup_path[0] == 0) {
+            break;
+        }
+        *separator = 0;
+    }
+
+    return found ? 0 : -1;
+}
+
+/* Determine the amount of memory that can still be allocated by this
+ * process' cgroup; the pages of files on tmpfs are charged to the
+ * cgroup of the process that writes them. The limits of all ancestor
+ * groups are taken into account. Returns 0 on success, and -1 if the
+ * memory is not limited (or if the limit cannot be determined). */
+static int
+_pyi_get_cgroup_memory_headroom(uint64_t *headroom)
+{
+    char cgroup_v1_path[PYI_PATH_MAX];
+    char cgroup_v2_path[PYI_PATH_MAX];
+    char line[PYI_PATH_MAX];
+    FILE *fp;
+
+    /* Find the paths of process' groups; in /proc/self/cgroup, the group
+     * in the unified (v2) hierarchy is listed as "0::<path>", and the
+     * group in the v1 memory controller hierarchy as "<id>:memory:<path>". */
+    cgroup_v1_path[0] = 0;
+    cgroup_v2_path[0] = 0;
+    fp = fopen("/proc/self/cgroup", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *controllers = strchr(line, ':');
+        char *path = controllers ? strchr(controllers + 1, ':') : NULL;
+
+        if (path == NULL) {
+            continue;
+        }
+        *path++ = 0;
+        *controllers++ = 0;
+        path[strcspn(path, "\n")] = 0;
+
+        if (strcmp(path, "/") == 0) {
+            path = ""; /* Root group */
+        }
+        if (strncmp(line, "0", 2) == 0 && controllers[0] == 0) {
+            snprintf(cgroup_v2_path, PYI_PATH_MAX, "%s", path);
+        } else if (strcmp(controllers, "memory") == 0) {
+            snprintf(cgroup_v1_path, PYI_PATH_MAX, "%s", path);
+        }
+    }
+    fclose(fp);
+
+    if (_pyi_walk_cgroup_memory_limits("/sys/fs/cgroup", cgroup_v2_path, "memory.max", "memory.current", headroom) == 0) {
+        return 0;
+    }
+    if (_pyi_walk_cgroup_memory_limits("/sys/fs/cgroup/memory", cgroup_v1_path, "memory.limit_in_bytes", "memory.usage_in_bytes", headroom) == 0) {
+        return 0;
+    }
+
+    return -1;
+}
+
+/* Compute total uncompressed size of extractable archive entries. */
+static uint64_t
+_pyi_get_extraction_payload_size(const struct ARCHIVE *archive)
+{
+    const struct ARCHIVE_ENTRY_LIST *extractable_entries = &archive->entry_groups[ARCHIVE_GROUP_EXTRACTABLE];
+    uint64_t payload_size = 0;
+    size_t i;
+
+    for (i = 0; i < extractable_entries->count; i++) {
+        payload_size += extractable_entries->entries[i]->uncompressed_length;
+    }
+
+    return payload_size;
+}
+
+/* Try to create the application's temporary directory on a memory-backed
+ * (tmpfs) file system. The candidate locations ($XDG_RUNTIME_DIR, which
+ * is private to the user, and /dev/shm) must be on tmpfs, mounted
+ * writable and without noexec flag (as extension modules and shared
+ * libraries are loaded from the directory). As the application keeps
+ * running while its files occupy the memory, the payload (the total
+ * size of extracted files) may use up only half of the free space on
+ * the file system and half of the memory that can still be allocated
+ * within the process' cgroup memory limit. Returns 0 on success, -1 if
+ * no suitable location was found. */
+static int
+_pyi_create_memory_backed_tmpdir(struct PYI_CONTEXT *pyi_ctx)
+{
+    const char *candidate_dirs[] = {
+        NULL, /* $XDG_RUNTIME_DIR */
+        "/dev/shm"
+    };
+
+    char *xdg_runtime_dir;
+    uint64_t payload_size;
+    uint64_t cgroup_headroom;
+    int i;
+    int rc = -1;
+
+    payload_size = _pyi_get_extraction_payload_size(pyi_ctx->archive);
+    PYI_DEBUG("LOADER: total size of files to extract: %llu bytes\n", (unsigned long long)payload_size);
+
+    if (_pyi_get_cgroup_memory_headroom(&cgroup_headroom) == 0) {
+        PYI_DEBUG("LOADER: memory available within cgroup limit: %llu bytes\n", (unsigned long long)cgroup_headroom);
+        if (payload_size > cgroup_headroom / 2) {
+            PYI_DEBUG("LOADER: files do not fit into memory within cgroup limit!\n");
+            return -1;
+        }
+    }
+
+    xdg_runtime_dir = pyi_getenv("XDG_RUNTIME_DIR");
+    candidate_dirs[0] = xdg_runtime_dir;
+
+    for (i = 0; i < sizeof(candidate_dirs)/sizeof(candidate_dirs[0]); i++) {
+        struct statfs statfs_buf;
+        struct statvfs statvfs_buf;
+        uint64_t free_space;
+
+        if (candidate_dirs[i] == NULL) {
+            continue;
+        }
+
+        if (statfs(candidate_dirs[i], &statfs_buf) < 0 || statfs_buf.f_type != PYI_TMPFS_MAGIC) {
+            PYI_DEBUG("LOADER: %s is not on tmpfs.\n", candidate_dirs[i]);
+            continue;
+        }
+        if (statvfs(candidate_dirs[i], &statvfs_buf) < 0 || (statvfs_buf.f_flag & (ST_NOEXEC | ST_RDONLY))) {
+            PYI_DEBUG("LOADER: %s is mounted read-only or with noexec flag.\n", candidate_dirs[i]);
+            continue;
+        }
+        free_space = (uint64_t)statvfs_buf.f_bavail * statvfs_buf.f_frsize;
+        if (payload_size > free_space / 2) {
+            PYI_DEBUG("LOADER: not enough free space on %s (%llu bytes).\n", candidate_dirs[i], (unsigned long long)free_space);
+            continue;
+        }
+
+        if (snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s", candidate_dirs[i]) >= PYI_PATH_MAX) {
+            continue;
+        }
+        if (_pyi_format_and_create_tmpdir(pyi_ctx->application_home_dir) == 0) {
+            PYI_DEBUG("LOADER: using memory-backed temporary directory: %s\n", pyi_ctx->application_home_dir);
+            rc = 0;
+            break;
+        }
+    }
+
+    free(xdg_runtime_dir);
+    return rc;
+}
+
+#endif /* defined(__linux__) */
+
 int
 pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
 {
@@ -253,6 +499,18 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
         return _pyi_format_and_create_tmpdir(pyi_ctx->application_home_dir);
     }
 
+    /* If requested by the run-time temporary directory policy, prefer
+     * memory-backed file system, if the files fit into it. Otherwise,
+     * fall back to the standard locations. */
+#if defined(__linux__)
+    if (pyi_ctx->runtime_tmpdir_policy != NULL && strcmp(pyi_ctx->runtime_tmpdir_policy, "prefer-memory") == 0) {
+        if (_pyi_create_memory_backed_tmpdir(pyi_ctx) == 0) {
+            return 0;
+        }
+        PYI_DEBUG("LOADER: memory-backed temporary directory is not available; using standard location.\n");
+    }
+#endif
+
     /* Check the standard environment variables */
     for (i = 0; i < sizeof(candidate_env_vars)/sizeof(candidate_env_vars[0]); i++) {
         char *env_var_value = pyi_getenv(candidate_env_vars[i]);
@@ -287,74 +545,479 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
 
 
 /**********************************************************************\
- *                  Recursive removal of a directory                  *
+ *           Persistent extraction cache (onefile)                    *
 \**********************************************************************/
+/* Name of the marker file, which is placed into the cache directory
+ * once the application is fully extracted. It contains the archive
+ * hash. */
+#define EXTRACTION_CACHE_MARKER ".pyi-ready"
+
+/* Length of the archive hash (hex digest of SHA-256). */
+#define EXTRACTION_CACHE_HASH_LENGTH 64
+
+/* Resolve the (user-specified or default) path to extraction cache
+ * directory, create the directory if necessary, and resolve its full
+ * path. Returns realpath-allocated string or NULL on failure. */
+static char *
+_pyi_resolve_extraction_cache_dir(const char *extraction_cache_dir)
+{
+    char cache_dir[PYI_PATH_MAX];
+    char *env_var_value;
+    int ret;
+
+    if (extraction_cache_dir[0] != 0) {
+        ret = snprintf(cache_dir, PYI_PATH_MAX, "%s", extraction_cache_dir);
+    } else {
+#if defined(__APPLE__)
+        /* ~/Library/Caches/pyinstaller */
+        env_var_value = pyi_getenv("HOME");
+        if (env_var_value == NULL) {
+            return NULL;
+        }
+        ret = snprintf(cache_dir, PYI_PATH_MAX, "%s/Library/Caches/pyinstaller", env_var_value);
+#else
+        /* $XDG_CACHE_HOME/pyinstaller or ~/.cache/pyinstaller */
+        env_var_value = pyi_getenv("XDG_CACHE_HOME");
+        if (env_var_value != NULL) {
+            ret = snprintf(cache_dir, PYI_PATH_MAX, "%s/pyinstaller", env_var_value);
+        } else {
+            env_var_value = pyi_getenv("HOME");
+            if (env_var_value == NULL) {
+                return NULL;
+            }
+            ret = snprintf(cache_dir, PYI_PATH_MAX, "%s/.cache/pyinstaller", env_var_value);
+        }
+#endif
+        free(env_var_value);
+    }
+    if (ret >= PYI_PATH_MAX) {
+        return NULL;
+    }
+
+    /* Unlike the runtime-tmpdir, the cache directory is private to
+     * the current user. */
+    _pyi_create_directory_path(cache_dir, 0700);
+
+    return realpath(cache_dir, NULL); /* Let realpath allocate the buffer */
+}
+
+/* Check the existing application directory in the cache. Returns 1 if
+ * the directory is ready for use: it is owned by the current user and
+ * not writable by others (so that its contents cannot have been tampered
+ * with), and contains the marker with matching archive hash. Returns 0
+ * if the directory is valid, but not (yet) marked as ready, and -1 if
+ * the directory does not exist or is invalid. */
+static int
+_pyi_check_extraction_cache_dir(const char *cache_path, const char *archive_hash)
+{
+    char marker_path[PYI_PATH_MAX];
+    char marker_data[EXTRACTION_CACHE_HASH_LENGTH + 1];
+    struct stat stat_buf;
+    ssize_t marker_length;
+    int fd;
+
+    if (lstat(cache_path, &stat_buf) < 0) {
+        return -1;
+    }
+    if (!S_ISDIR(stat_buf.st_mode) || stat_buf.st_uid != geteuid() || (stat_buf.st_mode & (S_IWGRP | S_IWOTH))) {
+        PYI_DEBUG("LOADER: extraction cache directory %s has invalid type, owner, or permissions!\n", cache_path);
+        return -1;
+    }
+
+    if (snprintf(marker_path, PYI_PATH_MAX, "%s/%s", cache_path, EXTRACTION_CACHE_MARKER) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    fd = open(marker_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    marker_length = read(fd, marker_data, sizeof(marker_data));
+    close(fd);
+
+    if (marker_length != EXTRACTION_CACHE_HASH_LENGTH || memcmp(marker_data, archive_hash, EXTRACTION_CACHE_HASH_LENGTH) != 0) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Acquire exclusive lock on the given file descriptor, waiting for at
+ * most the given number of seconds. flock() does not support timeouts,
+ * so the non-blocking lock attempt is repeated in short intervals.
+ * Returns 0 on success, -1 on timeout or error. */
+static int
+_pyi_lock_with_timeout(int fd, unsigned int timeout)
+{
+    const struct timespec interval = { 0, 20 * 1000 * 1000 }; /* 20 ms */
+    unsigned long remaining_attempts = (unsigned long)timeout * 50;
+
+    while (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EWOULDBLOCK || remaining_attempts == 0) {
+            return -1;
+        }
+        remaining_attempts--;
+        nanosleep(&interval, NULL);
+    }
+
+    return 0;
+}
+
+/*
+ * Set up the application's top-level directory in the persistent
+ * extraction cache. The directory is identified by the archive hash.
+ *
+ * If the directory exists and is marked as ready, it is used as-is
+ * (PYI_EXTRACTION_CACHE_READY). Otherwise, this process tries to take
+ * the exclusive lock on the lock file that accompanies the directory;
+ * the lock is held by the process that populates the directory. If
+ * many instances of the application are started at the same time, the
+ * first one populates the directory, while the others wait for the
+ * lock, and then use the populated directory. Once the lock is taken,
+ * a directory that is still not marked as ready is a left-over from an
+ * instance that was terminated during extraction; it is removed. The
+ * directory is then (re)created, and this process is responsible for
+ * populating it (PYI_EXTRACTION_CACHE_POPULATE); the lock is kept until
+ * pyi_release_extraction_cache() is called.
+ *
+ * Returns 0 on success, and -1 if the cache cannot be used (including
+ * when the lock cannot be obtained within the timeout); in that case,
+ * the caller should fall back to the temporary directory.
+ */
 int
-pyi_recursive_rmdir(const char *dir_path)
+pyi_open_extraction_cache(struct PYI_CONTEXT *pyi_ctx)
+{
+    char lock_path[PYI_PATH_MAX];
+    char *cache_dir;
+    size_t i;
+    int lock_fd;
+    int ret;
+
+    /* Validate the archive hash; it is used as directory name, so
+     * it must consist of hex digits only. */
+    if (pyi_ctx->archive_hash == NULL || strlen(pyi_ctx->archive_hash) != EXTRACTION_CACHE_HASH_LENGTH) {
+        PYI_DEBUG("LOADER: archive hash is missing or invalid!\n");
+        return -1;
+    }
+    for (i = 0; i < EXTRACTION_CACHE_HASH_LENGTH; i++) {
+        if (!strchr("0123456789abcdef", pyi_ctx->archive_hash[i])) {
+            PYI_DEBUG("LOADER: archive hash is missing or invalid!\n");
+            return -1;
+        }
+    }
+
+    cache_dir = _pyi_resolve_extraction_cache_dir(pyi_ctx->extraction_cache_dir);
+    if (cache_dir == NULL) {
+        PYI_DEBUG("LOADER: failed to create or resolve extraction cache directory!\n");
+        return -1;
+    }
+    ret = snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s/%s", cache_dir, pyi_ctx->archive_hash);
+    free(cache_dir);
+    if (ret >= PYI_PATH_MAX) {
+        return -1;
+    }
+
+    /* Fast path: directory is already populated; no locking needed,
+     * because ready directories are never modified. */
+    if (_pyi_check_extraction_cache_dir(pyi_ctx->application_home_dir, pyi_ctx->archive_hash) == 1) {
+        PYI_DEBUG("LOADER: using extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+        pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_READY;
+        return 0;
+    }
+
+    /* Take the lock; if another instance is populating the directory,
+     * this waits until it is done. */
+    if (snprintf(lock_path, PYI_PATH_MAX, "%s.lock", pyi_ctx->application_home_dir) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    lock_fd = open(lock_path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (lock_fd < 0) {
+        PYI_DEBUG("LOADER: failed to open extraction cache lock file %s!\n", lock_path);
+        return -1;
+    }
+    PYI_DEBUG("LOADER: acquiring extraction cache lock (timeout: %u s)...\n", pyi_ctx->extraction_cache_timeout);
+    if (_pyi_lock_with_timeout(lock_fd, pyi_ctx->extraction_cache_timeout) < 0) {
+        PYI_DEBUG("LOADER: failed to acquire extraction cache lock!\n");
+        close(lock_fd);
+        return -1;
+    }
+
+    /* Re-check the directory under the lock */
+    ret = _pyi_check_extraction_cache_dir(pyi_ctx->application_home_dir, pyi_ctx->archive_hash);
+    if (ret == 1) {
+        PYI_DEBUG("LOADER: using extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+        pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_READY;
+        close(lock_fd); /* Releases the lock */
+        return 0;
+    }
+    if (ret == 0) {
+        PYI_DEBUG("LOADER: removing stale extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+        pyi_recursive_rmdir(pyi_ctx->application_home_dir);
+    }
+
+    /* Create the directory; this process is now responsible for its
+     * population. */
+    if (mkdir(pyi_ctx->application_home_dir, 0700) < 0) {
+        PYI_DEBUG("LOADER: failed to create extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+        close(lock_fd);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: created extraction cache directory: %s\n", pyi_ctx->application_home_dir);
+    pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_POPULATE;
+    pyi_ctx->extraction_cache_lock_fd = lock_fd;
+    return 0;
+}
+
+/*
+ * Mark the populated application directory in the extraction cache as
+ * ready, by placing the marker file into it. The marker is written
+ * under a temporary name, and renamed into place, so that it appears
+ * atomically, with complete contents.
+ *
+ * If the marker cannot be written, the directory is removed and the
+ * lock is released, so that other instances of the application do not
+ * keep waiting for it; the caller needs to fall back to extraction into
+ * a temporary directory.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+pyi_publish_extraction_cache(struct PYI_CONTEXT *pyi_ctx)
+{
+    const char *temp_marker_name = EXTRACTION_CACHE_MARKER ".tmp";
+    int dir_fd;
+    int fd;
+    int rc = -1;
+
+    dir_fd = open(pyi_ctx->application_home_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        goto cleanup;
+    }
+
+    /* Ensure that the extracted files are written to disk before the
+     * directory is marked as ready; otherwise, a system crash might
+     * leave behind a directory with incomplete files that would be
+     * used by all subsequent runs. */
+#if defined(__linux__) && defined(__NR_syncfs)
+    syscall(__NR_syncfs, dir_fd);
+#endif
+
+    fd = openat(dir_fd, temp_marker_name, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        goto cleanup;
+    }
+    if (write(fd, pyi_ctx->archive_hash, EXTRACTION_CACHE_HASH_LENGTH) != EXTRACTION_CACHE_HASH_LENGTH || fsync(fd) < 0) {
+        close(fd);
+        unlinkat(dir_fd, temp_marker_name, 0);
+        goto cleanup;
+    }
+    close(fd);
+
+    if (renameat(dir_fd, temp_marker_name, dir_fd, EXTRACTION_CACHE_MARKER) < 0) {
+        unlinkat(dir_fd, temp_marker_name, 0);
+        goto cleanup;
+    }
+
+    PYI_DEBUG("LOADER: marked extraction cache directory as ready: %s\n", pyi_ctx->application_home_dir);
+    rc = 0;
+
+cleanup:
+    if (dir_fd >= 0) {
+        close(dir_fd);
+    }
+    if (rc < 0) {
+        pyi_recursive_rmdir(pyi_ctx->application_home_dir);
+        pyi_release_extraction_cache(pyi_ctx);
+    }
+    return rc;
+}
+
+/*
+ * Release the extraction cache lock that was taken in
+ * pyi_open_extraction_cache() for population of the directory.
+ */
+void
+pyi_release_extraction_cache(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (pyi_ctx->extraction_cache_lock_fd >= 0) {
+        close(pyi_ctx->extraction_cache_lock_fd); /* Releases the lock */
+        pyi_ctx->extraction_cache_lock_fd = -1;
+    }
+}
+
+
+/**********************************************************************\
+ *                  Recursive removal of a directory                  *
+\**********************************************************************/
+/*
+ * Recursively remove the directory with the given name, relative to the
+ * parent directory's file descriptor. The directory is traversed via
+ * its own file descriptor, so no path strings need to be constructed;
+ * the type of each entry is taken from the d_type field of directory
+ * entry (where available), so an lstat() call is required only if the
+ * file system does not provide the type.
+ */
+static int
+_pyi_recursive_rmdir_at(int parent_fd, const char *dir_name)
 {
     DIR *dir_handle;
     struct dirent *dir_entry;
-    struct stat stat_buf;
-    int dir_path_length;
-    int buffer_size;
-    char entry_path[PYI_PATH_MAX];
-
-    /* Make a copy of directory path (and append a path separator), into
-     * mutable buffer that we will use to construct entries' full paths.
-     * Store the length of the directory path string; this allows us to
-     * overwrite only the sub-component part of the string, without having
-     * to copy the directory path each time. */
-    dir_path_length = snprintf(entry_path, PYI_PATH_MAX, "%s%c", dir_path, PYI_SEP);
-    if (dir_path_length >= PYI_PATH_MAX) {
+    int dir_fd;
+
+    /* Open the directory; O_NOFOLLOW prevents recursion into symlinked
+     * directories. */
+    dir_fd = openat(parent_fd, dir_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dir_fd < 0) {
         return -1;
     }
-    buffer_size = PYI_PATH_MAX - dir_path_length; /* Remaining buffer size */
-
-    /* Open the directory */
-    dir_handle = opendir(dir_path);
+    dir_handle = fdopendir(dir_fd);
     if (dir_handle == NULL) {
+        close(dir_fd);
         return -1;
     }
 
     /* Iterate over directory contents */
     for (dir_entry = readdir(dir_handle); dir_entry != NULL; dir_entry = readdir(dir_handle))
     {
+        bool is_dir;
+
         /* Skip . and .. */
         if (strcmp(dir_entry->d_name, ".") == 0 || strcmp(dir_entry->d_name, "..") == 0) {
             continue;
         }
 
-        /* Construct the full path, by overwriting the part of string
-         * that starts after path directory and separator. */
-        if (snprintf(entry_path + dir_path_length, buffer_size, "%s", dir_entry->d_name) >= buffer_size) {
-            continue;
+        /* Determine the type of entry. Use fstatat() with the
+         * AT_SYMLINK_NOFOLLOW flag instead of stat() in order to prevent
+         * recursion into symlinked directories. */
+#if defined(DT_DIR) && defined(DT_UNKNOWN)
+        if (dir_entry->d_type != DT_UNKNOWN) {
+            is_dir = dir_entry->d_type == DT_DIR;
+        } else
+#endif
+        {
+            struct stat stat_buf;
+            if (fstatat(dir_fd, dir_entry->d_name, &stat_buf, AT_SYMLINK_NOFOLLOW) < 0) {
+                continue;
+            }
+            is_dir = S_ISDIR(stat_buf.st_mode);
         }
 
-        /* Deteremine the type of entry, and remove it. Use lstat()
-         * instead of stat() in order to prevent recursion into symlinked
-         * directories. On errors, emit debug messages to simplify
+        /* Remove the entry. On errors, emit debug messages to simplify
          * debugging, and keep going on. We want to remove everything we
          * can; if we fail to remove an entry here, we will also fail
          * to remove the top-level directory, and will return error
          * there and then. */
-        if (lstat(entry_path, &stat_buf) == 0) {
-            if (S_ISDIR(stat_buf.st_mode) ) {
-                /* Recurse into sub-directory */
-                if (pyi_recursive_rmdir(entry_path) < 0) {
-                    PYI_DEBUG("LOADER: failed to remove directory: %s\n", entry_path);
-                }
-            } else {
-                if (unlink(entry_path) < 0) {
-                    PYI_DEBUG("LOADER: failed to remove file: %s\n", entry_path);
-                }
+        if (is_dir) {
+            /* Recurse into sub-directory */
+            if (_pyi_recursive_rmdir_at(dir_fd, dir_entry->d_name) < 0) {
+                PYI_DEBUG("LOADER: failed to remove directory: %s\n", dir_entry->d_name);
+            }
+        } else {
+            if (unlinkat(dir_fd, dir_entry->d_name, 0) < 0) {
+                PYI_DEBUG("LOADER: failed to remove file: %s\n", dir_entry->d_name);
+            }
+        }
+    }
+    closedir(dir_handle); /* Also closes dir_fd */
+
+    /* Finally, remove the directory itself. */
+    return unlinkat(parent_fd, dir_name, AT_REMOVEDIR);
+}
+
+int
+pyi_recursive_rmdir(const char *dir_path)
+{
+    return _pyi_recursive_rmdir_at(AT_FDCWD, dir_path);
+}
+
+/*
+ * Close all file descriptors above the standard streams; uses the
+ * close_range() system call if available (Linux 5.9+), and falls back
+ * to closing the descriptors one by one, up to the limit.
+ */
+static void
+_pyi_close_inherited_fds(void)
+{
+    struct rlimit limit;
+    rlim_t max_fd = 1024;
+    rlim_t fd;
+
+#if defined(__linux__) && defined(__NR_close_range)
+    if (syscall(__NR_close_range, STDERR_FILENO + 1, ~0U, 0U) == 0) {
+        return;
+    }
+#endif
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        max_fd = limit.rlim_cur;
+    }
+    for (fd = STDERR_FILENO + 1; fd < max_fd; fd++) {
+        close((int)fd);
+    }
+}
+
+/*
+ * Hand the recursive removal of the directory off to a detached reaper
+ * process, so that the calling process does not need to wait for the
+ * removal to complete. The reaper is a grandchild of the calling process
+ * (the intermediate child exits immediately), runs in its own session,
+ * and has its standard streams redirected to /dev/null and all other
+ * inherited file descriptors closed, so that it does not keep the
+ * caller's pipes (or the archive) open. Errors that occur during removal are
+ * not reported.
+ *
+ * Returns 0 if removal was handed off to the reaper process, and -1 if
+ * the reaper process could not be started; in the latter case, the
+ * caller should remove the directory itself.
+ */
+int
+pyi_recursive_rmdir_detached(const char *dir_path)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Intermediate child process: start the reaper, and exit. */
+        pid_t reaper_pid;
+        int null_fd;
+
+        setsid();
+        reaper_pid = fork();
+        if (reaper_pid != 0) {
+            _exit(reaper_pid < 0 ? 1 : 0);
+        }
+
+        /* Reaper process */
+        null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd > STDERR_FILENO) {
+                close(null_fd);
             }
         }
+        _pyi_close_inherited_fds();
+        pyi_recursive_rmdir(dir_path);
+        _exit(0);
     }
-    closedir(dir_handle);
 
-    /* Finally, remove the directory; the return value of rmdir (0 on
-     * success, -1 on error) maps directly to this function's return. */
-    return rmdir(dir_path);
+    /* Wait for the intermediate child process, which exits immediately
+     * after forking the reaper. */
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
 }
 
 
@@ -0,0 +1,83 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2024, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Verify the data files that were extracted by the onefile bootloader; see `pyi_onefile_extraction.spec`.
+
+import argparse
+import hashlib
+import json
+import os
+import sys
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--expect-diskless", action="store_true", help="Expect files in memory-backed files.")
+parser.add_argument("--expect-cache", default=None, help="Expect the application directory in the given cache.")
+parser.add_argument("--expect-tmpdir", default=None, help="Expect the application directory in the given directory.")
+parser.add_argument("--deferred", action="store_true", help="Access the files while the extraction may be pending.")
+parser.add_argument("--meipass-file", default=None, help="Write the path of the application directory to the file.")
+options = parser.parse_args()
+
+if options.meipass_file:
+    with open(options.meipass_file, 'w', encoding='utf-8') as fp:
+        fp.write(sys._MEIPASS)
+
+if options.expect_diskless:
+    # The files are available only via the manifest of memory-backed files.
+    assert hasattr(sys, '_pyi_memfd_files'), "Diskless mode is not active!"
+    assert not os.path.exists(os.path.join(sys._MEIPASS, 'extraction_manifest.json'))
+    file_paths = sys._pyi_memfd_files
+else:
+    assert not hasattr(sys, '_pyi_memfd_files')
+    file_paths = None
+
+if options.expect_cache:
+    cache_dir = os.path.realpath(options.expect_cache)
+    assert os.path.realpath(sys._MEIPASS).startswith(os.path.join(cache_dir, '')), \
+        f"Application directory {sys._MEIPASS!r} is not in extraction cache {cache_dir!r}!"
+
+if options.expect_tmpdir:
+    assert os.path.dirname(os.path.realpath(sys._MEIPASS)) == os.path.realpath(options.expect_tmpdir), \
+        f"Application directory {sys._MEIPASS!r} is not in {options.expect_tmpdir!r}!"
+
+
+def _get_path(name):
+    if file_paths is not None:
+        return file_paths[name]
+    return os.path.join(sys._MEIPASS, *name.split('/'))
+
+
+# With deferred extraction, the data files might not be extracted yet; opening them waits for them.
+if options.deferred:
+    assert callable(sys._pyi_wait_for_extraction)
+    with open(_get_path('data/text_31.txt'), 'rb') as fp:
+        assert fp.read()
+    with open(_get_path('data/sub/deep/random.bin'), 'rb') as fp:
+        assert len(fp.read()) == 1024 * 1024
+    # Opening a file that is not part of the application fails right away.
+    try:
+        open(os.path.join(sys._MEIPASS, 'data', 'missing.txt'), 'rb')
+    except FileNotFoundError:
+        pass
+    else:
+        assert False, "Opened a file that does not exist!"
+    # Listing a directory waits for the deferred files below it.
+    assert len(os.listdir(os.path.join(sys._MEIPASS, 'data'))) == 32 + 5
+    sys._pyi_wait_for_extraction()
+    assert not os.path.exists(os.path.join(sys._MEIPASS, '.pyi-deferred'))
+
+with open(_get_path('extraction_manifest.json'), 'r', encoding='utf-8') as fp:
+    manifest = json.load(fp)
+
+for name, digest in manifest.items():
+    with open(_get_path(name), 'rb') as fp:
+        assert hashlib.sha256(fp.read()).hexdigest() == digest, f"Contents of {name!r} do not match!"
+
+print(f"Verified {len(manifest)} files.")
@@ -0,0 +1,39 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2024, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+import os
+import sys
+
+import _ssl
+import multipackage_test_pkg
+
+multipackage_test_pkg.test_function()
+
+# The shared files are linked (or copied) from the directory of the onedir dependency into the temporary directory of
+# this onefile application; verify that their contents match the originals.
+dependency_dir = os.path.join(os.path.dirname(sys.executable), 'multipackage6_B')
+if os.path.isdir(os.path.join(dependency_dir, '_internal')):
+    dependency_dir = os.path.join(dependency_dir, '_internal')
+
+shared_files = [
+    os.path.join('multipackage_test_pkg', 'data', 'secret.txt'),
+    os.path.relpath(_ssl.__file__, sys._MEIPASS),
+]
+for name in shared_files:
+    extracted_file = os.path.join(sys._MEIPASS, name)
+    original_file = os.path.join(dependency_dir, name)
+    print(f"Comparing {extracted_file!r} to {original_file!r}...")
+    with open(extracted_file, 'rb') as fp:
+        extracted_data = fp.read()
+    with open(original_file, 'rb') as fp:
+        original_data = fp.read()
+    assert extracted_data == original_data, f"Contents of {name!r} do not match!"
+    print(f"Hard-linked: {os.path.samefile(extracted_file, original_file)}")
@@ -0,0 +1,104 @@
+# -*- mode: python ; coding: utf-8 -*-
+#-----------------------------------------------------------------------------
+# Copyright (c) 2024, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Onefile build with a set of generated data files, used to test the extraction-related EXE options. The options are
+# passed to the spec file after `--`; the data files and their expected SHA-256 digests (stored in the collected
+# `extraction_manifest.json` file) are generated into the work path.
+import argparse
+import hashlib
+import json
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--store-data", action="store_true", help="Store all entries uncompressed.")
+parser.add_argument("--pkg-data-alignment", type=int, default=0)
+parser.add_argument("--pkg-uncompressed-binaries", action="store_true")
+parser.add_argument("--pkg-checksums", action="store_true")
+parser.add_argument("--runtime-tmpdir-policy", default=None)
+parser.add_argument("--extraction-cache", default=None, help="Path to the extraction cache directory.")
+parser.add_argument("--diskless", action="store_true")
+parser.add_argument("--deferred-extraction", action="store_true")
+parser.add_argument("--prewarm", action="store_true")
+parser.add_argument("--startup-order", action="store_true", help="Order the PKG according to a startup profile.")
+options = parser.parse_args()
+
+data_dir = os.path.join(workpath, 'extraction-data')
+os.makedirs(data_dir, exist_ok=True)
+
+
+def _random_bytes(seed, length):
+    # Deterministic, incompressible data.
+    data = bytearray()
+    block = seed.encode('utf-8')
+    while len(data) < length:
+        block = hashlib.sha256(block).digest()
+        data += block
+    return bytes(data[:length])
+
+
+data_files = {}
+for i in range(32):
+    data_files[f'data/text_{i}.txt'] = f'Text file #{i}\n'.encode('utf-8') * (i * 200 + 1)
+data_files['data/sub/deep/random.bin'] = _random_bytes('random', 1024 * 1024)
+data_files['data/aligned.bin'] = _random_bytes('aligned', 64 * 1024)
+# Identical contents, stored in the PKG only once.
+data_files['data/duplicate_a.bin'] = _random_bytes('duplicate', 256 * 1024)
+data_files['data/duplicate_b.bin'] = data_files['data/duplicate_a.bin']
+data_files['data/empty.txt'] = b''
+
+datas = []
+for name, content in data_files.items():
+    src_name = os.path.join(data_dir, *name.split('/'))
+    os.makedirs(os.path.dirname(src_name), exist_ok=True)
+    with open(src_name, 'wb') as fp:
+        fp.write(content)
+    datas.append((src_name, os.path.dirname(name)))
+
+manifest_file = os.path.join(data_dir, 'extraction_manifest.json')
+with open(manifest_file, 'w', encoding='utf-8') as fp:
+    json.dump({name: hashlib.sha256(content).hexdigest() for name, content in data_files.items()}, fp)
+datas.append((manifest_file, '.'))
+
+startup_order = None
+if options.startup_order:
+    startup_order = os.path.join(data_dir, 'startup_profile.txt')
+    with open(startup_order, 'w', encoding='utf-8') as fp:
+        fp.write("# PyInstaller startup profile\n")
+        fp.write("extraction_manifest.json\ndata/text_3.txt\ndata/sub/deep/random.bin\n")
+
+a = Analysis(
+    [os.path.join(os.path.dirname(SPECPATH), 'scripts', 'pyi_onefile_extraction.py')],
+    datas=datas,
+    noarchive=False,
+)
+pyz = PYZ(a.pure)
+
+exe = EXE(
+    pyz,
+    a.scripts,
+    a.binaries,
+    a.datas,
+    [],
+    name='pyi_onefile_extraction',
+    debug=False,
+    upx=False,
+    console=True,
+    cdict={'DATA': False} if options.store_data else None,
+    pkg_data_alignment=options.pkg_data_alignment,
+    pkg_uncompressed_binaries=options.pkg_uncompressed_binaries,
+    pkg_checksums=options.pkg_checksums,
+    runtime_tmpdir_policy=options.runtime_tmpdir_policy,
+    extraction_cache=options.extraction_cache,
+    diskless=options.diskless,
+    deferred_extraction=options.deferred_extraction,
+    prewarm=options.prewarm,
+    pkg_startup_order=startup_order,
+)
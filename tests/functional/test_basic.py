@@ -12,10 +12,12 @@
 
 import locale
 import os
+import shutil
 import sys
 from pathlib import Path
 import subprocess
 import re
+import time
 
 import pytest
 
@@ -891,3 +893,139 @@ def test_spec_options(pyi_builder, SPEC_DIR, capsys):
     with pytest.raises(SystemExit) as ex:
         pyi_builder.test_spec(SPEC_DIR / "pyi_spec_options.spec", pyi_args=["--", "--onefile"])
     assert "pyi_spec_options.spec: error: unrecognized arguments: --onefile" in capsys.readouterr().err
+
+
+# Onefile extraction options. The `pyi_onefile_extraction.spec` builds a onefile executable with a set of generated data
+# files, whose contents are verified by the application after extraction.
+@pytest.mark.parametrize(
+    "spec_args, app_args, env",
+    [
+        ([], [], {}),
+        (["--store-data", "--pkg-data-alignment", "4096"], [], {}),
+        (["--store-data", "--pkg-data-alignment", "4096"], [], {"PYINSTALLER_DISABLE_IO_URING": "1"}),
+        (["--pkg-uncompressed-binaries", "--pkg-data-alignment", "4096"], [], {}),
+        ([], [], {"PYINSTALLER_EXTRACTION_WORKERS": "1"}),
+        ([], [], {"PYINSTALLER_EXTRACTION_WORKERS": "4"}),
+        (["--pkg-checksums"], [], {}),
+        pytest.param(["--deferred-extraction"], ["--deferred"], {},
+                     marks=skipif(is_win, reason="Deferred extraction is not supported on Windows.")),
+        (["--startup-order"], [], {}),
+        pytest.param(["--deferred-extraction", "--startup-order"], ["--deferred"], {},
+                     marks=skipif(is_win, reason="Deferred extraction is not supported on Windows.")),
+        (["--startup-order", "--prewarm"], [], {}),
+    ],
+    ids=[
+        "default",
+        "aligned",
+        "aligned-no-io-uring",
+        "single-worker",
+        "four-workers",
+        "checksums",
+        "deferred",
+        "startup-order",
+        "deferred-startup-order",
+        "startup-order-prewarm",
+    ],
+)
+def test_onefile_extraction(pyi_builder_spec, monkeypatch, spec_args, app_args, env):
+    for name, value in env.items():
+        monkeypatch.setenv(name, value)
+    pyi_builder_spec.test_spec('pyi_onefile_extraction.spec', pyi_args=["--", *spec_args], app_args=app_args)
+
+
+@pytest.mark.linux
+def test_onefile_extraction_diskless(pyi_builder_spec):
+    pyi_builder_spec.test_spec(
+        'pyi_onefile_extraction.spec',
+        pyi_args=["--", "--diskless"],
+        app_args=["--expect-diskless"],
+    )
+
+    # If the number of memory-backed files exceeds the limit on open file descriptors, the application must fall back to
+    # extraction into the temporary directory.
+    def _limit_open_files():
+        import resource
+        resource.setrlimit(resource.RLIMIT_NOFILE, (64, 64))
+
+    exe, = pyi_builder_spec._find_executables("pyi_onefile_extraction")
+    p = subprocess.run([exe], preexec_fn=_limit_open_files)
+    assert p.returncode == 0
+
+
+def _is_usable_tmpfs(path):
+    # Check that the given path is the mount point of a writable tmpfs file system that does not prevent execution.
+    try:
+        with open('/proc/self/mounts', encoding='utf-8') as fp:
+            mounts = [line.split() for line in fp]
+    except OSError:
+        return False
+    for device, mount_point, fs_type, mount_options, *_ in reversed(mounts):
+        if mount_point == path:
+            options = mount_options.split(',')
+            return fs_type == 'tmpfs' and 'noexec' not in options and 'ro' not in options
+    return False
+
+
+@pytest.mark.linux
+@skipif(not _is_usable_tmpfs('/dev/shm'), reason="/dev/shm is not a usable tmpfs file system.")
+@skipif(
+    _is_usable_tmpfs('/dev/shm') and shutil.disk_usage('/dev/shm').free < 512 * 1024 * 1024,
+    reason="Not enough free space in /dev/shm."
+)
+def test_onefile_extraction_prefer_memory(pyi_builder_spec, monkeypatch):
+    monkeypatch.delenv('XDG_RUNTIME_DIR', raising=False)
+    monkeypatch.delenv('TMPDIR', raising=False)
+    pyi_builder_spec.test_spec(
+        'pyi_onefile_extraction.spec',
+        pyi_args=["--", "--runtime-tmpdir-policy", "prefer-memory"],
+        app_args=["--expect-tmpdir", "/dev/shm"],
+    )
+
+
+@skipif(is_win, reason="The extraction cache is not supported on Windows.")
+def test_onefile_extraction_cache(pyi_builder_spec, tmp_path):
+    cache_dir = tmp_path / 'extraction-cache'
+    meipass_file = tmp_path / 'meipass.txt'
+    app_args = ["--expect-cache", str(cache_dir), "--meipass-file", str(meipass_file)]
+    pyi_builder_spec.test_spec(
+        'pyi_onefile_extraction.spec', pyi_args=["--", "--extraction-cache", str(cache_dir)], app_args=app_args
+    )
+    # The application directory is kept after the application exits, and is re-used by subsequent runs.
+    meipass = meipass_file.read_text(encoding='utf-8')
+    assert os.path.isdir(meipass)
+    exe, = pyi_builder_spec._find_executables("pyi_onefile_extraction")
+    p = subprocess.run([exe, *app_args])
+    assert p.returncode == 0
+    assert meipass_file.read_text(encoding='utf-8') == meipass
+
+
+
+@skipif(is_win, reason="The extraction cache is not supported on Windows.")
+def test_onefile_extraction_cache_concurrent(pyi_builder_spec, tmp_path):
+    cache_dir = tmp_path / 'extraction-cache'
+    pyi_builder_spec.test_spec('pyi_onefile_extraction.spec', pyi_args=["--", "--extraction-cache", str(cache_dir)])
+    # Several instances that are started at the same time with an empty cache must all end up using the same, completely
+    # populated application directory.
+    shutil.rmtree(cache_dir)
+    exe, = pyi_builder_spec._find_executables("pyi_onefile_extraction")
+    processes = []
+    for i in range(8):
+        app_args = ["--expect-cache", str(cache_dir), "--meipass-file", str(tmp_path / f'meipass-{i}.txt')]
+        processes.append(subprocess.Popen([exe, *app_args]))
+    for process in processes:
+        assert process.wait(timeout=120) == 0
+    meipass_dirs = {(tmp_path / f'meipass-{i}.txt').read_text(encoding='utf-8') for i in range(8)}
+    assert len(meipass_dirs) == 1
+
+
+@skipif(is_win, reason="Detached cleanup is not supported on Windows.")
+def test_onefile_extraction_detached_cleanup(pyi_builder_spec, monkeypatch, tmp_path):
+    meipass_file = tmp_path / 'meipass.txt'
+    monkeypatch.setenv('PYINSTALLER_DETACHED_CLEANUP', '1')
+    pyi_builder_spec.test_spec('pyi_onefile_extraction.spec', app_args=["--meipass-file", str(meipass_file)])
+    # The temporary directory is removed by a background process after the application exits.
+    meipass = meipass_file.read_text(encoding='utf-8')
+    deadline = time.monotonic() + 60
+    while os.path.exists(meipass) and time.monotonic() < deadline:
+        time.sleep(0.1)
+    assert not os.path.exists(meipass)
@@ -11,6 +11,7 @@
         "test_multipackage3.spec",
         "test_multipackage4.spec",
         "test_multipackage5.spec",
+        "test_multipackage6.spec",
     ),
     ids=(
         "onefile_depends_on_onefile",
@@ -18,6 +19,7 @@
         "onefile_depends_on_onedir",
         "onedir_depends_on_onedir",
         "onedir_and_onefile_depends_on_onedir",
+        "onefile_depends_on_onedir_linked",
     )
 )
 def test_spec_with_multipackage(pyi_builder_spec, spec_file):
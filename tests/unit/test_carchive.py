@@ -0,0 +1,404 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+import os
+import struct
+import zlib
+
+import pytest
+
+from PyInstaller.archive import lz4_codec
+from PyInstaller.archive.readers import (
+    ArchiveReadError, CArchiveReader, PKG_COMPRESSION_LZ4, PKG_COMPRESSION_NONE, PKG_COMPRESSION_ZLIB,
+    PKG_COMPRESSION_ZLIB_BLOCKS, PKG_ITEM_DIRECTORY_TABLE
+)
+from PyInstaller.archive.writers import CArchiveWriter, ZlibArchiveWriter
+from PyInstaller.loader.pyimod01_archive import PYZ_ITEM_MODULE, PYZ_ITEM_PKG, ZlibArchiveReader
+
+
+def _create_data_files(tmp_path):
+    data_files = {
+        'data.txt': b'Hello world!\n' * 100,
+        'binary.bin': bytes(range(256)) * 10,
+        'empty.txt': b'',
+    }
+    for name, content in data_files.items():
+        (tmp_path / name).write_bytes(content)
+    return data_files
+
+
+# Write archive with CArchiveWriter and read it back with CArchiveReader.
+def test_carchive_roundtrip(tmp_path):
+    data_files = _create_data_files(tmp_path)
+
+    entries = [('opt1', '', False, 'o')]
+    entries += [(name, str(tmp_path / name), idx % 2 == 0, 'x') for idx, name in enumerate(sorted(data_files))]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.format_version == 2
+    assert archive.options == ['opt1']
+    assert sorted(archive.toc) == sorted(data_files)
+    for name, content in data_files.items():
+        assert archive.extract(name) == content
+
+
+# Ensure that CArchiveReader can read archives in the (legacy) version 1 format, with 32-bit offsets and lengths.
+def test_carchive_read_v1_archive(tmp_path):
+    data_files = _create_data_files(tmp_path)
+
+    toc_data = b''
+    blob_data = b''
+    for name, content in sorted(data_files.items()):
+        compressed = name.endswith('.txt')
+        blob = zlib.compress(content) if compressed else content
+        encoded_name = name.encode('utf-8') + b'\0'
+        name_length = len(encoded_name) + (-(18 + len(encoded_name)) % 16)
+        toc_data += struct.pack(
+            f'!IIIIBc{name_length}s',
+            18 + name_length,
+            len(blob_data),
+            len(blob),
+            len(content),
+            int(compressed),
+            b'x',
+            encoded_name,
+        )
+        blob_data += blob
+
+    pkg_length = len(blob_data) + len(toc_data) + 88
+    cookie = struct.pack(
+        '!8sIIII64s',
+        b'MEI\014\013\012\013\016',
+        pkg_length,
+        len(blob_data),
+        len(toc_data),
+        311,
+        b'libpython.so',
+    )
+
+    # Prepend some data, to simulate the archive being appended to the executable.
+    pkg_file = tmp_path / 'archive.pkg'
+    pkg_file.write_bytes(b'\xAA' * 100 + blob_data + toc_data + cookie)
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.format_version == 1
+    assert sorted(archive.toc) == sorted(data_files)
+    for name, content in data_files.items():
+        assert archive.extract(name) == content
+
+
+# Ensure that CArchiveReader can locate the cookie both via the trailer (when archive is at the end of the file) and by
+# scanning the file (when other data, e.g., a code signature, is appended after the archive).
+def test_carchive_trailer(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    entries = [(name, str(tmp_path / name), True, 'x') for name in sorted(data_files)]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+    pkg_data = pkg_file.read_bytes()
+
+    trailer_length = struct.calcsize(CArchiveWriter._TRAILER_FORMAT)
+    cookie_distance, magic = struct.unpack(CArchiveWriter._TRAILER_FORMAT, pkg_data[-trailer_length:])
+    assert magic == CArchiveWriter._TRAILER_MAGIC_PATTERN
+    assert pkg_data[-cookie_distance:].startswith(CArchiveWriter._COOKIE_MAGIC_PATTERN)
+
+    exe_file = tmp_path / 'program.exe'
+    for suffix in (b'', b'\x55' * 1000):
+        exe_file.write_bytes(b'\xAA' * 100 + pkg_data + suffix)
+        archive = CArchiveReader(str(exe_file))
+        for name, content in data_files.items():
+            assert archive.extract(name) == content
+
+
+# Test the optional alignment of data of stored extractable entries.
+def test_carchive_data_alignment(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    large_content = bytes(range(256)) * 64
+    (tmp_path / 'large.bin').write_bytes(large_content)
+    data_files['large.bin'] = large_content
+
+    entries = [('large_compressed.bin', str(tmp_path / 'large.bin'), True, 'x')]
+    entries += [(name, str(tmp_path / name), False, 'x') for name in sorted(data_files)]
+    entries += [('large_copy.bin', str(tmp_path / 'large.bin'), False, 'x')]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so', data_alignment=4096)
+
+    archive = CArchiveReader(str(pkg_file))
+    for name, content in data_files.items():
+        assert archive.extract(name) == content
+    assert archive.extract('large_compressed.bin') == large_content
+
+    # Only the stored entry that is larger than the alignment is aligned; others are packed without padding.
+    assert archive.toc['large.bin'][0] % 4096 == 0
+    assert archive.toc['large.bin'][0] > archive.toc['large_compressed.bin'][1]
+    assert archive.toc['binary.bin'][0] == archive.toc['large_compressed.bin'][1]
+
+    # An aligned entry shares the data of an identical aligned entry...
+    assert archive.toc['large_copy.bin'][:4] == archive.toc['large.bin'][:4]
+
+    # ... but not that of an identical entry that is stored without alignment.
+    entries = [('unaligned.pyz', str(tmp_path / 'large.bin'), False, 'z')]
+    entries += [('large.bin', str(tmp_path / 'large.bin'), False, 'x')]
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so', data_alignment=4096)
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.toc['large.bin'][0] % 4096 == 0
+    assert archive.toc['large.bin'][0] != archive.toc['unaligned.pyz'][0]
+    assert archive.extract('large.bin') == large_content
+
+
+# Test LZ4 compression of entries, mixed with zlib-compressed and stored entries within the same archive.
+@pytest.mark.skipif(not lz4_codec.is_available(), reason="LZ4 compression is not available.")
+def test_carchive_lz4(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    # Spans multiple LZ4 blocks; the random part is stored in uncompressed blocks.
+    large_content = b'abcd' * (1024 * 1024) + os.urandom(5 * 1024 * 1024)
+    (tmp_path / 'large.bin').write_bytes(large_content)
+    data_files['large.bin'] = large_content
+
+    compression_methods = [PKG_COMPRESSION_LZ4, PKG_COMPRESSION_ZLIB, PKG_COMPRESSION_NONE]
+    entries = [(name, str(tmp_path / name), compression_methods[idx % 3], 'x')
+               for idx, name in enumerate(sorted(data_files))]
+    entries.append(('symlink', 'target/name', PKG_COMPRESSION_LZ4, 'n'))
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+
+    archive = CArchiveReader(str(pkg_file))
+    for idx, name in enumerate(sorted(data_files)):
+        assert archive.toc[name][3] == compression_methods[idx % 3]
+        assert archive.extract(name) == data_files[name]
+    assert archive.extract('symlink') == b'target/name\0'
+
+
+# Test compression of large files as a sequence of independent zlib blocks.
+def test_carchive_zlib_blocks(tmp_path):
+
+    class _CArchiveWriter(CArchiveWriter):
+        _ZLIB_BLOCKS_THRESHOLD = 4000
+        _ZLIB_BLOCK_SIZE = 1000
+
+    data_files = _create_data_files(tmp_path)
+    exact_content = b'0123456789' * 500  # Exact multiple of block size.
+    (tmp_path / 'exact.bin').write_bytes(exact_content)
+    data_files['exact.bin'] = exact_content
+
+    entries = [(name, str(tmp_path / name), True, 'x') for name in sorted(data_files)]
+    entries.append(('explicit.txt', str(tmp_path / 'data.txt'), PKG_COMPRESSION_ZLIB_BLOCKS, 'x'))
+    entries.append(('explicit_empty.txt', str(tmp_path / 'empty.txt'), PKG_COMPRESSION_ZLIB_BLOCKS, 'x'))
+    data_files['explicit.txt'] = data_files['data.txt']
+    data_files['explicit_empty.txt'] = b''
+
+    pkg_file = tmp_path / 'archive.pkg'
+    _CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+
+    archive = CArchiveReader(str(pkg_file))
+    for name, content in data_files.items():
+        assert archive.extract(name) == content
+
+    # Only files above the threshold are compressed as blocks, unless requested explicitly.
+    assert archive.toc['data.txt'][3] == PKG_COMPRESSION_ZLIB
+    assert archive.toc['exact.bin'][3] == PKG_COMPRESSION_ZLIB_BLOCKS
+    assert archive.toc['explicit.txt'][3] == PKG_COMPRESSION_ZLIB_BLOCKS
+
+
+# Test per-entry checksums: verification during extraction, and verification of files against the archive.
+def test_carchive_checksums(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    entries = [(name, str(tmp_path / name), idx % 2 == 0, 'x') for idx, name in enumerate(sorted(data_files))]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so', checksums=True)
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.has_checksums
+    for name, content in data_files.items():
+        assert archive.get_checksum(name) == zlib.crc32(content)
+        assert archive.extract(name) == content
+        assert archive.verify_file(name, str(tmp_path / name))
+
+    # Modified file does not match the entry.
+    (tmp_path / 'modified.txt').write_bytes(data_files['data.txt'][:-1] + b'!')
+    assert not archive.verify_file('data.txt', str(tmp_path / 'modified.txt'))
+
+    # Corrupt the data of the stored entry; extraction must fail.
+    stored_name = sorted(data_files)[1]
+    data_offset = archive.toc[stored_name][0]
+    pkg_data = bytearray(pkg_file.read_bytes())
+    pkg_data[archive._start_offset + data_offset] ^= 0xFF
+    pkg_file.write_bytes(pkg_data)
+    with pytest.raises(ArchiveReadError):
+        CArchiveReader(str(pkg_file)).extract(stored_name)
+
+    # Archive without checksums.
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+    archive = CArchiveReader(str(pkg_file))
+    assert not archive.has_checksums
+    assert archive.get_checksum('data.txt') is None
+    assert archive.extract('data.txt') == data_files['data.txt']
+
+
+# Test the directory table, which lists the parent directories of extractable entries.
+def test_carchive_directory_table(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    entries = [
+        (os.path.join('pkg', 'sub', 'deeper', 'data.txt'), str(tmp_path / 'data.txt'), True, 'x'),
+        (os.path.join('pkg', 'binary.bin'), str(tmp_path / 'binary.bin'), False, 'b'),
+        (os.path.join('pkg-data', 'empty.txt'), str(tmp_path / 'empty.txt'), True, 'x'),
+        (os.path.join('links', 'link.txt'), 'target', False, 'n'),
+        (os.path.join('dep', 'lib.so'), 'other_exe', False, 'd'),
+        ('top.txt', str(tmp_path / 'data.txt'), True, 'x'),
+    ]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.toc['pyi-directory-table'][4] == PKG_ITEM_DIRECTORY_TABLE
+    directories = archive.extract('pyi-directory-table').split(b'\0')
+    assert directories.pop() == b''  # Each name is NULL-terminated.
+    assert directories == [
+        name.encode('utf-8') for name in sorted([
+            'dep',
+            'links',
+            'pkg',
+            os.path.join('pkg', 'sub'),
+            os.path.join('pkg', 'sub', 'deeper'),
+            'pkg-data',
+        ])
+    ]
+    assert archive.extract(os.path.join('pkg', 'sub', 'deeper', 'data.txt')) == data_files['data.txt']
+
+    # Archive without extractable entries in sub-directories has no directory table.
+    CArchiveWriter(str(pkg_file), [('top.txt', str(tmp_path / 'data.txt'), True, 'x')], pylib_name='libpython.so')
+    assert 'pyi-directory-table' not in CArchiveReader(str(pkg_file)).toc
+
+
+def test_carchive_archive_hash(tmp_path):
+    _create_data_files(tmp_path)
+    entries = [
+        ('data.txt', str(tmp_path / 'data.txt'), True, 'x'),
+        ('binary.bin', str(tmp_path / 'binary.bin'), False, 'b'),
+    ]
+
+    def _get_archive_hashes(pkg_file):
+        archive = CArchiveReader(str(pkg_file))
+        return [name.split(' ', 1)[1] for name in archive.options if name.startswith('pyi-archive-hash ')]
+
+    # Without the extraction cache option, no archive hash is stored.
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+    assert _get_archive_hashes(pkg_file) == []
+
+    # With the extraction cache option, the archive hash is stored, and is stable for identical input.
+    entries.append(('pyi-extraction-cache', '', False, 'o'))
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+    archive_hash, = _get_archive_hashes(pkg_file)
+    assert len(archive_hash) == 64 and all(char in '0123456789abcdef' for char in archive_hash)
+
+    pkg_file2 = tmp_path / 'archive2.pkg'
+    CArchiveWriter(str(pkg_file2), entries, pylib_name='libpython.so')
+    assert _get_archive_hashes(pkg_file2) == [archive_hash]
+
+    # Change of contents results in a different hash.
+    CArchiveWriter(str(pkg_file2), entries[1:], pylib_name='libpython.so')
+    assert _get_archive_hashes(pkg_file2) != [archive_hash]
+
+
+# Files with identical contents share the data in the archive, as long as they are stored with the same compression.
+def test_carchive_deduplication(tmp_path):
+    data_files = _create_data_files(tmp_path)
+    (tmp_path / 'copy.bin').write_bytes(data_files['binary.bin'])
+
+    entries = [
+        ('binary.bin', str(tmp_path / 'binary.bin'), True, 'b'),
+        ('sub/copy.bin', str(tmp_path / 'copy.bin'), True, 'x'),
+        ('stored.bin', str(tmp_path / 'binary.bin'), False, 'x'),
+        ('data.txt', str(tmp_path / 'data.txt'), True, 'x'),
+    ]
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so')
+
+    archive = CArchiveReader(str(pkg_file))
+    assert archive.toc['sub/copy.bin'][:4] == archive.toc['binary.bin'][:4]
+    assert archive.toc['stored.bin'][0] != archive.toc['binary.bin'][0]
+    for name in ('binary.bin', 'sub/copy.bin', 'stored.bin'):
+        assert archive.extract(name) == data_files['binary.bin']
+    assert archive.extract('data.txt') == data_files['data.txt']
+
+
+# Reorder entries according to the startup profile.
+def test_carchive_entry_order(tmp_path):
+    data_files = _create_data_files(tmp_path)
+
+    entries = [
+        ('opt1', '', False, 'o'),
+        ('data.txt', str(tmp_path / 'data.txt'), True, 'x'),
+        ('sub/late.bin', str(tmp_path / 'binary.bin'), True, 'b'),
+        ('script', str(tmp_path / 'data.txt'), False, 'x'),
+        ('empty.txt', str(tmp_path / 'empty.txt'), True, 'x'),
+        ('libpython.so', str(tmp_path / 'binary.bin'), False, 'b'),
+        ('opt2', '', False, 'o'),
+    ]
+    entry_order = ['some.module', 'empty.txt', 'sub/late.bin', 'empty.txt', 'missing.txt']
+
+    pkg_file = tmp_path / 'archive.pkg'
+    CArchiveWriter(str(pkg_file), entries, pylib_name='libpython.so', entry_order=entry_order)
+
+    archive = CArchiveReader(str(pkg_file))
+    # The python shared library and the listed entries are accessed during startup.
+    assert archive.options == ['opt1', 'opt2', 'pyi-startup-entries 3']
+    names = [name for name in archive.toc if name != 'pyi-directory-table']
+    names.sort(key=lambda name: archive.toc[name][0])
+    assert names == ['libpython.so', 'empty.txt', 'sub/late.bin', 'data.txt', 'script']
+    assert archive.extract('sub/late.bin') == data_files['binary.bin']
+    assert archive.extract('data.txt') == data_files['data.txt']
+
+
+# Split PYZ archive into the main and the cold archive; the main archive lists all modules, and the data of cold modules
+# is read from the cold archive.
+def test_zlib_archive_split(tmp_path):
+    code_dict = {name: compile(f"NAME = {name!r}", name, 'exec') for name in ('hot', 'cold', 'coldpkg')}
+    entries = [
+        ('cold', str(tmp_path / 'cold.py'), 'PYMODULE'),
+        ('coldpkg', str(tmp_path / 'coldpkg' / '__init__.py'), 'PYMODULE'),
+        ('hot', str(tmp_path / 'hot.py'), 'PYMODULE'),
+    ]
+    pyz_file = tmp_path / 'archive.pyz'
+    ZlibArchiveWriter(str(pyz_file), entries, code_dict=code_dict)
+
+    main_file = tmp_path / 'main.pyz'
+    cold_file = tmp_path / 'cold.pyz'
+    num_cold = ZlibArchiveWriter.split_archive(
+        str(pyz_file), str(main_file), str(cold_file), lambda name: name.startswith('cold')
+    )
+    assert num_cold == 2
+
+    archive = ZlibArchiveReader(str(main_file), cold_filename=str(cold_file))
+    assert archive.toc['hot'][0] == PYZ_ITEM_MODULE
+    assert archive.toc['cold'][0] == PYZ_ITEM_MODULE
+    assert archive.toc['coldpkg'][0] == PYZ_ITEM_PKG
+    assert sorted(ZlibArchiveReader(str(cold_file)).toc) == ['cold', 'coldpkg']
+    for name in code_dict:
+        namespace = {}
+        exec(archive.extract(name), namespace)
+        assert namespace['NAME'] == name
+
+    # Without the cold archive, only the main archive's entries can be extracted.
+    archive = ZlibArchiveReader(str(main_file))
+    assert archive.extract('hot') is not None
+    with pytest.raises(ArchiveReadError):
+        archive.extract('cold')